@@ -16,6 +16,7 @@
 
 #include "go-llvm-diagnostics.h"
 #include "go-c.h"
+#include "go-import-index.h"
 
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Object/Archive.h"
@@ -150,6 +151,11 @@ go_read_export_data (int fd, off_t offset, char **pbuf, size_t *plen,
   *pbuf = NULL;
   *plen = 0;
 
+  // Try the package import indices first; this avoids mapping and
+  // walking the whole object or archive.
+  if (GoImportIndex::readExportData(fd, offset, pbuf, plen))
+    return nullptr;
+
   // Create memory buffer for this file descriptor
   auto BuffOrErr = llvm::MemoryBuffer::getOpenFile(fd, "", -1);
   if (! BuffOrErr)
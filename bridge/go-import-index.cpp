@@ -0,0 +1,614 @@
+//===-- go-import-index.cpp - package import index ------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Methods for class GoImportIndex.
+//
+//===----------------------------------------------------------------------===//
+
+#include "go-import-index.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Object/Archive.h"
+#include "llvm/Object/Binary.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <deque>
+#include <errno.h>
+#include <limits>
+#include <map>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace llvm::support;
+
+const char *const GoImportIndex::fileName = "goimports.idx";
+
+// Layout constants (see the header).
+static const char indexMagic[8] = { 'G', 'O', 'I', 'M', 'P', 'I', 'D', 'X' };
+static const uint32_t indexVersion = 1;
+static const unsigned headerSize = 24;
+static const unsigned dirSize = 16;
+static const unsigned entrySize = 48;
+
+// Size of archive member header in bytes (see go-backend.cpp).
+static const uint64_t archiveMemberHeaderSize = 60;
+
+static const char *exportSectionName = ".go_export";
+
+// Limit on directory nesting when building an index.
+static const unsigned maxScanDepth = 64;
+
+static int64_t modTime(const llvm::sys::fs::file_status &st)
+{
+  return st.getLastModificationTime().time_since_epoch().count();
+}
+
+GoImportIndex::GoImportIndex(const std::string &root,
+                             std::unique_ptr<llvm::MemoryBuffer> buffer)
+    : root_(root),
+      buffer_(std::move(buffer)),
+      numDirs_(0),
+      numEntries_(0),
+      dirs_(nullptr),
+      entries_(nullptr),
+      strings_(nullptr),
+      stringsSize_(0)
+{
+}
+
+std::unique_ptr<GoImportIndex> GoImportIndex::open(const std::string &root)
+{
+  llvm::SmallString<256> path(root);
+  llvm::sys::path::append(path, fileName);
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> mbOrErr =
+      llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                  /*RequiresNullTerminator=*/false);
+  if (!mbOrErr)
+    return nullptr;
+  std::unique_ptr<GoImportIndex> index(
+      new GoImportIndex(root, std::move(*mbOrErr)));
+  if (!index->validate())
+    return nullptr;
+  return index;
+}
+
+bool GoImportIndex::validate()
+{
+  const char *base = buffer_->getBufferStart();
+  size_t size = buffer_->getBufferSize();
+  if (size < headerSize || memcmp(base, indexMagic, sizeof(indexMagic)) ||
+      endian::read32le(base + 8) != indexVersion)
+    return false;
+  numDirs_ = endian::read32le(base + 12);
+  numEntries_ = endian::read32le(base + 16);
+  stringsSize_ = endian::read32le(base + 20);
+  uint64_t expected = uint64_t(headerSize) + uint64_t(numDirs_) * dirSize +
+      uint64_t(numEntries_) * entrySize + stringsSize_;
+  if (expected != size)
+    return false;
+  dirs_ = base + headerSize;
+  entries_ = dirs_ + numDirs_ * dirSize;
+  strings_ = entries_ + numEntries_ * entrySize;
+  if (stringsSize_ == 0 || strings_[stringsSize_ - 1] != '\0')
+    return false;
+
+  // Check string references up front, so that lookups need not.
+  for (unsigned i = 0; i < numDirs_; ++i)
+    if (endian::read32le(dirs_ + i * dirSize) >= stringsSize_)
+      return false;
+  for (unsigned i = 0; i < numEntries_; ++i) {
+    const char *ep = entries_ + i * entrySize;
+    if (endian::read32le(ep) >= stringsSize_ ||
+        endian::read32le(ep + 4) >= stringsSize_)
+      return false;
+  }
+  return true;
+}
+
+llvm::StringRef GoImportIndex::string(uint32_t off) const
+{
+  return llvm::StringRef(strings_ + off);
+}
+
+GoImportIndex::Entry GoImportIndex::entry(unsigned idx) const
+{
+  const char *ep = entries_ + idx * entrySize;
+  Entry e;
+  e.pkgpath = string(endian::read32le(ep));
+  e.file = string(endian::read32le(ep + 4));
+  e.memberOffset = endian::read64le(ep + 8);
+  e.exportOffset = endian::read64le(ep + 16);
+  e.exportSize = endian::read64le(ep + 24);
+  e.fileMtime = static_cast<int64_t>(endian::read64le(ep + 32));
+  e.fileSize = endian::read64le(ep + 40);
+  return e;
+}
+
+bool GoImportIndex::isCurrent() const
+{
+  for (unsigned i = 0; i < numDirs_; ++i) {
+    const char *dp = dirs_ + i * dirSize;
+    llvm::SmallString<256> path(root_);
+    llvm::sys::path::append(path, string(endian::read32le(dp)));
+    llvm::sys::fs::file_status st;
+    if (llvm::sys::fs::status(path, st) ||
+        modTime(st) != static_cast<int64_t>(endian::read64le(dp + 8)))
+      return false;
+  }
+  return true;
+}
+
+bool GoImportIndex::lookupPackage(llvm::StringRef pkgpath,
+                                  Entry &result) const
+{
+  unsigned lo = 0, hi = numEntries_;
+  while (lo < hi) {
+    unsigned mid = lo + (hi - lo) / 2;
+    if (string(endian::read32le(entries_ + mid * entrySize)) < pkgpath)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == numEntries_)
+    return false;
+  result = entry(lo);
+  return result.pkgpath == pkgpath;
+}
+
+bool GoImportIndex::lookupFile(llvm::StringRef file, uint64_t memberOffset,
+                               Entry &result)
+{
+  if (fileMap_.empty()) {
+    for (unsigned i = 0; i < numEntries_; ++i)
+      fileMap_[string(endian::read32le(entries_ + i * entrySize + 4))]
+          .push_back(i);
+  }
+  auto it = fileMap_.find(file);
+  if (it == fileMap_.end())
+    return false;
+  for (unsigned idx : it->second) {
+    result = entry(idx);
+    if (result.memberOffset == memberOffset)
+      return true;
+  }
+  return false;
+}
+
+//......................................................................
+//
+// Registry consulted by go_read_export_data.
+
+static std::vector<std::unique_ptr<GoImportIndex>> &registry()
+{
+  static std::vector<std::unique_ptr<GoImportIndex>> indices;
+  return indices;
+}
+
+void GoImportIndex::registerIndex(std::unique_ptr<GoImportIndex> index)
+{
+  // Paths obtained from file descriptors are canonical, so the root
+  // needs to be too.
+  llvm::SmallString<256> real;
+  if (!llvm::sys::fs::real_path(index->root_, real))
+    index->root_ = std::string(real);
+  registry().push_back(std::move(index));
+}
+
+void GoImportIndex::clearRegistry()
+{
+  registry().clear();
+}
+
+bool GoImportIndex::readExportData(int fd, off_t offset,
+                                   char **pbuf, size_t *plen)
+{
+  if (registry().empty())
+    return false;
+
+  std::string link("/proc/self/fd/" + std::to_string(fd));
+  char pathbuf[PATH_MAX];
+  ssize_t len = readlink(link.c_str(), pathbuf, sizeof(pathbuf));
+  if (len <= 0 || len == sizeof(pathbuf))
+    return false;
+  llvm::StringRef path(pathbuf, len);
+
+  for (auto &index : registry()) {
+    llvm::StringRef rel = path;
+    if (!rel.consume_front(index->root()) || !rel.consume_front("/"))
+      continue;
+    // Roots may nest, so a miss here is not conclusive.
+    Entry e;
+    if (!index->lookupFile(rel, offset, e))
+      continue;
+    if (e.exportSize == 0)
+      return false;
+    llvm::sys::fs::file_status st;
+    if (llvm::sys::fs::status(fd, st) || modTime(st) != e.fileMtime ||
+        st.getSize() != e.fileSize)
+      return false;
+    char *buf = new char[e.exportSize];
+    size_t got = 0;
+    while (got < e.exportSize) {
+      ssize_t n = pread(fd, buf + got, e.exportSize - got,
+                        e.exportOffset + got);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        delete[] buf;
+        return false;
+      }
+      got += n;
+    }
+    *pbuf = buf;
+    *plen = e.exportSize;
+    return true;
+  }
+  return false;
+}
+
+//......................................................................
+//
+// Index construction.
+
+namespace {
+
+// Candidate suffixes for a package "x", in the order in which the
+// front end tries them.
+enum CandidateRank { RankGox, RankSo, RankArchive, RankObject, RankNone };
+
+struct Candidate {
+  std::string file;
+  CandidateRank rank;
+};
+
+class IndexBuilder {
+ public:
+  IndexBuilder(const std::string &root) : root_(root) { }
+
+  bool scan(std::string &err);
+  bool write(std::string &err);
+  int64_t newestMtime() const;
+
+ private:
+  std::string root_;
+  std::vector<std::pair<std::string, int64_t>> dirs_;
+  std::map<std::string, Candidate> candidates_;
+  std::vector<GoImportIndex::Entry> entries_;
+  // Backing store for the names in entries_.
+  std::deque<std::string> names_;
+
+  bool scanDir(const std::string &rel, unsigned depth, std::string &err);
+  void addCandidate(const std::string &reldir, llvm::StringRef name);
+  void addEntries(const std::string &pkgpath, const std::string &file);
+  void addEntry(const std::string &pkgpath, const std::string &file,
+                const llvm::sys::fs::file_status &st, uint64_t memberOffset,
+                uint64_t exportOffset, uint64_t exportSize);
+  void addExportEntry(const std::string &pkgpath, const std::string &file,
+                      const llvm::sys::fs::file_status &st,
+                      llvm::object::ObjectFile *obj,
+                      llvm::StringRef buffer, uint64_t memberOffset);
+  uint32_t addString(llvm::StringMap<uint32_t> &offsets, std::string &strtab,
+                     llvm::StringRef s);
+};
+
+} // end anonymous namespace
+
+static std::string joinRel(const std::string &dir, llvm::StringRef name)
+{
+  return dir.empty() ? name.str() : dir + "/" + name.str();
+}
+
+void IndexBuilder::addCandidate(const std::string &reldir,
+                                llvm::StringRef name)
+{
+  llvm::StringRef base = name;
+  CandidateRank rank = RankNone;
+  if (base.consume_back(".gox"))
+    rank = RankGox;
+  else if (base.startswith("lib") && base.endswith(".so"))
+    rank = RankSo, base = base.drop_front(3).drop_back(3);
+  else if (base.startswith("lib") && base.endswith(".a"))
+    rank = RankArchive, base = base.drop_front(3).drop_back(2);
+  else if (base.consume_back(".o"))
+    rank = RankObject;
+  if (rank == RankNone || base.empty())
+    return;
+  std::string pkgpath = joinRel(reldir, base);
+  auto it = candidates_.find(pkgpath);
+  if (it != candidates_.end() && it->second.rank <= rank)
+    return;
+  candidates_[pkgpath] = Candidate{joinRel(reldir, name), rank};
+}
+
+bool IndexBuilder::scanDir(const std::string &rel, unsigned depth,
+                           std::string &err)
+{
+  llvm::SmallString<256> dir(root_);
+  // Symbolic links are followed, guard against cycles.
+  if (depth > maxScanDepth) {
+    err = "directory nesting too deep at '" + std::string(dir) + "/" +
+        rel + "'";
+    return false;
+  }
+  if (!rel.empty())
+    llvm::sys::path::append(dir, rel);
+  llvm::sys::fs::file_status dst;
+  if (std::error_code ec = llvm::sys::fs::status(dir, dst)) {
+    err = "unable to access '" + std::string(dir) + "': " + ec.message();
+    return false;
+  }
+  dirs_.push_back(std::make_pair(rel, modTime(dst)));
+
+  std::error_code ec;
+  std::vector<std::string> subdirs;
+  for (llvm::sys::fs::directory_iterator dit(dir, ec), dend;
+       dit != dend && !ec; dit.increment(ec)) {
+    llvm::StringRef name = llvm::sys::path::filename(dit->path());
+    llvm::sys::fs::file_type type = dit->type();
+    if (type == llvm::sys::fs::file_type::symlink_file ||
+        type == llvm::sys::fs::file_type::type_unknown) {
+      llvm::sys::fs::file_status st;
+      if (llvm::sys::fs::status(dit->path(), st))
+        continue;
+      type = st.type();
+    }
+    if (type == llvm::sys::fs::file_type::directory_file) {
+      if (name.startswith("."))
+        continue;
+      llvm::SmallString<256> nested(dit->path());
+      llvm::sys::path::append(nested, GoImportIndex::fileName);
+      if (llvm::sys::fs::exists(nested))
+        continue;
+      subdirs.push_back(joinRel(rel, name));
+    } else if (type == llvm::sys::fs::file_type::regular_file) {
+      addCandidate(rel, name);
+    }
+  }
+  if (ec) {
+    err = "unable to read '" + std::string(dir) + "': " + ec.message();
+    return false;
+  }
+  for (auto &sub : subdirs)
+    if (!scanDir(sub, depth + 1, err))
+      return false;
+  return true;
+}
+
+void IndexBuilder::addExportEntry(const std::string &pkgpath,
+                                  const std::string &file,
+                                  const llvm::sys::fs::file_status &st,
+                                  llvm::object::ObjectFile *obj,
+                                  llvm::StringRef buffer,
+                                  uint64_t memberOffset)
+{
+  for (const llvm::object::SectionRef &sref : obj->sections()) {
+    llvm::Expected<llvm::StringRef> sname = sref.getName();
+    if (!sname) {
+      llvm::consumeError(sname.takeError());
+      return;
+    }
+    if (*sname != exportSectionName)
+      continue;
+    llvm::Expected<llvm::StringRef> bytes = sref.getContents();
+    if (!bytes) {
+      llvm::consumeError(bytes.takeError());
+      return;
+    }
+    if (bytes->empty())
+      return;
+    addEntry(pkgpath, file, st, memberOffset,
+             bytes->data() - buffer.data(), bytes->size());
+    return;
+  }
+}
+
+void IndexBuilder::addEntry(const std::string &pkgpath,
+                            const std::string &file,
+                            const llvm::sys::fs::file_status &st,
+                            uint64_t memberOffset,
+                            uint64_t exportOffset,
+                            uint64_t exportSize)
+{
+  names_.push_back(pkgpath);
+  names_.push_back(file);
+  GoImportIndex::Entry e;
+  e.pkgpath = names_[names_.size() - 2];
+  e.file = names_.back();
+  e.memberOffset = memberOffset;
+  e.exportOffset = exportOffset;
+  e.exportSize = exportSize;
+  e.fileMtime = modTime(st);
+  e.fileSize = st.getSize();
+  entries_.push_back(e);
+}
+
+void IndexBuilder::addEntries(const std::string &pkgpath,
+                              const std::string &file)
+{
+  llvm::SmallString<256> path(root_);
+  llvm::sys::path::append(path, file);
+  llvm::sys::fs::file_status st;
+  if (llvm::sys::fs::status(path, st))
+    return;
+  size_t numEntries = entries_.size();
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> mbOrErr =
+      llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                  /*RequiresNullTerminator=*/false);
+  if (mbOrErr) {
+    llvm::StringRef buffer = (*mbOrErr)->getBuffer();
+    llvm::Expected<std::unique_ptr<llvm::object::Binary>> binOrErr =
+        llvm::object::createBinary((*mbOrErr)->getMemBufferRef());
+    if (!binOrErr) {
+      llvm::consumeError(binOrErr.takeError());
+    } else if (auto *a =
+               llvm::dyn_cast<llvm::object::Archive>(binOrErr->get())) {
+      // Member offsets are as seen by the front end, i.e. just past the
+      // member header.
+      llvm::Error aerr = llvm::Error::success();
+      for (auto &child : a->children(aerr)) {
+        llvm::Expected<std::unique_ptr<llvm::object::Binary>> childOrErr =
+            child.getAsBinary();
+        if (!childOrErr) {
+          llvm::consumeError(childOrErr.takeError());
+          continue;
+        }
+        if (auto *o =
+            llvm::dyn_cast<llvm::object::ObjectFile>(childOrErr->get()))
+          addExportEntry(pkgpath, file, st, o, buffer,
+                         child.getChildOffset() + archiveMemberHeaderSize);
+      }
+      llvm::consumeError(std::move(aerr));
+    } else if (auto *o =
+               llvm::dyn_cast<llvm::object::ObjectFile>(binOrErr->get())) {
+      addExportEntry(pkgpath, file, st, o, buffer, 0);
+    }
+  }
+
+  // Packages whose export data could not be located (e.g. *.gox files
+  // holding raw export data) are still recorded, with no export data.
+  if (entries_.size() == numEntries)
+    addEntry(pkgpath, file, st, 0, 0, 0);
+}
+
+int64_t IndexBuilder::newestMtime() const
+{
+  int64_t newest = std::numeric_limits<int64_t>::min();
+  for (auto &dir : dirs_)
+    newest = std::max(newest, dir.second);
+  for (auto &e : entries_)
+    newest = std::max(newest, e.fileMtime);
+  return newest;
+}
+
+bool IndexBuilder::scan(std::string &err)
+{
+  // A change made within the file system's timestamp granularity of
+  // the scan could go unnoticed later (same mtime as recorded). If
+  // anything was modified that recently, wait until the window has
+  // passed and scan again.
+  const auto granularity = std::chrono::seconds(1);
+  for (unsigned attempt = 0; ; ++attempt) {
+    dirs_.clear();
+    candidates_.clear();
+    entries_.clear();
+    names_.clear();
+    if (!scanDir("", 0, err))
+      return false;
+    for (auto &cand : candidates_)
+      addEntries(cand.first, cand.second.file);
+
+    std::chrono::nanoseconds newest(newestMtime());
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    if (now - newest > granularity || attempt == 2)
+      return true;
+    // (Capped, in case of clock skew with a network file system.)
+    std::this_thread::sleep_for(
+        std::min<std::chrono::nanoseconds>(granularity,
+                                           granularity - (now - newest)));
+  }
+}
+
+uint32_t IndexBuilder::addString(llvm::StringMap<uint32_t> &offsets,
+                                 std::string &strtab, llvm::StringRef s)
+{
+  auto it = offsets.find(s);
+  if (it != offsets.end())
+    return it->second;
+  uint32_t off = strtab.size();
+  strtab += s.str();
+  strtab += '\0';
+  offsets[s] = off;
+  return off;
+}
+
+bool IndexBuilder::write(std::string &err)
+{
+  llvm::SmallString<256> path(root_);
+  llvm::sys::path::append(path, GoImportIndex::fileName);
+
+  // Entries are already sorted by package path (and member offset
+  // within a package), since candidates_ is an ordered map and
+  // archive members are visited in order.
+  llvm::StringMap<uint32_t> offsets;
+  std::string strtab;
+  std::string body;
+  llvm::raw_string_ostream os(body);
+  endian::Writer w(os, llvm::support::little);
+  for (auto &dir : dirs_) {
+    w.write<uint32_t>(addString(offsets, strtab, dir.first));
+    w.write<uint32_t>(0);
+    w.write<uint64_t>(static_cast<uint64_t>(dir.second));
+  }
+  for (auto &e : entries_) {
+    w.write<uint32_t>(addString(offsets, strtab, e.pkgpath));
+    w.write<uint32_t>(addString(offsets, strtab, e.file));
+    w.write<uint64_t>(e.memberOffset);
+    w.write<uint64_t>(e.exportOffset);
+    w.write<uint64_t>(e.exportSize);
+    w.write<uint64_t>(static_cast<uint64_t>(e.fileMtime));
+    w.write<uint64_t>(e.fileSize);
+  }
+  os.flush();
+
+  std::string header;
+  llvm::raw_string_ostream hos(header);
+  endian::Writer hw(hos, llvm::support::little);
+  hos.write(indexMagic, sizeof(indexMagic));
+  hw.write<uint32_t>(indexVersion);
+  hw.write<uint32_t>(dirs_.size());
+  hw.write<uint32_t>(entries_.size());
+  hw.write<uint32_t>(strtab.size());
+  hos.flush();
+
+  // The file is rewritten in place rather than replaced, since
+  // creating a new file would change the mtime of the root directory
+  // just recorded above (see GoImportIndex::write). Readers reject a
+  // partially written index based on its size.
+  std::error_code ec;
+  llvm::raw_fd_ostream out(path, ec, llvm::sys::fs::OF_None);
+  if (ec) {
+    err = "unable to write '" + std::string(path) + "': " + ec.message();
+    return false;
+  }
+  out << header << body << strtab;
+  out.close();
+  if (out.has_error()) {
+    err = "error writing '" + std::string(path) + "': " +
+        out.error().message();
+    out.clear_error();
+    return false;
+  }
+  return true;
+}
+
+bool GoImportIndex::write(const std::string &root, std::string &err)
+{
+  // Make sure the index file exists before scanning, so that the
+  // directory mtimes recorded for the root reflect its presence.
+  llvm::SmallString<256> path(root);
+  llvm::sys::path::append(path, fileName);
+  if (!llvm::sys::fs::exists(path)) {
+    std::error_code ec;
+    llvm::raw_fd_ostream create(path, ec, llvm::sys::fs::OF_None);
+    if (ec) {
+      err = "unable to create '" + std::string(path) + "': " + ec.message();
+      return false;
+    }
+  }
+
+  IndexBuilder builder(root);
+  return builder.scan(err) && builder.write(err);
+}
@@ -0,0 +1,126 @@
+//===-- go-import-index.h - decls for 'GoImportIndex' class ---------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Defines GoImportIndex class.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVMGOFRONTEND_GO_IMPORT_INDEX_H
+#define LLVMGOFRONTEND_GO_IMPORT_INDEX_H
+
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+// A package import index describes the Go packages available under a
+// single search root (a directory passed to go_add_search_path), so
+// that importing a package need not involve opening, stat'ing and
+// parsing a series of candidate files. The index lives in a file
+// named GoImportIndex::fileName at the top of the root, and is laid
+// out so that it can be used directly from an mmap'd buffer:
+//
+//   header:  magic, version, #dirs, #entries, string table size
+//   dirs:    (name, mtime) for the root and each subdirectory scanned
+//   entries: (package path, file, member offset, export data offset,
+//             export data size, file mtime, file size), sorted by
+//             package path and member offset
+//   strings: NUL-terminated strings (all names are relative to the
+//            root), referenced by offset from the tables above
+//
+// An entry names the file the front end would pick for the package
+// (*.gox, lib*.so, lib*.a, *.o, in that order) and, for each object
+// within it that carries export data, where that data lives. File
+// mtimes/sizes allow individual entries to be checked cheaply; the
+// directory mtimes allow checking that the index still describes the
+// complete set of packages under the root.
+//
+// Subdirectories whose names start with "." (not valid in import
+// paths) and subdirectories that have an index of their own (nested
+// roots, e.g. <lib>/go/<version> within <lib>) are not scanned.
+
+class GoImportIndex {
+ public:
+  struct Entry {
+    llvm::StringRef pkgpath;
+    llvm::StringRef file;
+    uint64_t memberOffset;
+    uint64_t exportOffset;
+    uint64_t exportSize;
+    int64_t fileMtime;
+    uint64_t fileSize;
+  };
+
+  static const char *const fileName;
+
+  // Read the index for the specified root. Returns nullptr if there
+  // is no index or it is malformed (but does not check whether it is
+  // up to date, see isCurrent()).
+  static std::unique_ptr<GoImportIndex> open(const std::string &root);
+
+  // Scan the specified root and write a fresh index for it. Returns
+  // false (setting 'err') on error.
+  static bool write(const std::string &root, std::string &err);
+
+  // Returns TRUE if no directory under the root has changed since
+  // the index was written, e.g. no package has been added/removed.
+  bool isCurrent() const;
+
+  // Number of package entries in the index.
+  unsigned numEntries() const { return numEntries_; }
+
+  // Look up the (first) entry for the specified package path.
+  bool lookupPackage(llvm::StringRef pkgpath, Entry &entry) const;
+
+  // Look up the entry for the object at 'memberOffset' within 'file'
+  // (relative to the root).
+  bool lookupFile(llvm::StringRef file, uint64_t memberOffset,
+                  Entry &entry);
+
+  const std::string &root() const { return root_; }
+
+  // Entry point for go_read_export_data: if 'fd' is a file described
+  // by one of the registered (see below) indices, and unchanged since
+  // the index was written, reads the export data of the object at
+  // 'offset' directly, without examining the file's structure.
+  // Returns false if the indices don't help, in which case the caller
+  // should fall back to reading the file.
+  static bool readExportData(int fd, off_t offset,
+                             char **pbuf, size_t *plen);
+
+  // Make an index available to readExportData.
+  static void registerIndex(std::unique_ptr<GoImportIndex> index);
+
+  // Drop all registered indices.
+  static void clearRegistry();
+
+ private:
+  GoImportIndex(const std::string &root,
+                std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+  std::string root_;
+  std::unique_ptr<llvm::MemoryBuffer> buffer_;
+  unsigned numDirs_;
+  unsigned numEntries_;
+  const char *dirs_;
+  const char *entries_;
+  const char *strings_;
+  unsigned stringsSize_;
+  // Maps file name to entry indices (built on first use).
+  llvm::StringMap<llvm::SmallVector<unsigned, 1>> fileMap_;
+
+  bool validate();
+  llvm::StringRef string(uint32_t off) const;
+  Entry entry(unsigned idx) const;
+};
+
+#endif // LLVMGOFRONTEND_GO_IMPORT_INDEX_H
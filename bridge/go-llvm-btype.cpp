@@ -14,6 +14,7 @@
 #include "go-llvm-bexpression.h"
 #include "go-system.h"
 
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Constants.h"
@@ -62,6 +63,8 @@ bool Btype::equalImpl(const Btype &other, CompareCtl ctl) const
     return true;
   if (flavor() != other.flavor())
     return false;
+  if ((ctl & IgnoreNames) == 0 && hash() != other.hash())
+    return false;
   if ((ctl & IgnoreNames) == 0 && name() != other.name())
     return false;
   if (isPlaceholder() != other.isPlaceholder())
@@ -150,11 +153,85 @@ bool Btype::equalImpl(const Btype &other, CompareCtl ctl) const
 
 unsigned Btype::hash() const
 {
-  unsigned hv = static_cast<unsigned>(flavor());
-  std::size_t hn = std::hash<std::string>{}(name());
-  std::size_t ht = std::hash<llvm::Type *>{}(type());
-  unsigned h = ((hn + ht) << 3) | hv;
-  return h;
+  if (!hashValid_) {
+    hash_ = computeHash();
+    hashValid_ = true;
+  }
+  return hash_;
+}
+
+// Summary of a child type for use in the hash of its parent: only
+// attributes that are fixed once the child is created. Child types
+// are not hashed recursively, since a placeholder child can be
+// filled in after its parent has been installed in the type
+// manager's table of anonymous types.
+static llvm::hash_code childHash(const Btype *t)
+{
+  if (!t)
+    return llvm::hash_value(0);
+  llvm::hash_code h = llvm::hash_combine(t->flavor(), t->name());
+  switch(t->flavor()) {
+    case Btype::IntegerT: {
+      const BIntegerType *bit = t->castToBIntegerType();
+      return llvm::hash_combine(h, bit->isUnsigned(), bit->bits());
+    }
+    case Btype::FloatT:
+      return llvm::hash_combine(h, t->castToBFloatType()->bits());
+    case Btype::ComplexT:
+      return llvm::hash_combine(h, t->castToBComplexType()->bits());
+    case Btype::AuxT:
+      return llvm::hash_combine(h, t->type());
+    default:
+      return h;
+  }
+}
+
+// The hash covers everything equal() looks at directly (flavor,
+// name, LLVM type, signedness, field names), plus a summary of each
+// child type. This makes a mismatch in a child visible without
+// walking the child, so that most unequal candidates found in the
+// same bucket of the anonymous type table are rejected on the hash
+// alone.
+unsigned Btype::computeHash() const
+{
+  llvm::hash_code h = llvm::hash_combine(flavor(), name(), type());
+  switch(flavor_) {
+    case AuxT:
+    case ComplexT:
+    case FloatT:
+      break;
+    case IntegerT: {
+      h = llvm::hash_combine(h, castToBIntegerType()->isUnsigned());
+      break;
+    }
+    case PointerT: {
+      h = llvm::hash_combine(h, childHash(castToBPointerType()->toType()));
+      break;
+    }
+    case ArrayT: {
+      const BArrayType *bat = castToBArrayType();
+      h = llvm::hash_combine(h, childHash(bat->elemType()));
+      if (bat->nelements())
+        h = llvm::hash_combine(h, bat->nelSize());
+      break;
+    }
+    case StructT: {
+      const BStructType *bst = castToBStructType();
+      for (auto &f : bst->fields())
+        h = llvm::hash_combine(h, f.name, childHash(f.btype));
+      break;
+    }
+    case FunctionT: {
+      const BFunctionType *bft = castToBFunctionType();
+      h = llvm::hash_combine(h, bft->followsCabi(),
+                             childHash(bft->receiverType()),
+                             childHash(bft->resultType()));
+      for (auto pt : bft->paramTypes())
+        h = llvm::hash_combine(h, childHash(pt));
+      break;
+    }
+  }
+  return static_cast<unsigned>(h);
 }
 
 Btype *Btype::clone() const
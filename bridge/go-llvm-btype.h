@@ -44,7 +44,7 @@ class Btype {
   };
   Btype(TyFlavor flavor, llvm::Type *type, Location location)
       : type_(type), location_(location), flavor_(flavor),
-        isPlaceholder_(false) { }
+        isPlaceholder_(false), hash_(0), hashValid_(false) { }
   virtual ~Btype() { }
 
   TyFlavor flavor() const { return flavor_; }
@@ -53,11 +53,11 @@ class Btype {
 
   // Underlying LLVM type.
   llvm::Type *type() const { return type_; }
-  void setType(llvm::Type *t) { assert(t); type_ = t; }
+  void setType(llvm::Type *t) { assert(t); type_ = t; invalidateHash(); }
 
   // Name of type if named.
   const std::string &name() const { return name_; }
-  void setName(const std::string &name) { name_ = name; }
+  void setName(const std::string &name) { name_ = name; invalidateHash(); }
 
   // Whether this type is a placeholder. This can be set for type
   // explicitly created as placeholders (for example, something
@@ -87,7 +87,8 @@ class Btype {
   // test for structural equality (ignores type names)
   bool equivalent(const Btype &other) const;
 
-  // hash
+  // Hash value consistent with equal(). This is computed on first
+  // use and cached; see computeHash() for what goes into it.
   unsigned hash() const;
 
   // Cast to derived class (these return NULL if the type
@@ -107,15 +108,23 @@ class Btype {
   inline const BFloatType *castToBFloatType() const;
   inline const BFunctionType *castToBFunctionType() const;
 
+ protected:
+  // Derived classes call this when an attribute that feeds into
+  // the hash value is changed.
+  void invalidateHash() { hashValid_ = false; }
+
  private:
   enum  CompareCtl { Default=0, IgnoreNames=1 };
   bool equalImpl(const Btype &other, CompareCtl ctl) const;
-  Btype() : type_(NULL) {}
+  unsigned computeHash() const;
+  Btype() : type_(NULL), hash_(0), hashValid_(false) {}
   std::string name_;
   llvm::Type *type_;
   Location location_;
   TyFlavor flavor_;
   bool isPlaceholder_;
+  mutable unsigned hash_;
+  mutable bool hashValid_;
 };
 
 class BIntegerType : public Btype {
@@ -223,6 +232,7 @@ class BStructType : public Btype {
   void setFieldType(unsigned idx, Btype *t) {
     assert(t);
     fields_[idx].btype = t;
+    invalidateHash();
   }
   const std::string &fieldName(unsigned idx) const {
     return fields_[idx].name;
@@ -232,6 +242,7 @@ class BStructType : public Btype {
   }
   void setFields(const std::vector<Backend::Btyped_identifier> &fields) {
     fields_ = fields;
+    invalidateHash();
   }
 
   // Create a shallow copy of this type
@@ -282,11 +293,12 @@ class BArrayType : public Btype {
     elemType_ = t;
     if (elemType_->isPlaceholder())
       setPlaceholder(true);
+    invalidateHash();
   }
   Bexpression *nelements() const {
     return nelements_;
   }
-  void setNelements(Bexpression *nel) { nelements_ = nel; }
+  void setNelements(Bexpression *nel) { nelements_ = nel; invalidateHash(); }
   uint64_t nelSize() const;
 
   // Create a shallow copy of this type
@@ -330,6 +342,7 @@ class BPointerType : public Btype {
   }
   void setToType(Btype *to) {
     toType_ = to;
+    invalidateHash();
   }
 
   // Create a shallow copy of this type
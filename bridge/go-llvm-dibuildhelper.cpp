@@ -30,8 +30,8 @@ DIBuildHelper::DIBuildHelper(llvm::Module *module,
                              TypeManager *typemanager,
                              Llvm_linemap *linemap)
     : module_(module), typemanager_(typemanager), linemap_(linemap), moduleScope_(nullptr),
-      dibuilder_(new llvm::DIBuilder(*module)), topblock_(nullptr),
-      entryBlock_(nullptr), known_locations_(0)
+      dibuilder_(new llvm::DIBuilder(*module)), lineTablesOnly_(false),
+      topblock_(nullptr), entryBlock_(nullptr), known_locations_(0)
 {
 }
 
@@ -48,10 +48,20 @@ void DIBuildHelper::createCompileUnitIfNeeded()
   bool isOptimized = true;
   std::string compileFlags; // FIXME
   unsigned runtimeVersion = 0; // not sure what would be for Go
+  auto emissionKind = (lineTablesOnly_ ?
+                       llvm::DICompileUnit::LineTablesOnly :
+                       llvm::DICompileUnit::FullDebug);
+  // With split DWARF, ask for GNU-style pubnames, so that the linker
+  // can build a .gdb_index without looking at the .dwo files.
+  auto nameTableKind = (splitDwarfFile_.empty() ?
+                        llvm::DICompileUnit::DebugNameTableKind::Default :
+                        llvm::DICompileUnit::DebugNameTableKind::GNU);
   moduleScope_ =
       dibuilder_->createCompileUnit(llvm::dwarf::DW_LANG_Go, primaryFile,
                                     "llvm-goc", isOptimized,
-                                    compileFlags, runtimeVersion);
+                                    compileFlags, runtimeVersion,
+                                    splitDwarfFile_, emissionKind,
+                                    0, true, false, nameTableKind);
   pushDIScope(moduleScope_);
 
   module_->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
@@ -84,6 +94,8 @@ void DIBuildHelper::finalize()
 
 void DIBuildHelper::processGlobal(Bvariable *v, bool isExported)
 {
+  if (lineTablesOnly_)
+    return;
   globalsToProcess_.push_back(std::make_pair(v, isExported));
 }
 
@@ -103,11 +115,17 @@ void DIBuildHelper::beginFunction(Bfunction *function,
 
   known_locations_ = 0;
 
-  // Create proper DIType for function
-  llvm::DIType *dit =
-      typemanager()->buildDIType(function->fcnType(), *this);
-  llvm::DISubroutineType *dst =
-      llvm::cast<llvm::DISubroutineType>(dit);
+  // Create proper DIType for function (or, for line tables only, a
+  // placeholder with no parameter/result types).
+  llvm::DISubroutineType *dst = nullptr;
+  if (lineTablesOnly_) {
+    dst = dibuilder().createSubroutineType(
+        dibuilder().getOrCreateTypeArray(llvm::None));
+  } else {
+    llvm::DIType *dit =
+        typemanager()->buildDIType(function->fcnType(), *this);
+    dst = llvm::cast<llvm::DISubroutineType>(dit);
+  }
 
   // Now the function entry itself
   unsigned fcnLine = linemap()->location_line(function->location());
@@ -129,6 +147,8 @@ void DIBuildHelper::beginFunction(Bfunction *function,
 void DIBuildHelper::processVarsInBLock(const std::vector<Bvariable*> &vars,
                                        llvm::DIScope *scope)
 {
+  if (lineTablesOnly_)
+    return;
   for (auto &v : vars) {
     if (v->isTemporary())
       continue;
@@ -193,9 +213,13 @@ void DIBuildHelper::endFunction(Bfunction *function)
   cleanFileScope();
   llvm::DISubprogram *fscope = llvm::cast<llvm::DISubprogram>(currentDIScope());
 
-  // Create debug meta-data for parameter variables.
+  // Create debug meta-data for parameter variables (not needed for
+  // line tables).
   unsigned argIdx = 0;
-  for (auto &v : function->getParameterVars()) {
+  std::vector<Bvariable *> params;
+  if (!lineTablesOnly_)
+    params = function->getParameterVars();
+  for (auto &v : params) {
     llvm::DIFile *vfile = diFileFromLocation(v->location());
     llvm::DIType *vdit =
         typemanager()->buildDIType(v->btype(), *this);
@@ -235,7 +259,8 @@ void DIBuildHelper::endFunction(Bfunction *function)
 // debug generation purposes, so here we examine each block to see
 // whether it makes sense to generate a DWARF lexical scope record for
 // it. In particular, we look for blocks containing no user-visible
-// variables (these can be omitted).
+// variables (these can be omitted), and with -gline-tables-only no
+// block is of interest.
 //
 // Return TRUE if this is an interesting block (needs DWARF scope) or
 // FALSE otherwise.
@@ -243,6 +268,8 @@ void DIBuildHelper::endFunction(Bfunction *function)
 bool DIBuildHelper::interestingBlock(Bblock *block)
 {
   assert(block);
+  if (lineTablesOnly_)
+    return false;
   bool foundInteresting = false;
   for (auto &v : block->vars()) {
     if (! v->isTemporary()) {
@@ -71,6 +71,16 @@ class DIBuildHelper {
   // Support for -fdebug-prefix
   void addDebugPrefix(std::pair<llvm::StringRef, llvm::StringRef>);
 
+  // Support for -gline-tables-only: emit only what is needed for line
+  // tables (compile unit, subprograms and locations), skipping
+  // variables, types and lexical blocks.
+  void setLineTablesOnly() { lineTablesOnly_ = true; }
+  bool lineTablesOnly() const { return lineTablesOnly_; }
+
+  // Support for -gsplit-dwarf: name of the .dwo file that will hold
+  // the bulk of the debug info, recorded in the compile unit.
+  void setSplitDwarfFile(const std::string &file) { splitDwarfFile_ = file; }
+
   // Return module scope
   llvm::DIScope *moduleScope() const { return moduleScope_; }
 
@@ -105,6 +115,8 @@ class DIBuildHelper {
   std::unordered_map<Btype *, llvm::DIType*> typeCache_;
   std::unordered_map<std::string, std::string> debugPrefixMap_;
   std::vector<std::pair<Bvariable *, bool> > globalsToProcess_;
+  std::string splitDwarfFile_;
+  bool lineTablesOnly_;
 
   // The following items are specific to the current function we're visiting.
   std::unordered_set<Bvariable *> declared_;
@@ -86,6 +86,10 @@ Llvm_linemap::start_file(const char *file_name, unsigned line_begin)
   firsthandle_ = NoHandle;
   lasthandle_ = NoHandle;
 
+  auto ait = aliases_.find(std::string(file_name));
+  if (ait != aliases_.end())
+    file_name = ait->second.c_str();
+
   // Locate the file in the file table, adding new entry if needed
   auto it = fmap_.find(std::string(file_name));
   unsigned fidx = files_.size();
@@ -100,6 +104,12 @@ Llvm_linemap::start_file(const char *file_name, unsigned line_begin)
   in_file_ = true;
 }
 
+void
+Llvm_linemap::add_file_alias(const std::string& path, const std::string& name)
+{
+  aliases_[path] = name;
+}
+
 // Stringify a location
 
 std::string
@@ -77,6 +77,13 @@ class Llvm_linemap : public Linemap
   static Llvm_linemap*
   instance();
 
+  // Record locations in the file opened as 'path' under 'name'
+  // instead. Used when an input is read through a stand-in path (for
+  // example an in-memory file), so that diagnostics and debug info
+  // show the name the user knows it by.
+  void
+  add_file_alias(const std::string& path, const std::string& name);
+
  private:
 
   // File/line/column container
@@ -121,6 +128,8 @@ class Llvm_linemap : public Linemap
   std::vector<std::string> files_;
   // Maps source file to index in the files_ array.
   std::map<std::string, unsigned> fmap_;
+  // Names to use for files opened under other paths.
+  std::map<std::string, std::string> aliases_;
   // Sorted table of segments, used to record file id for ranges of handles.
   std::vector<Segment> segments_;
   // Array of ULEB-encoded line/col pairs.
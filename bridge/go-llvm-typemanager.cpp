@@ -153,6 +153,7 @@ void TypeManager::updatePlaceholderUnderlyingType(Btype *pht,
   assert(pht->isPlaceholder());
 
   // make changes
+  placeholderProxies_.clear();
   pht->setType(newtyp->type());
   if (! newtyp->isPlaceholder())
     pht->setPlaceholder(false);
@@ -790,7 +791,7 @@ Btype *TypeManager::elementTypeByIndex(Btype *btype, unsigned fieldIndex)
   return at->elemType();
 }
 
-void TypeManager::postProcessResolvedPointerPlaceholder(BPointerType *bpt,
+bool TypeManager::postProcessResolvedPointerPlaceholder(BPointerType *bpt,
                                                         Btype *btype)
 {
   assert(bpt);
@@ -814,31 +815,33 @@ void TypeManager::postProcessResolvedPointerPlaceholder(BPointerType *bpt,
   if (wasHashed)
     reinstallAnonType(bpt);
 
-  postProcessResolvedPlaceholder(bpt);
+  return true;
 }
 
-void TypeManager::postProcessResolvedStructPlaceholder(BStructType *bst,
+bool TypeManager::postProcessResolvedStructPlaceholder(BStructType *bst,
                                                        Btype *btype)
 {
   assert(bst);
   assert(bst->isPlaceholder());
 
-  std::vector<Btyped_identifier> fields(bst->fields());
-  bool hasPl = false;
-  for (unsigned i = 0; i < fields.size(); ++i) {
-    const Btype *ft = fields[i].btype;
-    if (btype == ft) {
-      if (traceLevel() > 1) {
+  const std::vector<Btyped_identifier> &fields = bst->fields();
+  if (traceLevel() > 1) {
+    for (unsigned i = 0; i < fields.size(); ++i) {
+      if (fields[i].btype == btype)
         std::cerr << "\n^ resolving field " << i << " of "
                   << "placeholder struct type "
                   << ((void*)bst) << " to concrete field type "
                   << ((void*)btype) << "\n";
-      }
-    } else if (fields[i].btype->isUnresolvedPlaceholder()) {
-      hasPl = true;
     }
   }
+
+  // Pick up the scan where the last visit to this struct left off.
+  unsigned &idx = unresolvedFieldIdx_[bst];
+  while (idx < fields.size() && !fields[idx].btype->isUnresolvedPlaceholder())
+    ++idx;
+  bool hasPl = (idx < fields.size());
   if (! hasPl) {
+    unresolvedFieldIdx_.erase(bst);
 
     bst->setPlaceholder(false);
 
@@ -861,12 +864,11 @@ void TypeManager::postProcessResolvedStructPlaceholder(BStructType *bst,
                 << ((void*)bst) << " to concrete struct type:\n";
       bst->dump();
     }
-
-    postProcessResolvedPlaceholder(bst);
   }
+  return !hasPl;
 }
 
-void TypeManager::postProcessResolvedArrayPlaceholder(BArrayType *bat,
+bool TypeManager::postProcessResolvedArrayPlaceholder(BArrayType *bat,
                                                        Btype *btype)
 {
   assert(bat);
@@ -894,10 +896,10 @@ void TypeManager::postProcessResolvedArrayPlaceholder(BArrayType *bat,
   if (wasHashed)
     reinstallAnonType(bat);
 
-  postProcessResolvedPlaceholder(bat);
+  return true;
 }
 
-void TypeManager::postProcessResolvedFunctionPlaceholder(BFunctionType *bft,
+bool TypeManager::postProcessResolvedFunctionPlaceholder(BFunctionType *bft,
                                                          Btype *btype)
 {
   assert(bft);
@@ -924,7 +926,7 @@ void TypeManager::postProcessResolvedFunctionPlaceholder(BFunctionType *bft,
   if (wasHashed)
     reinstallAnonType(bft);
 
-  postProcessResolvedPlaceholder(bft);
+  return true;
 }
 
 // When one of the "set_placeholder_*_type()" methods is called to
@@ -942,43 +944,48 @@ void TypeManager::postProcessResolvedFunctionPlaceholder(BFunctionType *bft,
 // placeholders_ set, so as to make sure we can delete it at the end
 // of the compilation (this is managed by reinstallAnonType).
 //
+// The placeholderRefs_ table forms a dependency graph (resolved type
+// to referring types); we walk it with an explicit worklist, pushing
+// each type as it becomes concrete, so that a single resolution event
+// touches each edge once and long chains of mutually recursive types
+// don't translate into deep recursion.
+//
 void TypeManager::postProcessResolvedPlaceholder(Btype *btype)
 {
-  auto it = placeholderRefs_.find(btype);
-  if (it == placeholderRefs_.end())
-    return;
-
-  for (auto refType : it->second) {
-
-    if (!refType->isPlaceholder())
-      continue;
-
-    BPointerType *bpt = refType->castToBPointerType();
-    if (bpt) {
-      postProcessResolvedPointerPlaceholder(bpt, btype);
+  placeholderProxies_.clear();
+
+  llvm::SmallVector<Btype *, 32> worklist;
+  worklist.push_back(btype);
+  while (!worklist.empty()) {
+    Btype *resolved = worklist.pop_back_val();
+    auto it = placeholderRefs_.find(resolved);
+    if (it == placeholderRefs_.end())
       continue;
-    }
 
-    BArrayType *bat = refType->castToBArrayType();
-    if (bat) {
-      postProcessResolvedArrayPlaceholder(bat, btype);
-      continue;
+    for (auto refType : it->second) {
+
+      if (!refType->isPlaceholder())
+        continue;
+
+      bool nowResolved = false;
+      BPointerType *bpt = refType->castToBPointerType();
+      BArrayType *bat = refType->castToBArrayType();
+      BStructType *bst = refType->castToBStructType();
+      BFunctionType *bft = refType->castToBFunctionType();
+      if (bpt)
+        nowResolved = postProcessResolvedPointerPlaceholder(bpt, resolved);
+      else if (bat)
+        nowResolved = postProcessResolvedArrayPlaceholder(bat, resolved);
+      else if (bst)
+        nowResolved = postProcessResolvedStructPlaceholder(bst, resolved);
+      else if (bft)
+        nowResolved = postProcessResolvedFunctionPlaceholder(bft, resolved);
+      else
+        assert(false && "unexpected placeholder reference");
+
+      if (nowResolved)
+        worklist.push_back(refType);
     }
-
-    BStructType *bst = refType->castToBStructType();
-    if (bst) {
-      postProcessResolvedStructPlaceholder(bst, btype);
-      continue;
-    }
-
-    BFunctionType *bft = refType->castToBFunctionType();
-    if (bft) {
-      postProcessResolvedFunctionPlaceholder(bft, btype);
-      continue;
-    }
-
-    // Should never get here
-    assert(false);
   }
 }
 
@@ -1060,7 +1067,11 @@ bool TypeManager::setPlaceholderPointerType(Btype *placeholder,
   if (it != circularFunctionTypes_.end())
     circularFunctionTypes_.insert(to_type->type());
 
-  // Update the target type for the pointer
+  // Update the target type for the pointer. Circular pointer types
+  // may get here after they stopped being placeholders, so drop any
+  // cached layout as well.
+  placeholderProxies_.clear();
+  typeLayouts_.erase(placeholder);
   BPointerType *bpt = placeholder->castToBPointerType();
   BPointerType *ttpt = to_type->castToBPointerType();
   bpt->setToType(ttpt->toType());
@@ -1107,6 +1118,8 @@ TypeManager::setPlaceholderStructType(Btype *placeholder,
   assert(placeholders_.find(placeholder) != placeholders_.end());
   BStructType *phst = placeholder->castToBStructType();
   assert(phst);
+  placeholderProxies_.clear();
+  unresolvedFieldIdx_.erase(phst);
   phst->setFields(fields);
 
   // If we still have fields with placeholder types, then we still can't
@@ -1155,6 +1168,7 @@ bool TypeManager::setPlaceholderArrayType(Btype *placeholder,
 
   BArrayType *phat = placeholder->castToBArrayType();
   assert(phat);
+  placeholderProxies_.clear();
   phat->setElemType(element_btype);
   phat->setNelements(length);
   bool isplace = addPlaceholderRefs(phat);
@@ -1460,16 +1474,45 @@ llvm::Type *TypeManager::placeholderProxyType(Btype *typ,
 // types that still incorporate placeholders.
 llvm::Type *TypeManager::getPlaceholderProxyIfNeeded(Btype *btype)
 {
+  auto it = placeholderProxies_.find(btype);
+  if (it != placeholderProxies_.end())
+    return it->second;
   llvm::Type *toget = btype->type();
   llvm::SmallPtrSet<llvm::Type *, 32> vis;
   if (!btype->type()->isSized(&vis)) {
-    pproxymap pmap;
-    toget = placeholderProxyType(btype, &pmap);
+    toget = placeholderProxyType(btype, &placeholderProxies_);
     assert(toget);
   }
   return toget;
 }
 
+// Layout queries on concrete types are very frequent (the front end
+// issues them repeatedly while laying out type descriptors and GC
+// data), so the results are cached per Btype. Only types whose LLVM
+// type is sized are cached: their layout is fixed from that point
+// on. Anything still containing placeholders goes through the proxy
+// path in getPlaceholderProxyIfNeeded instead.
+
+const TypeManager::TypeLayout *TypeManager::getTypeLayout(Btype *btype)
+{
+  auto it = typeLayouts_.find(btype);
+  if (it != typeLayouts_.end())
+    return &it->second;
+  if (btype->isPlaceholder())
+    return nullptr;
+  llvm::Type *lt = btype->type();
+  llvm::SmallPtrSet<llvm::Type *, 32> vis;
+  if (!lt->isSized(&vis))
+    return nullptr;
+
+  TypeLayout &tl = typeLayouts_[btype];
+  tl.type = lt;
+  tl.size = static_cast<int64_t>(datalayout_->getTypeAllocSize(lt));
+  tl.align = static_cast<int64_t>(datalayout_->getABITypeAlignment(lt));
+  tl.fieldAlign = llvmTypeFieldAlignment(lt);
+  return &tl;
+}
+
 // Return the size of a type.
 
 // Note: frontend sometimes asks for the size of a placeholder
@@ -1481,6 +1524,8 @@ llvm::Type *TypeManager::getPlaceholderProxyIfNeeded(Btype *btype)
 int64_t TypeManager::typeSize(Btype *btype) {
   if (btype == errorType_)
     return 1;
+  if (const TypeLayout *tl = getTypeLayout(btype))
+    return tl->size;
   llvm::Type *toget = getPlaceholderProxyIfNeeded(btype);
   uint64_t uvalbytes = datalayout_->getTypeAllocSize(toget);
   return static_cast<int64_t>(uvalbytes);
@@ -1505,6 +1550,8 @@ uint64_t TypeManager::llvmTypeSize(llvm::Type *t)
 int64_t TypeManager::typeAlignment(Btype *btype) {
   if (btype == errorType_)
     return 1;
+  if (const TypeLayout *tl = getTypeLayout(btype))
+    return tl->align;
   llvm::Type *toget = getPlaceholderProxyIfNeeded(btype);
   unsigned uval = datalayout_->getABITypeAlignment(toget);
   return static_cast<int64_t>(uval);
@@ -1520,6 +1567,8 @@ int64_t TypeManager::typeAlignment(Btype *btype) {
 int64_t TypeManager::typeFieldAlignment(Btype *btype) {
   if (btype == errorType_)
     return -1;
+  if (const TypeLayout *tl = getTypeLayout(btype))
+    return tl->fieldAlign;
 
   llvm::Type *toget = getPlaceholderProxyIfNeeded(btype);
 
@@ -1527,19 +1576,29 @@ int64_t TypeManager::typeFieldAlignment(Btype *btype) {
   if (!toget->isSized())
     return -1;
 
+  return llvmTypeFieldAlignment(toget);
+}
+
+int64_t TypeManager::llvmTypeFieldAlignment(llvm::Type *t)
+{
+  auto it = llvmFieldAligns_.find(t);
+  if (it != llvmFieldAligns_.end())
+    return it->second;
+
   // Create a new anonymous struct with two fields: first field is a
-  // single byte, second field is of type btype. Then use
+  // single byte, second field is of type t. Then use
   // getElementOffset to find out where the second one has been
-  // placed. Finally, return min of alignof(btype) and that value.
+  // placed. Finally, return min of alignof(t) and that value.
 
   llvm::SmallVector<llvm::Type *, 2> elems(2);
   elems[0] = llvm::Type::getInt1Ty(context_);
-  elems[1] = toget;
+  elems[1] = t;
   llvm::StructType *dummyst = llvm::StructType::get(context_, elems);
   const llvm::StructLayout *sl = datalayout_->getStructLayout(dummyst);
   uint64_t uoff = sl->getElementOffset(1);
-  unsigned talign = datalayout_->getABITypeAlignment(toget);
+  unsigned talign = datalayout_->getABITypeAlignment(t);
   int64_t rval = (uoff < talign ? uoff : talign);
+  llvmFieldAligns_[t] = rval;
   return rval;
 }
 
@@ -1549,7 +1608,8 @@ int64_t TypeManager::typeFieldOffset(Btype *btype, size_t index) {
   if (btype == errorType_)
     return 0;
 
-  llvm::Type *toget = getPlaceholderProxyIfNeeded(btype);
+  const TypeLayout *tl = getTypeLayout(btype);
+  llvm::Type *toget = (tl ? tl->type : getPlaceholderProxyIfNeeded(btype));
   assert(toget->isStructTy());
   llvm::StructType *llvm_st = llvm::cast<llvm::StructType>(toget);
   return llvmTypeFieldOffset(llvm_st, index);
@@ -150,6 +150,9 @@ class TypeManager {
   // Return byte offset of field FIDX in llvm struct type LLST
   int64_t llvmTypeFieldOffset(llvm::StructType *llst, size_t fidx);
 
+  // Returns alignment of sized LLVM type T when used as a struct field.
+  int64_t llvmTypeFieldAlignment(llvm::Type *t);
+
   // Context + address space.
   llvm::LLVMContext &context() const { return context_; }
   unsigned addressSpace() const { return addressSpace_; }
@@ -194,11 +197,12 @@ class TypeManager {
   // and see if we can completely resolve them.
   void postProcessResolvedPlaceholder(Btype *btype);
 
-  // Helpers for the routine above
-  void postProcessResolvedPointerPlaceholder(BPointerType *bpt, Btype *btype);
-  void postProcessResolvedStructPlaceholder(BStructType *bst, Btype *btype);
-  void postProcessResolvedArrayPlaceholder(BArrayType *bat, Btype *btype);
-  void postProcessResolvedFunctionPlaceholder(BFunctionType *bft, Btype *btype);
+  // Helpers for the routine above. Each returns true if the referring
+  // type is now fully resolved (and so its own referrers need a visit).
+  bool postProcessResolvedPointerPlaceholder(BPointerType *bpt, Btype *btype);
+  bool postProcessResolvedStructPlaceholder(BStructType *bst, Btype *btype);
+  bool postProcessResolvedArrayPlaceholder(BArrayType *bat, Btype *btype);
+  bool postProcessResolvedFunctionPlaceholder(BFunctionType *bft, Btype *btype);
 
   // For a newly create type, adds entries to the placeholderRefs
   // table for any contained types. Returns true if any placeholders
@@ -284,6 +288,29 @@ class TypeManager {
   // otherwise returns the LLVM type for the specified Btype.
   llvm::Type *getPlaceholderProxyIfNeeded(Btype *btype);
 
+  // Proxy types computed by the routine above. These stay valid until
+  // the next placeholder is filled in or resolved, at which point the
+  // whole table is dropped.
+  pproxymap placeholderProxies_;
+
+  // Size/alignment info for a Btype whose LLVM type is sized. Once a
+  // type is sized its layout can't change, so this is computed once
+  // per Btype and kept in the table below.
+  struct TypeLayout {
+    llvm::Type *type;
+    int64_t size;
+    int64_t align;
+    int64_t fieldAlign;
+  };
+  std::unordered_map<Btype *, TypeLayout> typeLayouts_;
+
+  // Returns cached layout info for 'btype', or NULL if the type still
+  // contains placeholders (in which case a proxy has to be used).
+  const TypeLayout *getTypeLayout(Btype *btype);
+
+  // Field alignments for sized LLVM types (see llvmTypeFieldAlignment).
+  std::unordered_map<llvm::Type *, int64_t> llvmFieldAligns_;
+
   // Context information needed for the LLVM backend.
   llvm::LLVMContext &context_;
   const llvm::DataLayout *datalayout_;
@@ -335,6 +362,12 @@ class TypeManager {
   // types A, B, and C.
   std::unordered_map<Btype *, std::set<Btype *> > placeholderRefs_;
 
+  // For placeholder structs with unresolved fields, the index of the
+  // first field not yet known to be resolved. Fields only ever go from
+  // unresolved to resolved, so each struct's fields are scanned once
+  // in total no matter how many resolution events touch the struct.
+  std::unordered_map<Btype *, unsigned> unresolvedFieldIdx_;
+
   // Set of circular pointer types. These are pointers to opaque types that
   // are returned by the ::circular_pointer_type() method.
   std::unordered_set<llvm::Type *> circularPointerTypes_;
@@ -58,6 +58,8 @@ Llvm_backend::Llvm_backend(llvm::LLVMContext &context,
     , noInline_(false)
     , noFpElim_(false)
     , useSplitStack_(true)
+    , xrayInstrument_(false)
+    , xrayThreshold_(0u)
     , compilingRuntime_(false)
     , checkIntegrity_(true)
     , createDebugMetaData_(true)
@@ -161,6 +163,18 @@ void Llvm_backend::addDebugPrefix(std::pair<llvm::StringRef, llvm::StringRef> pr
   dibuildhelper_->addDebugPrefix(prefix);
 }
 
+void Llvm_backend::setDebugLineTablesOnly()
+{
+  if (dibuildhelper_)
+    dibuildhelper_->setLineTablesOnly();
+}
+
+void Llvm_backend::setSplitDwarfFile(const std::string &file)
+{
+  if (dibuildhelper_)
+    dibuildhelper_->setSplitDwarfFile(file);
+}
+
 void Llvm_backend::setTargetCpuAttr(const std::string &cpu)
 {
   targetCpuAttr_ = cpu;
@@ -171,6 +185,11 @@ void Llvm_backend::setTargetFeaturesAttr(const std::string &attrs)
   targetFeaturesAttr_ = attrs;
 }
 
+void Llvm_backend::setTargetTuneCpuAttr(const std::string &cpu)
+{
+  targetTuneCpuAttr_ = cpu;
+}
+
 void
 Llvm_backend::verifyModule()
 {
@@ -2348,6 +2367,13 @@ Bvariable *Llvm_backend::static_chain_variable(Bfunction *function,
 {
   if (function == errorFunction_.get() || btype == errorType())
     return errorVariable_.get();
+
+  // The x86_64 XRay entry sled passes the function id in R10, which
+  // is also where the static chain arrives, so a function that reads
+  // its static chain can't be instrumented.
+  if (xrayInstrument_ && triple_.getArch() == llvm::Triple::x86_64)
+    function->function()->addFnAttr("function-instrument", "xray-never");
+
   return function->staticChainVariable(name, btype, location);
 }
 
@@ -2614,12 +2640,50 @@ Bfunction *Llvm_backend::error_function()
 }
 
 // This is a list of functions the call sites of which are not
-// GC statepoints.
+// GC statepoints. Apart from the write barrier functions, these are
+// runtime helpers that neither allocate nor call into the scheduler,
+// so a GC cannot happen while they run (stack growth is fine, since
+// split stacks never move frames). Go functions in the current
+// package with the same property are found by the statepoint pass.
 //
 // Keep this sync with the runtime and the frontend.
 static std::string gcleaffuncs[] = {
   "runtime.gcWriteBarrier",
   "runtime.typedmemmove",
+  // alg.go
+  "runtime.memequal",
+  "runtime.memequal0",
+  "runtime.memequal8",
+  "runtime.memequal16",
+  "runtime.memequal32",
+  "runtime.memequal64",
+  "runtime.memequal128",
+  "runtime.f32equal",
+  "runtime.f64equal",
+  "runtime.c64equal",
+  "runtime.c128equal",
+  "runtime.strequal",
+  "runtime.memhash",
+  "runtime.memhash0",
+  "runtime.memhash8",
+  "runtime.memhash16",
+  "runtime.memhash32",
+  "runtime.memhash64",
+  "runtime.memhash128",
+  "runtime.f32hash",
+  "runtime.f64hash",
+  "runtime.c64hash",
+  "runtime.c128hash",
+  "runtime.strhash",
+  // string.go, utf8.go
+  "runtime.cmpstring",
+  "runtime.decoderune",
+  "runtime.encoderune",
+  // memclr, time and random numbers
+  "runtime.memclrNoHeapPointers",
+  "runtime.nanotime",
+  "runtime.fastrand",
+  "runtime.fastrandn",
 };
 
 static bool isGCLeaf(std::string name)
@@ -2632,6 +2696,23 @@ static bool isGCLeaf(std::string name)
 
 }
 
+// Returns true if 'name' is the symbol for a package initializer, either
+// the one synthesized by the front end ("<pkgpath>..import", or
+// "__go_init_main" for the main package) or one of the user-written
+// "init" functions it calls ("<pkgpath>.init.<N>").
+
+static bool isInitFunction(llvm::StringRef name)
+{
+  if (name == "__go_init_main" || name.endswith("..import"))
+    return true;
+  size_t pos = name.rfind(".init.");
+  if (pos == llvm::StringRef::npos)
+    return false;
+  llvm::StringRef suffix = name.substr(pos + strlen(".init."));
+  return !suffix.empty() &&
+      suffix.find_first_not_of("0123456789") == llvm::StringRef::npos;
+}
+
 // Declare or define a new function.
 
 Bfunction *Llvm_backend::function(Btype *fntype, const std::string &name,
@@ -2716,6 +2797,14 @@ Bfunction *Llvm_backend::function(Btype *fntype, const std::string &name,
     // allow elim frame pointer or not
     fcn->addFnAttr("frame-pointer", noFpElim_ ? "all" : "none");
 
+    // XRay sleds. Nosplit functions are left alone, since the XRay
+    // trampolines use more stack than such functions are allowed to,
+    // as is the runtime, which a handler written in Go would reenter.
+    if (xrayInstrument_ && !compilingRuntime_ &&
+        (flags & Backend::function_no_split_stack) == 0)
+      fcn->addFnAttr("xray-instruction-threshold",
+                     std::to_string(xrayThreshold_));
+
     // set suffix elision policy if autoFDO in effect
     if (autoFDO_)
       fcn->addFnAttr("sample-profile-suffix-elision-policy", "selected");
@@ -2727,11 +2816,19 @@ Bfunction *Llvm_backend::function(Btype *fntype, const std::string &name,
     // attributes for target CPU and features
     fcn->addFnAttr("target-cpu", targetCpuAttr_);
     fcn->addFnAttr("target-features", targetFeaturesAttr_);
+    if (!targetTuneCpuAttr_.empty())
+      fcn->addFnAttr("tune-cpu", targetTuneCpuAttr_);
 
     // attribute for GC leaf function (i.e. not a statepoint)
     if (isGCLeaf(fns))
       fcn->addFnAttr("gc-leaf-function");
 
+    // Package initializers run once at startup; placing them in
+    // .text.startup.* lets the linker keep them (and the page faults
+    // they take) together instead of spread through the text segment.
+    if (isInitFunction(fns))
+      fcn->setSectionPrefix("startup");
+
     auto nonNullAttr = llvm::Attribute::get(context_,
                                             llvm::Attribute::NonNull);
     auto noAliasAttr = llvm::Attribute::get(context_,
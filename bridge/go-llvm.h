@@ -344,6 +344,12 @@ public:
   // Support for -fdebug-prefix=
   void addDebugPrefix(std::pair<llvm::StringRef, llvm::StringRef> prefix);
 
+  // Support for -gline-tables-only
+  void setDebugLineTablesOnly();
+
+  // Support for -gsplit-dwarf
+  void setSplitDwarfFile(const std::string &file);
+
   // Bnode builder
   BnodeBuilder &nodeBuilder() { return nbuilder_; }
 
@@ -399,9 +405,17 @@ public:
   // Enable/disable the use of split stacks.
   void setUseSplitStack(bool b) { useSplitStack_ = b; }
 
+  // Enable XRay instrumentation of functions with at least 'threshold'
+  // machine instructions (or containing loops).
+  void setXRayInstrument(unsigned threshold) {
+    xrayInstrument_ = true;
+    xrayThreshold_ = threshold;
+  }
+
   // Target CPU and features
   void setTargetCpuAttr(const std::string &cpu);
   void setTargetFeaturesAttr(const std::string &attrs);
+  void setTargetTuneCpuAttr(const std::string &cpu);
 
   // Set GC strategy
   void setGCStrategy(std::string s) { gcStrategy_ = s; }
@@ -766,6 +780,10 @@ public:
   // Whether to use split stacks.
   bool useSplitStack_;
 
+  // Whether to emit XRay sleds, and the size threshold for doing so.
+  bool xrayInstrument_;
+  unsigned xrayThreshold_;
+
   // Whether we are compiling the runtime.
   bool compilingRuntime_;
 
@@ -864,6 +882,8 @@ public:
   // Target cpu and attributes to be attached to any generated fcns.
   std::string targetCpuAttr_;
   std::string targetFeaturesAttr_;
+  // CPU to tune for, if different from targetCpuAttr_ (empty if none).
+  std::string targetTuneCpuAttr_;
 
   // GC strategy
   std::string gcStrategy_;
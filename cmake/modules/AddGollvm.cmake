@@ -23,6 +23,41 @@ set(GOLLVM_INSTALL_LIBDIR "${CMAKE_INSTALL_PREFIX}/${libsubdir}")
 
 message(STATUS "default linker set to \"${GOLLVM_DEFAULT_LINKER}\"")
 
+# In-process linking needs lld to be built as part of the same tree.
+if(GOLLVM_USE_LLD_LIBRARY)
+  if(NOT "lld" IN_LIST LLVM_ENABLE_PROJECTS)
+    message(FATAL_ERROR "GOLLVM_USE_LLD_LIBRARY requires lld in LLVM_ENABLE_PROJECTS")
+  endif()
+  message(STATUS "-fuse-ld=lld links will be done in-process")
+endif()
+
+# LLVM targets for the architectures gollvm supports; the driver
+# registers only the one for the selected triple (see
+# driver/TargetSetup.cpp). GOLLVM_HAVE_TARGET_<name> is incorporated
+# into GollvmConfig.h for each of them that LLVM was built with.
+set(gollvm_supported_targets X86 AArch64)
+set(gollvm_llvm_targets)
+foreach(target ${gollvm_supported_targets})
+  if(target IN_LIST LLVM_TARGETS_TO_BUILD)
+    list(APPEND gollvm_llvm_targets ${target})
+    string(TOUPPER ${target} utarget)
+    set(GOLLVM_HAVE_TARGET_${utarget} ON)
+  endif()
+endforeach()
+
+# Targets linked into llvm-goc (and the driver unit tests). Since no
+# other target is ever registered, all others are dead weight unless
+# some other client of LLVMDriverUtils needs them.
+if(GOLLVM_SUPPORTED_TARGETS_ONLY)
+  if(NOT gollvm_llvm_targets)
+    message(FATAL_ERROR "GOLLVM_SUPPORTED_TARGETS_ONLY: none of \"${gollvm_supported_targets}\" in LLVM_TARGETS_TO_BUILD")
+  endif()
+  set(gollvm_link_targets ${gollvm_llvm_targets})
+  message(STATUS "llvm-goc will link only LLVM targets \"${gollvm_link_targets}\"")
+else()
+  set(gollvm_link_targets ${LLVM_TARGETS_TO_BUILD})
+endif()
+
 # Check to see whether the build compiler supports -fcf-protection=branch
 set(OLD_CMAKE_REQUIRED_FLAGS "${CMAKE_REQUIRED_FLAGS}")
 set(CMAKE_REQUIRED_FLAGS "-fcf-protection=branch")
@@ -132,5 +132,6 @@ function(add_go_package pkgpath dest)
     -DCMAKE_INSTALL_COMPONENT=${pkgtarget}
     -P "${CMAKE_BINARY_DIR}/cmake_install.cmake")
   add_dependencies(install-gollvm install-${pkgtarget})
+  set(package_installtarget install-${pkgtarget} PARENT_SCOPE)
 
 endfunction()
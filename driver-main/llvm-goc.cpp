@@ -16,6 +16,7 @@
 #include "go-llvm-diagnostics.h"
 #include "go-llvm.h"
 #include "go-c.h"
+#include "go-import-index.h"
 #include "mpfr.h"
 #include "GollvmOptions.h"
 #include "GollvmConfig.h"
@@ -123,6 +124,20 @@ bool CommandLineParser::parseCommandLine(int argc, char **argv)
     exit(0);
   }
 
+  // Honor -fgo-write-import-index=...
+  std::vector<std::string> idxdirs =
+      args_.getAllArgValues(gollvm::options::OPT_fgo_write_import_index_EQ);
+  if (!idxdirs.empty()) {
+    for (auto &dir : idxdirs) {
+      std::string err;
+      if (!GoImportIndex::write(dir, err)) {
+        errs() << progname << ": error: " << err << "\n";
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+
   // Complain about missing arguments.
   if (missingArgIndex != 0) {
     errs() << progname << ": error: argument to '"
@@ -222,13 +237,13 @@ int main(int argc, char **argv)
   if (!driver.buildActions(*compilation))
     return 2;
 
-  // Process the action list. This will carry out actions that don't
-  // require use of an external tool, and will generate a list of
-  // commands for invoking external tools.
+  // Process the action list. This will generate a list of commands,
+  // both for actions carried out by the driver itself and for
+  // invoking external tools.
   if (!driver.processActions(*compilation))
     return 3;
 
-  // Execute the external-tool command list created above.
+  // Execute the command list created above.
   if (! compilation->executeCommands())
     return 4;
 
@@ -6,12 +6,18 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// Gollvm driver helper function setupArchCpu
+// Gollvm driver helper functions setupArchCpu, setupTuneCpu and
+// setupMultiversionCpus
 //
 //===----------------------------------------------------------------------===//
 
 #include "ArchCpuSetup.h"
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Option/Arg.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/raw_ostream.h"
@@ -22,32 +28,89 @@ namespace gollvm { namespace arch {
 
 using namespace llvm;
 
-bool gollvm::driver::setupArchCpu(opt::Arg *cpuarg, std::string &cpu,
-                               std::string &attrs, Triple triple,
-                               const char *progname) {
-  std::string cpuStr;
-  if (cpuarg != nullptr) {
-    std::string val(cpuarg->getValue());
-    if (val == "native")
-      cpuStr = sys::getHostCPUName().str();
-    else
-      cpuStr = cpuarg->getValue();
+// Locate correct entry in architectures table for this triple
+static const gollvm::arch::CpuAttrs *findTripleCpus(const Triple &triple) {
+  for (unsigned i = 0; gollvm::arch::triples[i].cpuattrs != nullptr; i += 1)
+    if (!strcmp(triple.str().c_str(), gollvm::arch::triples[i].triple))
+      return gollvm::arch::triples[i].cpuattrs;
+  return nullptr;
+}
+
+// "native" only makes sense when the host can run what we generate.
+static bool checkNativeHost(const Triple &triple, const char *option,
+                            const char *progname) {
+  Triple host(sys::getProcessTriple());
+  if (host.getArch() == triple.getArch())
+    return true;
+  errs() << progname << ": " << option << "=native is not supported when "
+         << "targeting " << triple.str() << " from a "
+         << host.getArchName() << " host\n";
+  return false;
+}
+
+// Handle -march=native. The feature string comes from what the host
+// actually reports rather than from the table row for its CPU name, so
+// features masked off by a hypervisor are turned off ("-feature"), and
+// CPUs newer than the table still get their full ISA. The host CPU name
+// comes from this same LLVM, so it is usable even when it is missing
+// from the table; when the host CPU is not recognized at all the
+// table's default CPU is used as the base instead.
+static bool setupNativeCpu(const gollvm::arch::CpuAttrs *cpuAttrs,
+                           std::string &cpu, std::string &attrs,
+                           const Triple &triple, const char *progname) {
+  if (!checkNativeHost(triple, "-march", progname))
+    return false;
+
+  StringRef hostCpu = sys::getHostCPUName();
+  bool knownCpu = !hostCpu.empty() && hostCpu != "generic";
+
+  StringMap<bool> hostFeatures;
+  if (sys::getHostCPUFeatures(hostFeatures) && !hostFeatures.empty()) {
+    std::vector<std::string> feats;
+    for (auto &f : hostFeatures)
+      feats.push_back((f.second ? "+" : "-") + f.first().str());
+    llvm::sort(feats);
+    cpu = knownCpu ? hostCpu.str() : cpuAttrs->cpu;
+    attrs = join(feats, ",");
+    return true;
   }
 
-  // Locate correct entry in architectures table for this triple
-  const gollvm::arch::CpuAttrs *cpuAttrs = nullptr;
-  for (unsigned i = 0; gollvm::arch::triples[i].cpuattrs != nullptr; i += 1) {
-    if (!strcmp(triple.str().c_str(), gollvm::arch::triples[i].triple)) {
-      cpuAttrs = gollvm::arch::triples[i].cpuattrs;
-      break;
+  // No feature information for this host; use the table row for the
+  // host CPU if there is one, otherwise the default.
+  for (const gollvm::arch::CpuAttrs *ca = cpuAttrs; strlen(ca->cpu) != 0;
+       ca++) {
+    if (hostCpu == ca->cpu) {
+      cpu = ca->cpu;
+      attrs = ca->attrs;
+      return true;
     }
   }
+  errs() << progname << ": warning: unable to identify host CPU '"
+         << hostCpu << "' for -march=native, using '" << cpuAttrs->cpu
+         << "'\n";
+  cpu = cpuAttrs->cpu;
+  attrs = cpuAttrs->attrs;
+  return true;
+}
+
+bool gollvm::driver::setupArchCpu(opt::Arg *cpuarg, std::string &cpu,
+                               std::string &attrs, Triple triple,
+                               const char *progname) {
+  const gollvm::arch::CpuAttrs *cpuAttrs = findTripleCpus(triple);
   if (cpuAttrs == nullptr) {
     errs() << progname << ": unable to determine target CPU features for "
            << "target " << triple.str() << "\n";
     return false;
   }
 
+  std::string cpuStr;
+  if (cpuarg != nullptr) {
+    std::string val(cpuarg->getValue());
+    if (val == "native")
+      return setupNativeCpu(cpuAttrs, cpu, attrs, triple, progname);
+    cpuStr = val;
+  }
+
   // If no CPU specified, use first entry. Otherwise look for CPU name.
   if (!cpuStr.empty()) {
     bool found = false;
@@ -69,3 +132,76 @@ bool gollvm::driver::setupArchCpu(opt::Arg *cpuarg, std::string &cpu,
   attrs = cpuAttrs->attrs;
   return true;
 }
+
+bool gollvm::driver::setupTuneCpu(opt::Arg *tunearg, std::string &tune,
+                                  Triple triple, const char *progname) {
+  tune.clear();
+  if (tunearg == nullptr)
+    return true;
+
+  std::string val(tunearg->getValue());
+  if (val == "native") {
+    if (!checkNativeHost(triple, "-mtune", progname))
+      return false;
+    // An unrecognized host leaves the scheduling model to -march.
+    StringRef hostCpu = sys::getHostCPUName();
+    if (!hostCpu.empty() && hostCpu != "generic")
+      tune = hostCpu.str();
+    return true;
+  }
+
+  const gollvm::arch::CpuAttrs *cpuAttrs = findTripleCpus(triple);
+  if (cpuAttrs == nullptr) {
+    errs() << progname << ": unable to determine target CPU features for "
+           << "target " << triple.str() << "\n";
+    return false;
+  }
+  if (val == "generic") {
+    tune = val;
+    return true;
+  }
+  for (const gollvm::arch::CpuAttrs *ca = cpuAttrs; strlen(ca->cpu) != 0;
+       ca++) {
+    if (val == ca->cpu) {
+      tune = val;
+      return true;
+    }
+  }
+  errs() << progname << ": invalid setting for -mtune:"
+         << " -- unable to identify CPU '" << val << "'\n";
+  return false;
+}
+
+bool gollvm::driver::setupMultiversionCpus(
+    opt::Arg *mvarg,
+    std::vector<std::pair<std::string, std::string>> &cpus,
+    Triple triple, const char *progname) {
+  if (triple.getArch() != Triple::x86_64 &&
+      triple.getArch() != Triple::aarch64) {
+    errs() << progname << ": -fgo-multiversion is not supported for "
+           << "target " << triple.str() << "\n";
+    return false;
+  }
+  const gollvm::arch::CpuAttrs *cpuAttrs = findTripleCpus(triple);
+  if (cpuAttrs == nullptr) {
+    errs() << progname << ": unable to determine target CPU features for "
+           << "target " << triple.str() << "\n";
+    return false;
+  }
+
+  SmallVector<StringRef, 8> names;
+  StringRef(mvarg->getValue()).split(names, ',', -1, false);
+  for (StringRef name : names) {
+    const gollvm::arch::CpuAttrs *ca = cpuAttrs;
+    while (strlen(ca->cpu) != 0 && name != ca->cpu)
+      ca++;
+    if (strlen(ca->cpu) == 0) {
+      errs() << progname << ": invalid setting for -fgo-multiversion:"
+             << " -- unable to identify CPU '" << name << "'\n";
+      return false;
+    }
+    cpus.push_back(std::make_pair(std::string(ca->cpu),
+                                  std::string(ca->attrs)));
+  }
+  return true;
+}
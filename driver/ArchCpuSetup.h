@@ -6,7 +6,8 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// Declares gollvm driver helper function setupArchCpu.
+// Declares gollvm driver helper functions setupArchCpu, setupTuneCpu
+// and setupMultiversionCpus.
 //
 //===----------------------------------------------------------------------===//
 
@@ -15,12 +16,29 @@
 
 #include "Tool.h"
 
+#include <string>
+#include <utility>
+#include <vector>
+
 namespace gollvm {
 namespace driver {
 
 bool setupArchCpu(llvm::opt::Arg *cpuarg, std::string &cpu, std::string &attrs,
                llvm::Triple triple_, const char *progname_);
 
+// Determine the CPU to tune for (the "tune-cpu" function attribute) from
+// -mtune=, independently of the ISA chosen by -march=. Leaves tune empty
+// if there is nothing to add.
+bool setupTuneCpu(llvm::opt::Arg *tunearg, std::string &tune,
+                  llvm::Triple triple, const char *progname);
+
+// Look up the comma-separated CPU names given to -fgo-multiversion= in
+// the architectures table, appending a (cpu, attributes) pair for each.
+bool setupMultiversionCpus(llvm::opt::Arg *mvarg,
+                           std::vector<std::pair<std::string,
+                                                 std::string>> &cpus,
+                           llvm::Triple triple, const char *progname);
+
 } // end namespace driver
 } // end namespace gollvm
 
@@ -27,17 +27,40 @@ const char *Artifact::file() const
           u.arg->getValue() : u.file);
 }
 
+const char *Artifact::name() const
+{
+  return (type_ == A_Argument ?
+          u.arg->getValue() : u.file);
+}
+
 llvm::opt::Arg *Artifact::arg()
 {
   return (type_ == A_Argument ? u.arg : nullptr);
 }
 
+void Artifact::setBuffer(std::unique_ptr<llvm::MemoryBuffer> buf) const
+{
+  assert(type_ == A_Buffer);
+  buffer_ = std::move(buf);
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Artifact::contents() const
+{
+  if (type_ != A_Buffer)
+    return llvm::MemoryBuffer::getFileOrSTDIN(file());
+  assert(buffer_ && "contents of in-memory artifact not yet produced");
+  return llvm::MemoryBuffer::getMemBuffer(buffer_->getMemBufferRef(),
+                                          /*RequiresNullTerminator=*/false);
+}
+
 std::string Artifact::toString()
 {
   std::stringstream ss;
   ss << "Artifact ";
   if (type_ == A_Argument)
     ss << "arg(" << u.arg->getValue() << ")";
+  else if (type_ == A_Buffer)
+    ss << "buffer(" << u.file << ")";
   else
     ss << "file(" << u.file << ")";
   return ss.str();
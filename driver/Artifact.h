@@ -14,6 +14,11 @@
 #define GOLLVM_DRIVER_ARTIFACT_H
 
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cassert>
+#include <memory>
 
 namespace llvm {
 namespace opt {
@@ -27,13 +32,16 @@ namespace driver {
 // An artifact is a file produced or consumed by some compilation step.
 // Artifacts may correspond to user-specified files (command line arg
 // for example) or temporary files created by some intermediate phase
-// in the compilation.
+// in the compilation. An intermediate result passed from one internal
+// tool to another can instead be kept in memory (A_Buffer); such an
+// artifact has a name (for diagnostics) but no file.
 
 class Artifact {
  public:
   enum Type {
     A_Argument,
     A_TempFile,
+    A_Buffer,
     A_Empty
   };
 
@@ -48,12 +56,31 @@ class Artifact {
   explicit Artifact(const char *tempfilepath)
       : type_(A_TempFile) { u.file = tempfilepath; }
 
+  // Construct an in-memory artifact with the given name; its contents
+  // are supplied by the tool producing it, via setBuffer().
+  Artifact(Type type, const char *name)
+      : type_(type) {
+    assert(type == A_Buffer);
+    u.file = name;
+  }
+
   // Type of input
   Type type() const { return type_; }
 
-  // File for input
+  // File for input (not valid for A_Buffer artifacts).
   const char *file() const;
 
+  // Name for use in diagnostics.
+  const char *name() const;
+
+  // Set the contents of an A_Buffer artifact. The artifact is logically
+  // immutable once produced, hence const.
+  void setBuffer(std::unique_ptr<llvm::MemoryBuffer> buf) const;
+
+  // Contents of the artifact: the buffer itself (without copying) for
+  // A_Buffer artifacts, or else the file contents.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> contents() const;
+
   // Return input argument if type is A_Argument, null otherwise.
   llvm::opt::Arg *arg();
 
@@ -67,6 +94,7 @@ class Artifact {
     llvm::opt::Arg *arg;
     const char *file;
   } u;
+  mutable std::unique_ptr<llvm::MemoryBuffer> buffer_;
 };
 
 // A list of artifacts.
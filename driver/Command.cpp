@@ -21,16 +21,22 @@ namespace driver {
 Command::Command(const Action &srcAction,
                  const Tool &creator,
                  const char *executable,
-                 llvm::opt::ArgStringList &args)
+                 llvm::opt::ArgStringList &args,
+                 InProcessHook hook)
     : action_(srcAction),
       creator_(creator),
       executable_(executable),
-      arguments_(args)
+      arguments_(args),
+      hook_(std::move(hook))
 {
 }
 
 int Command::execute(std::string *errMsg)
 {
+  if (hook_)
+    return hook_(llvm::makeArrayRef(arguments_.data(),
+                                    arguments_.size() - 1), errMsg);
+
   std::vector<llvm::StringRef> argv;
   size_t n = arguments_.size() - 1;
   argv.reserve(n);
@@ -47,6 +53,8 @@ int Command::execute(std::string *errMsg)
 
 void Command::print(llvm::raw_ostream &os, bool quoteArgs)
 {
+  if (isInternal())
+    return;
   os << " " << executable_;
   const char *qu = (quoteArgs ? "\"" : "");
   bool first = true;
@@ -13,7 +13,9 @@
 #ifndef GOLLVM_DRIVER_COMMAND_H
 #define GOLLVM_DRIVER_COMMAND_H
 
+#include <functional>
 #include <string>
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Option/ArgList.h"
 
@@ -36,17 +38,42 @@ typedef llvm::SmallVector<Command*, 3> CommandList;
 // compilation step (for example, the exact set of strings needed to
 // exec the assembler). Commands are created by Tools; Commands are
 // stored in and owned by a Compilation.
+//
+// A tool that can also carry out the command within the driver
+// process (for example linking with the lld library) supplies a
+// hook; the command is then run by calling the hook on the same
+// argument vector instead of exec'ing the executable. Actions
+// performed by internal tools are also queued as (internal) commands,
+// with a null executable and a hook that performs the action, so that
+// the commands for a compilation form a dependence graph that can be
+// executed in parallel.
 
 class Command {
  public:
+  typedef std::function<int(llvm::ArrayRef<const char *> argv,
+                            std::string *errMsg)> InProcessHook;
+
   Command(const Action &srcAction,
           const Tool &creator,
           const char *executable,
-          llvm::opt::ArgStringList &args);
+          llvm::opt::ArgStringList &args,
+          InProcessHook hook = nullptr);
 
   // Execute the command. Returns 0 on success, non-zero on error.
   int execute(std::string *errMsg);
 
+  // Commands producing the inputs of this one; it may only be
+  // executed once these have completed.
+  const CommandList &deps() const { return deps_; }
+  void addDep(Command *dep) { deps_.push_back(dep); }
+
+  // True if this command carries out an internal tool's action. Such
+  // commands are not printed for -v/-### (the tool does that itself).
+  bool isInternal() const { return executable_ == nullptr; }
+
+  const Action &action() const { return action_; }
+  const Tool &creator() const { return creator_; }
+
   // Print to string
   void print(llvm::raw_ostream &OS, bool quoteArgs);
 
@@ -58,6 +85,8 @@ class Command {
   const Tool &creator_;
   const char *executable_;
   llvm::opt::ArgStringList arguments_;
+  InProcessHook hook_;
+  CommandList deps_;
 };
 
 } // end namespace driver
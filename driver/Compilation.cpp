@@ -19,8 +19,15 @@
 #include "Artifact.h"
 #include "Command.h"
 #include "Driver.h"
+#include "Jobserver.h"
+#include "Tool.h"
 
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 namespace gollvm {
 namespace driver {
@@ -73,6 +80,22 @@ Artifact *Compilation::newArgArtifact(llvm::opt::Arg *arg)
   return ownedArtifacts_.back().get();
 }
 
+Artifact *Compilation::createMemoryArtifact(Action *act)
+{
+  // Standard input goes by "<stdin>" in diagnostics and debug info,
+  // as with other compilers.
+  std::stringstream s;
+  if (act->castToReadStdinAction() != nullptr)
+    s << "<stdin>";
+  else
+    s << act->getName() << "." << act->resultFileSuffix();
+  paths_.push_back(s.str());
+  const char *name = paths_.back().c_str();
+  ownedArtifacts_.push_back(
+      std::make_unique<Artifact>(Artifact::A_Buffer, name));
+  return ownedArtifacts_.back().get();
+}
+
 Artifact *Compilation::createFakeFileArtifact(Action *act)
 {
   std::stringstream s;
@@ -145,13 +168,43 @@ llvm::Optional<Artifact*> Compilation::createTemporaryFileArtifact(Action *act)
 void Compilation::addCommand(const Action &srcAction,
                              const Tool &creatingTool,
                              const char *executable,
-                             llvm::opt::ArgStringList &args)
+                             llvm::opt::ArgStringList &args,
+                             Command::InProcessHook hook)
 {
   ownedCommands_.push_back(std::make_unique<Command>(srcAction,
                                                      creatingTool,
                                                      executable,
-                                                     args));
-  commands_.push_back(ownedCommands_.back().get());
+                                                     args,
+                                                     std::move(hook)));
+  Command *cmd = ownedCommands_.back().get();
+
+  // Actions are processed inputs first, so the commands producing our
+  // inputs (if any; input files have none) already exist.
+  for (Action *input : srcAction.inputs()) {
+    auto it = actionCommands_.find(input);
+    if (it != actionCommands_.end())
+      cmd->addDep(it->second);
+  }
+  actionCommands_[&srcAction] = cmd;
+  commands_.push_back(cmd);
+}
+
+void Compilation::addInternalCommand(const Action &srcAction,
+                                     InternalTool &tool,
+                                     const ArtifactList &inputs,
+                                     const Artifact &output)
+{
+  llvm::opt::ArgStringList noArgs;
+  noArgs.push_back(nullptr);
+  const Action *act = &srcAction;
+  InternalTool *it = &tool;
+  const Artifact *out = &output;
+  ArtifactList ins(inputs);
+  addCommand(srcAction, tool, nullptr, noArgs,
+             [this, act, it, ins, out](llvm::ArrayRef<const char *>,
+                                       std::string *) {
+               return it->performAction(*this, *act, ins, *out) ? 0 : 1;
+             });
 }
 
 bool Compilation::executeCommands()
@@ -159,14 +212,44 @@ bool Compilation::executeCommands()
   llvm::opt::ArgList &args = driver().args();
 
   bool hashHashHash = args.hasArg(gollvm::options::OPT__HASH_HASH_HASH);
+  bool verbose = hashHashHash || args.hasArg(gollvm::options::OPT_v);
+
+  // Number of commands to run at once. Without -j this is one, unless
+  // we are being run by a parallel make, in which case it is one plus
+  // however many tokens can be taken from the jobserver.
+  unsigned jobs = 1;
+  llvm::opt::Arg *jarg = args.getLastArg(gollvm::options::OPT_j);
+  if (jarg != nullptr) {
+    llvm::StringRef val(jarg->getValue());
+    if (val.getAsInteger(10, jobs) || jobs == 0) {
+      llvm::errs() << driver().progname() << ": error: invalid value '"
+                   << val << "' for -j\n";
+      return false;
+    }
+  }
+  std::unique_ptr<Jobserver> jobserver;
+  if (!verbose && commands_.size() > 1) {
+    jobserver = Jobserver::fromEnvironment();
+    if (jobserver && jarg == nullptr)
+      jobs = commands_.size();
+  }
+
+  // Keep -v/-### output in command order.
+  if (verbose || jobs == 1 || commands_.size() <= 1)
+    return executeCommandsSerially(verbose, hashHashHash);
+  return executeCommandsInParallel(jobs, jobserver.get());
+}
+
+bool Compilation::executeCommandsSerially(bool verbose, bool hashHashHash)
+{
   for (auto cmd : commands_) {
 
     // Support -v and/or -###
-    if (hashHashHash || args.hasArg(gollvm::options::OPT_v))
+    if (verbose)
       cmd->print(llvm::errs(), hashHashHash);
 
-    // Support -###
-    if (hashHashHash)
+    // Support -### (internal tools handle this themselves)
+    if (hashHashHash && !cmd->isInternal())
       continue;
 
     // Execute.
@@ -182,5 +265,110 @@ bool Compilation::executeCommands()
   return true;
 }
 
+// Execute commands as soon as the commands they depend on have
+// completed, up to 'jobs' at a time, each on its own thread (external
+// commands are then just waited for by that thread). With a jobserver
+// the first command runs in the slot make gave this process; every
+// other one takes a token from the jobserver, but only once it is able
+// to run (that is, after it has the lock for a non-reentrant internal
+// tool), so that tokens are not held idle while sibling jobs of make
+// could use them. After a failure no new commands are started, but
+// those already running are allowed to finish.
+
+bool Compilation::executeCommandsInParallel(unsigned jobs,
+                                            Jobserver *jobserver)
+{
+  struct Result {
+    Command *cmd;
+    int rc;
+    std::string errMsg;
+    bool usedToken;
+  };
+
+  llvm::DenseMap<Command *, unsigned> pendingDeps;
+  llvm::DenseMap<Command *, CommandList> dependents;
+  std::map<const Tool *, std::mutex> toolLocks;
+  std::deque<Command *> ready;
+  for (Command *cmd : commands_) {
+    pendingDeps[cmd] = cmd->deps().size();
+    for (Command *dep : cmd->deps())
+      dependents[dep].push_back(cmd);
+    if (cmd->deps().empty())
+      ready.push_back(cmd);
+    const InternalTool *it = cmd->creator().castToInternalTool();
+    if (it != nullptr && !it->isReentrant())
+      toolLocks[it];
+  }
+
+  std::mutex mu;
+  std::condition_variable cv;
+  std::vector<Result> results;
+  std::vector<std::thread> threads;
+  bool failed = false;
+  bool implicitSlotFree = true;
+  unsigned running = 0;
+
+  std::unique_lock<std::mutex> lock(mu);
+  for (;;) {
+    while (!failed && !ready.empty() && running < jobs) {
+      Command *cmd = ready.front();
+      ready.pop_front();
+      bool needToken = jobserver != nullptr && !implicitSlotFree;
+      if (jobserver != nullptr && !needToken)
+        implicitSlotFree = false;
+      auto tl = toolLocks.find(&cmd->creator());
+      std::mutex *toolLock = (tl != toolLocks.end() ? &tl->second : nullptr);
+      ++running;
+      threads.emplace_back([&, cmd, needToken, toolLock]() {
+        Result res = { cmd, 0, std::string(), false };
+        {
+          std::unique_lock<std::mutex> toolGuard;
+          if (toolLock != nullptr)
+            toolGuard = std::unique_lock<std::mutex>(*toolLock);
+          char token = 0;
+          if (needToken)
+            res.usedToken = jobserver->acquire(&token);
+          bool skip;
+          {
+            std::lock_guard<std::mutex> guard(mu);
+            skip = failed;
+          }
+          if (!skip)
+            res.rc = cmd->execute(&res.errMsg);
+          if (res.usedToken)
+            jobserver->release(token);
+        }
+        std::lock_guard<std::mutex> guard(mu);
+        results.push_back(std::move(res));
+        cv.notify_one();
+      });
+    }
+    if (running == 0)
+      break;
+
+    cv.wait(lock, [&]() { return !results.empty(); });
+    for (Result &res : results) {
+      --running;
+      if (jobserver != nullptr && !res.usedToken)
+        implicitSlotFree = true;
+      if (res.rc != 0) {
+        if (!res.errMsg.empty())
+          llvm::errs() << res.errMsg << "\n";
+        failed = true;
+        continue;
+      }
+      for (Command *d : dependents[res.cmd])
+        if (--pendingDeps[d] == 0)
+          ready.push_back(d);
+    }
+    results.clear();
+  }
+  lock.unlock();
+
+  for (std::thread &t : threads)
+    t.join();
+  return !failed;
+}
+
 } // end namespace driver
 } // end namespace gollvm
@@ -13,9 +13,12 @@
 #ifndef GOLLVM_DRIVER_COMPILATION_H
 #define GOLLVM_DRIVER_COMPILATION_H
 
+#include <deque>
 #include <string>
 #include "Action.h"
+#include "Artifact.h"
 #include "Command.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Option/OptTable.h"
 #include "llvm/Option/ArgList.h"
@@ -25,6 +28,8 @@ namespace driver {
 
 class Command;
 class Driver;
+class InternalTool;
+class Jobserver;
 class Tool;
 class ToolChain;
 
@@ -38,7 +43,9 @@ class Compilation {
               ToolChain &toolChain);
   ~Compilation();
 
-  // Execute queued commands to invoke external tools.
+  // Execute queued commands, performing internal tool actions and
+  // invoking external tools. Commands whose inputs are ready run in
+  // parallel, up to the limit set by -j and/or the GNU make jobserver.
   // Return is true for success, false for error;
   bool executeCommands();
 
@@ -55,6 +62,10 @@ class Compilation {
   // on action plus command line flags).
   Artifact* createOutputFileArtifact(Action *act);
 
+  // Create an in-memory artifact to hold the output of the specified
+  // action.
+  Artifact* createMemoryArtifact(Action *act);
+
   // Create a dummy artifact to hold the output of the specified
   // action. For unit testing.
   Artifact* createFakeFileArtifact(Action *act);
@@ -96,9 +107,19 @@ class Compilation {
   void addCommand(const Action &srcAction,
                   const Tool &creatingTool,
                   const char *executable,
-                  llvm::opt::ArgStringList &args);
+                  llvm::opt::ArgStringList &args,
+                  Command::InProcessHook hook = nullptr);
+
+  // Queue up an action to be performed by an internal tool.
+  void addInternalCommand(const Action &srcAction,
+                          InternalTool &tool,
+                          const ArtifactList &inputs,
+                          const Artifact &output);
 
  private:
+  bool executeCommandsSerially(bool verbose, bool hashHashHash);
+  bool executeCommandsInParallel(unsigned jobs, Jobserver *jobserver);
+
   Driver &driver_;
   ToolChain &toolchain_;
   ActionList actions_;
@@ -107,8 +128,10 @@ class Compilation {
   llvm::SmallVector<std::unique_ptr<Action>, 8> ownedActions_;
   llvm::SmallVector<std::unique_ptr<Artifact>, 8> ownedArtifacts_;
   llvm::SmallVector<std::unique_ptr<Command>, 8> ownedCommands_;
+  llvm::DenseMap<const Action *, Command *> actionCommands_;
   llvm::SmallVector<const char *, 8> tempFileNames_;
-  llvm::SmallVector<std::string, 8> paths_;
+  // Artifacts point into these strings, so they must never move.
+  std::deque<std::string> paths_;
 };
 
 } // end namespace driver
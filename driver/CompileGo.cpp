@@ -16,6 +16,7 @@
 #include "go-llvm-diagnostics.h"
 #include "go-llvm.h"
 #include "go-c.h"
+#include "go-import-index.h"
 #include "mpfr.h"
 #include "GollvmOptions.h"
 #include "GollvmConfig.h"
@@ -25,6 +26,7 @@
 #include "ArchCpuSetup.h"
 #include "Artifact.h"
 #include "Driver.h"
+#include "TargetSetup.h"
 #include "ToolChain.h"
 
 namespace gollvm { namespace arch {
@@ -32,6 +34,7 @@ namespace gollvm { namespace arch {
 } }
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/ScopeExit.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Bitcode/BitcodeWriterPass.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
@@ -56,6 +59,7 @@ namespace gollvm { namespace arch {
 #include "llvm/Remarks/YAMLRemarkSerializer.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Errno.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/Host.h"
@@ -67,7 +71,6 @@ namespace gollvm { namespace arch {
 #include "llvm/Support/Program.h"
 #include "llvm/Support/Regex.h"
 #include "llvm/Support/Signals.h"
-#include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
@@ -77,6 +80,9 @@ namespace gollvm { namespace arch {
 
 #include <sstream>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
 using namespace llvm;
 
 namespace gollvm {
@@ -90,6 +96,34 @@ class RemarkCtl {
   std::shared_ptr<llvm::Regex> optimizationRemarkAnalysisPattern_;
 };
 
+// An in-memory input handed to the front end as an anonymous file
+// (see exposeBufferInput). The file is closed, and its memory freed,
+// when this object goes away.
+class MemoryInputFile {
+ public:
+  MemoryInputFile(int fd, const char *name) : fd_(fd), name_(name) { }
+  MemoryInputFile(MemoryInputFile &&other) noexcept
+      : fd_(other.fd_), name_(std::move(other.name_)) { other.fd_ = -1; }
+  MemoryInputFile(const MemoryInputFile &) = delete;
+  MemoryInputFile &operator=(const MemoryInputFile &) = delete;
+  ~MemoryInputFile() {
+    if (fd_ >= 0)
+      ::close(fd_);
+  }
+
+  int fd() const { return fd_; }
+
+  // Path through which the front end opens the file.
+  std::string path() const { return "/proc/self/fd/" + std::to_string(fd_); }
+
+  // Name of the artifact, used in diagnostics and debug info.
+  const std::string &name() const { return name_; }
+
+ private:
+  int fd_;
+  std::string name_;
+};
+
 class CompileGoImpl {
  public:
   CompileGoImpl(CompileGo &cg, ToolChain &tc, const std::string &executablePath);
@@ -118,19 +152,27 @@ class CompileGoImpl {
   std::unique_ptr<Llvm_linemap> linemap_;
   std::unique_ptr<Module> module_;
   std::vector<std::string> inputFileNames_;
+  std::vector<MemoryInputFile> memInputs_;
   std::string asmOutFileName_;
   std::unique_ptr<ToolOutputFile> asmout_;
+  std::string splitDwarfFile_;
+  std::unique_ptr<ToolOutputFile> dwoout_;
   std::unique_ptr<ToolOutputFile> optRecordFile_;
   RemarkCtl remarkCtl_;
   std::unique_ptr<TargetLibraryInfoImpl> tlii_;
   std::string targetCpuAttr_;
   std::string targetFeaturesAttr_;
+  std::string targetTuneCpuAttr_;
+  std::vector<std::pair<std::string, std::string>> multiversionCpus_;
   std::string sampleProfileFile_;
   bool enable_gc_;
 
   void createPasses(legacy::PassManager &MPM,
                     legacy::FunctionPassManager &FPM);
   void setupGoSearchPath();
+  void computeGoSearchPath(const std::vector<std::string> &incargs,
+                           const std::vector<std::string> &libargs,
+                           llvm::SmallVectorImpl<std::string> &paths);
   void setCConv();
 
   // The routines below return TRUE for success, FALSE for failure/error/
@@ -142,6 +184,7 @@ class CompileGoImpl {
   bool resolveInputOutput(const Action &jobAction,
                           const ArtifactList &inputArtifacts,
                           const Artifact &output);
+  bool exposeBufferInput(const Artifact &input);
 
   // Misc
   bool enableVectorization(bool slp);
@@ -163,10 +206,7 @@ CompileGoImpl::CompileGoImpl(CompileGo &cg,
       hasError_(false),
       enable_gc_(false)
 {
-  InitializeAllTargets();
-  InitializeAllTargetMCs();
-  InitializeAllAsmPrinters();
-  InitializeAllAsmParsers();
+  initializeTargetFor(triple_);
 }
 
 bool CompileGoImpl::performAction(Compilation &compilation,
@@ -177,6 +217,9 @@ bool CompileGoImpl::performAction(Compilation &compilation,
   if (cg_.emitMinusVOrHashHashHash(triple_, output, jobAction))
     return true;
 
+  // Release in-memory inputs however we leave.
+  auto releaseInputs = make_scope_exit([this]() { memInputs_.clear(); });
+
   // Resolve input/output files.
   if (!resolveInputOutput(jobAction, inputArtifacts, output))
     return false;
@@ -246,8 +289,14 @@ bool CompileGoImpl::resolveInputOutput(const Action &jobAction,
                                        const Artifact &output)
 {
   // Collect input files
-  for (auto inp : inputArtifacts)
+  for (auto inp : inputArtifacts) {
+    if (inp->type() == Artifact::A_Buffer) {
+      if (!exposeBufferInput(*inp))
+        return false;
+      continue;
+    }
     inputFileNames_.push_back(inp->file());
+  }
   assert(! inputFileNames_.empty());
   asmOutFileName_ = output.file();
 
@@ -267,6 +316,41 @@ bool CompileGoImpl::resolveInputOutput(const Action &jobAction,
   return true;
 }
 
+// The front end opens its input files by name. An in-memory input is
+// handed to it as an anonymous memory-backed file, which it can open
+// through /proc without the contents ever being written to disk. The
+// linemap is told to record the artifact's own name for it, so the
+// /proc path does not show up in diagnostics or debug info.
+
+bool CompileGoImpl::exposeBufferInput(const Artifact &input)
+{
+  auto contents = input.contents();
+  if (!contents) {
+    errs() << progname_ << ": error reading " << input.name() << ": "
+           << contents.getError().message() << "\n";
+    return false;
+  }
+  StringRef data = (*contents)->getBuffer();
+  int fd = ::memfd_create(input.name(), MFD_CLOEXEC);
+  if (fd < 0) {
+    errs() << progname_ << ": error creating in-memory file for "
+           << input.name() << ": " << sys::StrError() << "\n";
+    return false;
+  }
+  memInputs_.emplace_back(fd, input.name());
+  raw_fd_ostream os(fd, /*shouldClose=*/false);
+  os << data;
+  os.flush();
+  if (os.has_error()) {
+    errs() << progname_ << ": error writing in-memory file for "
+           << input.name() << ": " << os.error().message() << "\n";
+    os.clear_error();
+    return false;
+  }
+  inputFileNames_.push_back(memInputs_.back().path());
+  return true;
+}
+
 static std::shared_ptr<llvm::Regex>
 generateOptimizationRemarkRegex(opt::ArgList &args, opt::Arg *rpassArg)
 {
@@ -421,6 +505,25 @@ bool CompileGoImpl::setup(const Action &jobAction)
     return false;
   Options.CompressDebugSections = dct;
 
+  // -gsplit-dwarf. When emitting an object file the .dwo file is
+  // written alongside it; when emitting assembly the .dwo sections
+  // go into the .s file, to be split out by the integrated assembler.
+  splitDwarfFile_ = driver_.splitDwarfFile(jobAction);
+  if (!splitDwarfFile_.empty()) {
+    if (!triple_.isOSBinFormatELF()) {
+      errs() << progname_ << ": error: -gsplit-dwarf "
+             << "is only supported for ELF targets\n";
+      return false;
+    }
+    if (jat == Action::A_Compile && !args_.hasArg(gollvm::options::OPT_S) &&
+        !driver_.useIntegratedAssembler()) {
+      errs() << progname_ << ": warning: -gsplit-dwarf is ignored "
+             << "when using an external assembler\n";
+      splitDwarfFile_.clear();
+    }
+    Options.MCOptions.SplitDwarfFile = splitDwarfFile_;
+  }
+
   // FIXME: this hard-wires on the equivalent of -ffunction-sections
   // and -fdata-sections, since there doesn't seem to be a high-level
   // hook for selecting a separate section for a specific variable or
@@ -430,6 +533,45 @@ bool CompileGoImpl::setup(const Action &jobAction)
   Options.DataSections = true;
   Options.UniqueSectionNames = true;
 
+  // Address-significance tables, so that linker identical code folding
+  // (lld --icf=safe, with -flinker-icf) can merge functions whose
+  // address is never taken. Only the integrated assembler knows the
+  // .addrsig directive.
+  Options.EmitAddrsig =
+      triple_.isOSBinFormatELF() && driver_.useIntegratedAssembler() &&
+      driver_.reconcileOptionPair(gollvm::options::OPT_flinker_icf,
+                                  gollvm::options::OPT_fno_linker_icf, false);
+
+  // -fbasic-block-sections=
+  if (opt::Arg *arg =
+      args_.getLastArg(gollvm::options::OPT_fbasic_block_sections_EQ)) {
+    StringRef val(arg->getValue());
+    if (val == "all") {
+      Options.BBSections = llvm::BasicBlockSection::All;
+    } else if (val == "labels") {
+      Options.BBSections = llvm::BasicBlockSection::Labels;
+    } else if (val == "none") {
+      Options.BBSections = llvm::BasicBlockSection::None;
+    } else {
+      // Anything else names a file listing functions (and optionally
+      // block clusters) to be given their own sections.
+      llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> mbOrErr =
+          llvm::MemoryBuffer::getFile(val);
+      if (!mbOrErr) {
+        errs() << progname_ << ": unable to access file: " << val << "\n";
+        return false;
+      }
+      Options.BBSections = llvm::BasicBlockSection::List;
+      Options.BBSectionsFuncListBuf = std::move(*mbOrErr);
+    }
+    if (!triple_.isOSBinFormatELF() &&
+        Options.BBSections != llvm::BasicBlockSection::None) {
+      errs() << progname_ << ": error: -fbasic-block-sections= "
+             << "is only supported for ELF targets\n";
+      return false;
+    }
+  }
+
   // FIXME: this needs to be dependent on target triple
   Options.EABIVersion = llvm::EABI::Default;
 
@@ -471,6 +613,25 @@ bool CompileGoImpl::setup(const Action &jobAction)
   if (!setupArchCpu(cpuarg, targetCpuAttr_, targetFeaturesAttr_, triple_, progname_))
     return false;
 
+  // Support -mtune
+  opt::Arg *tunearg = args_.getLastArg(gollvm::options::OPT_mtune_EQ);
+  if (!setupTuneCpu(tunearg, targetTuneCpuAttr_, triple_, progname_))
+    return false;
+
+  // Support -fgo-multiversion=
+  if (opt::Arg *mvarg =
+          args_.getLastArg(gollvm::options::OPT_fgo_multiversion_EQ)) {
+    if (!triple_.isOSBinFormatELF()) {
+      errs() << progname_ << ": -fgo-multiversion requires an ELF target\n";
+      return false;
+    }
+    if (!setupMultiversionCpus(mvarg, multiversionCpus_, triple_, progname_))
+      return false;
+    if (sampleProfileFile_.empty())
+      errs() << progname_ << ": warning: -fgo-multiversion has no effect "
+             << "without -fprofile-sample-use=<file>\n";
+  }
+
   // Create target machine
   Optional<llvm::CodeModel::Model> CM = None;
   target_.reset(
@@ -502,6 +663,8 @@ bool CompileGoImpl::initBridge()
 
   // Construct linemap and module
   linemap_.reset(new Llvm_linemap());
+  for (const MemoryInputFile &mi : memInputs_)
+    linemap_->add_file_alias(mi.path(), mi.name());
   module_.reset(new llvm::Module("gomodule", context_));
 
   // Add the target data from the target machine, if it exists
@@ -530,6 +693,7 @@ bool CompileGoImpl::initBridge()
   bridge_->setNoInline(args_.hasArg(gollvm::options::OPT_fno_inline));
   bridge_->setTargetCpuAttr(targetCpuAttr_);
   bridge_->setTargetFeaturesAttr(targetFeaturesAttr_);
+  bridge_->setTargetTuneCpuAttr(targetTuneCpuAttr_);
   if (!sampleProfileFile_.empty())
     bridge_->setEnableAutoFDO();
 
@@ -551,6 +715,22 @@ bool CompileGoImpl::initBridge()
                                   supportSplitStack);
   bridge_->setUseSplitStack(useSplitStack);
 
+  // -fxray-instrument / -fxray-instruction-threshold=
+  if (driver_.xrayInstrument()) {
+    llvm::Optional<unsigned> xthresh =
+        driver_.getLastArgAsInteger(
+            gollvm::options::OPT_fxray_instruction_threshold_EQ, 200u);
+    if (!xthresh)
+      return false;
+    bridge_->setXRayInstrument(*xthresh);
+  }
+
+  // Honor -gline-tables-only and -gsplit-dwarf.
+  if (driver_.debugLineTablesOnly())
+    bridge_->setDebugLineTablesOnly();
+  if (!splitDwarfFile_.empty())
+    bridge_->setSplitDwarfFile(splitDwarfFile_);
+
   // Honor -fdebug-prefix=... option.
   for (const auto &arg : driver_.args().getAllArgValues(gollvm::options::OPT_fdebug_prefix_map_EQ))
     bridge_->addDebugPrefix(llvm::StringRef(arg).split('='));
@@ -669,12 +849,46 @@ bool CompileGoImpl::initBridge()
 
 void CompileGoImpl::setupGoSearchPath()
 {
-  // Include dirs
   std::vector<std::string> incargs =
       args_.getAllArgValues(gollvm::options::OPT_I);
+  std::vector<std::string> libargs =
+      args_.getAllArgValues(gollvm::options::OPT_L);
+
+  // This is not kept in the toolchain cache: it depends on the -I/-L
+  // dirs of each compile (often relative, or under the build tree),
+  // and only costs a handful of stats.
+  llvm::SmallVector<std::string, 16> paths;
+  computeGoSearchPath(incargs, libargs, paths);
+
+  // Consult the package import index of each dir, if present. A dir
+  // whose (up to date) index shows it holds no packages at all can be
+  // left out, since the front end's probing there can only fail;
+  // other indices are handed to go_read_export_data.
+  bool useIndex = driver_.reconcileOptionPair(
+      gollvm::options::OPT_fgo_import_index,
+      gollvm::options::OPT_fno_go_import_index, true);
+  GoImportIndex::clearRegistry();
+  for (auto &path : paths) {
+    if (useIndex) {
+      if (std::unique_ptr<GoImportIndex> index = GoImportIndex::open(path)) {
+        if (index->numEntries() == 0 && index->isCurrent())
+          continue;
+        GoImportIndex::registerIndex(std::move(index));
+      }
+    }
+    go_add_search_path(path.c_str());
+  }
+}
+
+void CompileGoImpl::computeGoSearchPath(
+    const std::vector<std::string> &incargs,
+    const std::vector<std::string> &libargs,
+    llvm::SmallVectorImpl<std::string> &paths)
+{
+  // Include dirs
   for (auto &dir : incargs) {
     if (sys::fs::is_directory(dir))
-      go_add_search_path(dir.c_str());
+      paths.push_back(dir);
   }
 
   // Make up a list of dirs starting with -L args, then -B args,
@@ -682,7 +896,7 @@ void CompileGoImpl::setupGoSearchPath()
   std::vector<std::string> dirs;
 
   // First -L args.
-  for (auto &dir : args_.getAllArgValues(gollvm::options::OPT_L)) {
+  for (auto &dir : libargs) {
     if (!sys::fs::is_directory(dir))
       continue;
     dirs.push_back(dir);
@@ -704,17 +918,17 @@ void CompileGoImpl::setupGoSearchPath()
     b1 << dir << sys::path::get_separator().str() << "go"
        << sys::path::get_separator().str() << GOLLVM_LIBVERSION;
     if (sys::fs::is_directory(b1.str())) {
-      go_add_search_path(b1.str().c_str());
+      paths.push_back(b1.str());
       std::stringstream b2;
       b2 << b1.str() << sys::path::get_separator().str() << triple_.str();
       if (sys::fs::is_directory(b2.str()))
-        go_add_search_path(b2.str().c_str());
+        paths.push_back(b2.str());
     }
   }
 
   // Second pass with raw dir.
   for (auto &dir : dirs)
-    go_add_search_path(dir.c_str());
+    paths.push_back(dir);
 }
 
 // Set cconv according to the triple_ value.
@@ -746,6 +960,7 @@ bool CompileGoImpl::invokeFrontEnd()
   for (auto &fn : inputFileNames_)
     fns[idx++] = fn.c_str();
   go_parse_input_files(fns, nfiles, false, true);
+  memInputs_.clear();
   if (!args_.hasArg(gollvm::options::OPT_nobackend))
     go_write_globals();
   if (args_.hasArg(gollvm::options::OPT_dump_ir))
@@ -834,13 +1049,38 @@ void CompileGoImpl::createPasses(legacy::PassManager &MPM,
     pmb.addExtension(llvm::PassManagerBuilder::EP_EarlyAsPossible,
                            addAddDiscriminatorsPass);
 
+  // Clone hot functions per -fgo-multiversion CPU after the sample
+  // profile is loaded but before the module optimizations, so that each
+  // clone is inlined into and vectorized for its own features.
+  if (!multiversionCpus_.empty())
+    pmb.addExtension(llvm::PassManagerBuilder::EP_ModuleOptimizerEarly,
+                     [this](const llvm::PassManagerBuilder &,
+                            llvm::legacy::PassManagerBase &PM) {
+                       PM.add(createGoMultiversionPass(multiversionCpus_));
+                     });
+
 
   FPM.add(new TargetLibraryInfoWrapperPass(*tlii_));
   if (! args_.hasArg(gollvm::options::OPT_noverify))
     FPM.add(createVerifierPass());
 
   pmb.populateFunctionPassManager(FPM);
+
+  // Rewrite chains of constant string compares (from switch statements
+  // on strings). This needs to run after SROA/EarlyCSE have put the
+  // string in SSA form, but before the module pipeline's CFG
+  // simplification and jump threading reshape the chain.
+  if (olvl_ > 0)
+    FPM.add(createGoStringSwitchPass());
+
   pmb.populateModulePassManager(MPM);
+
+  // Remove nil checks made redundant by earlier checks or dereferences
+  // of the same pointer. This runs after inlining so that checks from
+  // inlined callees are seen together with the caller's, and before
+  // GoNilChecks so that fewer checks (and blocks) reach codegen.
+  if (olvl_ > 0)
+    MPM.add(createGoNilCheckElimPass());
 }
 
 bool CompileGoImpl::invokeBackEnd(const Action &jobAction)
@@ -909,17 +1149,39 @@ bool CompileGoImpl::invokeBackEnd(const Action &jobAction)
     codeGenPasses.add(passConfig);
     MachineModuleInfoWrapperPass *MMIWP = new MachineModuleInfoWrapperPass(lltm);
     codeGenPasses.add(MMIWP);
+    // Size split-stack checks for the XRay trampoline, ahead of
+    // prologue insertion.
+    if (driver_.xrayInstrument())
+      passConfig->insertPass(&FixupStatepointCallerSavedID,
+                             createGoXRayStackReservePass());
     passConfig->addISelPasses();
     passConfig->addMachinePasses();
     passConfig->setInitialized();
 
     codeGenPasses.add(createGoNilChecksPass());
     codeGenPasses.add(createGoWrappersPass());
+    if (driver_.xrayInstrument())
+      codeGenPasses.add(createGoXRaySledsPass());
 
     if (enable_gc_)
       codeGenPasses.add(createGoAnnotationPass());
 
-    lltm->addAsmPrinter(codeGenPasses, *OS, nullptr, ft, MMIWP->getMMI().getContext());
+    // With -gsplit-dwarf and an object file as output, the .dwo
+    // sections are written to their own file.
+    raw_pwrite_stream *DwoOS = nullptr;
+    if (!splitDwarfFile_.empty() && ft == CGFT_ObjectFile) {
+      std::error_code EC;
+      dwoout_ = std::make_unique<ToolOutputFile>(splitDwarfFile_, EC,
+                                                 sys::fs::OF_None);
+      if (EC) {
+        errs() << progname_ << ": error opening " << splitDwarfFile_ << ": "
+               << EC.message() << '\n';
+        return false;
+      }
+      DwoOS = &dwoout_->os();
+    }
+
+    lltm->addAsmPrinter(codeGenPasses, *OS, DwoOS, ft, MMIWP->getMMI().getContext());
 
     codeGenPasses.add(createFreeMachineFunctionPass());
   }
@@ -942,6 +1204,9 @@ run:
   if (hasError_)
     return false;
 
+  if (dwoout_)
+    dwoout_->keep();
+
   return true;
 }
 
@@ -39,6 +39,8 @@ class CompileGo : public InternalTool {
                      const ArtifactList &inputArtifacts,
                      const Artifact &output) override;
 
+  bool readsBufferInputs() const override { return true; }
+
  private:
   std::unique_ptr<CompileGoImpl> impl_;
 };
@@ -10,9 +10,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/Program.h"
 
 #include <sstream>
@@ -22,6 +24,7 @@
 #include "Driver.h"
 #include "LinuxToolChain.h"
 #include "ToolChain.h"
+#include "ToolchainCache.h"
 #include "GollvmConfig.h"
 
 using namespace llvm;
@@ -60,6 +63,8 @@ Driver::Driver(opt::InputArgList &args,
 
 Driver::~Driver()
 {
+  if (toolchainCache_)
+    toolchainCache_->save();
 }
 
 std::string Driver::installedLibDir()
@@ -96,26 +101,50 @@ void Driver::emitVersion()
 std::string Driver::getFilePath(llvm::StringRef name,
                                 ToolChain &toolchain)
 {
+  std::string cacheName = ("file:" + name).str();
+  std::string result;
+  if (toolchainCache_ && toolchainCache_->lookup(cacheName, result))
+    return result;
+  std::vector<std::string> deps;
+  result = findFilePath(name, toolchain, deps);
+  if (toolchainCache_)
+    toolchainCache_->insert(cacheName, result, deps);
+  return result;
+}
+
+// Worker for getFilePath. The directories examined are added to
+// 'deps'.
+
+std::string Driver::findFilePath(llvm::StringRef name,
+                                 ToolChain &toolchain,
+                                 std::vector<std::string> &deps)
+{
+  auto exists = [&deps](const llvm::Twine &path) {
+    std::string p = path.str();
+    deps.push_back(ToolchainCache::containingDir(p));
+    return llvm::sys::fs::exists(p);
+  };
+
   // Include -Bprefixed name in search.
   SmallVector<std::string, 2> candidates;
   for (auto p : prefixes_)
     candidates.push_back((p + name).str());
   for (auto &cand : candidates) {
-    if (llvm::sys::fs::exists(llvm::Twine(cand)))
+    if (exists(llvm::Twine(cand)))
       return cand;
   }
 
   // Examine install dir
   llvm::SmallString<256> installed(installedLibDir());
   llvm::sys::path::append(installed, name);
-  if (llvm::sys::fs::exists(llvm::Twine(installed)))
+  if (exists(llvm::Twine(installed)))
     return std::string(installed);
 
   // Examine toolchain file paths.
   for (const auto &dir : toolchain.filePaths()) {
     llvm::SmallString<256> candidate(dir);
     llvm::sys::path::append(candidate, name);
-    if (llvm::sys::fs::exists(llvm::Twine(candidate)))
+    if (exists(llvm::Twine(candidate)))
       return std::string(candidate);
   }
 
@@ -124,6 +153,28 @@ std::string Driver::getFilePath(llvm::StringRef name,
 
 std::string Driver::getProgramPath(llvm::StringRef name,
                                    ToolChain &toolchain)
+{
+  // The result of the $PATH search depends on $PATH, so make it part
+  // of the entry name.
+  llvm::Optional<std::string> path = llvm::sys::Process::GetEnv("PATH");
+  std::string cacheName =
+      ("program:" + name + ":" + (path ? *path : "")).str();
+  std::string result;
+  if (toolchainCache_ && toolchainCache_->lookup(cacheName, result))
+    return result;
+  std::vector<std::string> deps;
+  result = findProgramPath(name, toolchain, deps);
+  if (toolchainCache_)
+    toolchainCache_->insert(cacheName, result, deps);
+  return result;
+}
+
+// Worker for getProgramPath. The directories examined are added to
+// 'deps'.
+
+std::string Driver::findProgramPath(llvm::StringRef name,
+                                    ToolChain &toolchain,
+                                    std::vector<std::string> &deps)
 {
   // Include -Bprefixed and target-prefixed name in search.
   SmallVector<std::string, 3> candidates;
@@ -137,12 +188,20 @@ std::string Driver::getProgramPath(llvm::StringRef name,
     for (auto &cand : candidates) {
       llvm::SmallString<256> candidate(dir);
       llvm::sys::path::append(candidate, cand);
+      deps.push_back(ToolchainCache::containingDir(candidate));
       if (llvm::sys::fs::can_execute(llvm::Twine(candidate)))
         return std::string(candidate);
     }
   }
 
-  // Search path.
+  // Search path. A program showing up in any $PATH dir can change
+  // the outcome here, so all of them count as dependences.
+  if (llvm::Optional<std::string> path = llvm::sys::Process::GetEnv("PATH")) {
+    SmallVector<StringRef, 16> dirs;
+    StringRef(*path).split(dirs, llvm::sys::EnvPathSeparator);
+    for (StringRef dir : dirs)
+      deps.push_back(dir.str());
+  }
   for (auto &cand : candidates) {
     llvm::ErrorOr<std::string> pcand =
       llvm::sys::findProgramByName(cand);
@@ -262,6 +321,55 @@ bool Driver::determineDebugCompressionType(llvm::DebugCompressionType *dct)
   return true;
 }
 
+// Returns TRUE if only line tables are to be emitted for debugging
+// (-gline-tables-only, unless followed by -g).
+bool Driver::debugLineTablesOnly()
+{
+  opt::Arg *arg = args_.getLastArg(gollvm::options::OPT_g_Flag,
+                                   gollvm::options::OPT_gline_tables_only);
+  return (arg != nullptr &&
+          arg->getOption().matches(gollvm::options::OPT_gline_tables_only));
+}
+
+// Whether -fxray-instrument is in effect. Both the compile step
+// (which emits the sleds) and the link step (which pulls in the XRay
+// runtime) need to know.
+bool Driver::xrayInstrument()
+{
+  return reconcileOptionPair(gollvm::options::OPT_fxray_instrument,
+                             gollvm::options::OPT_fno_xray_instrument,
+                             false);
+}
+
+// For -gsplit-dwarf, returns the name of the .dwo file that goes with
+// the object file produced by 'jobAction' (or ultimately produced
+// from its output, if it is a compile-to-assembly step), otherwise an
+// empty string. As with clang, this is the -o file with a .dwo suffix
+// when compiling with -c, and the source file's stem with a .dwo
+// suffix (in the current directory) otherwise. Both the compile and
+// assemble steps arrive at the same name, since the compiler records
+// it in the skeleton compile unit.
+std::string Driver::splitDwarfFile(const Action &jobAction)
+{
+  if (!args_.hasArg(gollvm::options::OPT_gsplit_dwarf))
+    return "";
+
+  opt::Arg *outarg = args_.getLastArg(gollvm::options::OPT_o);
+  if (outarg != nullptr && args_.hasArg(gollvm::options::OPT_c)) {
+    llvm::SmallString<256> dwo(outarg->getValue());
+    llvm::sys::path::replace_extension(dwo, "dwo");
+    return std::string(dwo.str());
+  }
+
+  const Action *act = &jobAction;
+  while (!act->inputs().empty())
+    act = act->inputs()[0];
+  std::string stem("stdin");
+  if (const InputAction *ia = act->castToInputAction())
+    stem = llvm::sys::path::stem(ia->input()->name()).str();
+  return stem + ".dwo";
+}
+
 // FIXME: some  platforms have PIE enabled by default; we don't
 // yet support auto-detection of such platforms.
 
@@ -399,6 +507,41 @@ Driver::getFPOpFusionMode()
   return res;
 }
 
+void Driver::setupToolchainCache()
+{
+  // Anything that feeds into toolchain discovery (other than the
+  // contents of directories, which are tracked by the cache itself)
+  // goes into the key. This includes the driver binary, since a
+  // reinstall may change the install dir contents or the lookup
+  // logic.
+  std::stringstream key;
+  key << "triple=" << triple_.str()
+      << ";sysroot=" << sysroot_
+      << ";gcc-toolchain=" << gccToolchainDir_
+      << ";driver=" << executablePath_;
+  sys::fs::file_status st;
+  if (!sys::fs::status(executablePath_, st))
+    key << "@" << st.getLastModificationTime().time_since_epoch().count()
+        << "," << st.getSize();
+  bool relative = false;
+  for (auto &p : prefixes_) {
+    key << ";B=" << p;
+    relative |= sys::path::is_relative(p);
+  }
+  relative |= (!sysroot_.empty() && sys::path::is_relative(sysroot_));
+  relative |= (!gccToolchainDir_.empty() &&
+               sys::path::is_relative(gccToolchainDir_));
+  SmallString<256> cwd;
+  if (relative && !sys::fs::current_path(cwd))
+    key << ";cwd=" << cwd.str().str();
+
+  std::string path = ToolchainCache::defaultPath(key.str());
+  if (path.empty())
+    return;
+  toolchainCache_.reset(new ToolchainCache(path, key.str()));
+  toolchainCache_->load();
+}
+
 std::unique_ptr<Compilation> Driver::buildCompilation(ToolChain &tc)
 {
   return std::unique_ptr<Compilation>(new Compilation(*this, tc));
@@ -429,6 +572,15 @@ ToolChain *Driver::setup()
     exit(0);
   }
 
+  // Set up the on-disk toolchain cache if asked to. It is off by
+  // default, since it means every compile writes to the user's cache
+  // directory.
+  if (!unitTesting() &&
+      reconcileOptionPair(gollvm::options::OPT_ftoolchain_cache,
+                          gollvm::options::OPT_fno_toolchain_cache,
+                          false))
+    setupToolchainCache();
+
   // Look up toolchain.
   auto &tc = toolchains_[triple_.str()];
   if (!tc) {
@@ -443,10 +595,23 @@ ToolChain *Driver::setup()
     }
   }
 
+  // Honor -print-toolchain-cache
+  if (args_.hasArg(gollvm::options::OPT_print_toolchain_cache)) {
+    if (toolchainCache_) {
+      toolchainCache_->save();
+      llvm::outs() << toolchainCache_->toString();
+    } else {
+      llvm::outs() << "toolchain cache disabled\n";
+    }
+    exit(0);
+  }
+
   // Honor -print-file-name=...
   opt::Arg *pfnarg = args_.getLastArg(gollvm::options::OPT_print_file_name_EQ);
   if (pfnarg) {
     llvm::outs() << getFilePath(pfnarg->getValue(), *tc) << "\n";
+    if (toolchainCache_)
+      toolchainCache_->save();
     exit(0);
   }
 
@@ -454,6 +619,8 @@ ToolChain *Driver::setup()
   opt::Arg *ppnarg = args_.getLastArg(gollvm::options::OPT_print_prog_name_EQ);
   if (ppnarg) {
     llvm::outs() << getProgramPath(ppnarg->getValue(), *tc) << "\n";
+    if (toolchainCache_)
+      toolchainCache_->save();
     exit(0);
   }
 
@@ -655,7 +822,7 @@ std::string Driver::dumpActions(Compilation &compilation)
   return s.str();
 }
 
-ArtifactList Driver::collectInputArtifacts(Action *act, InternalTool *it)
+ArtifactList Driver::collectInputArtifacts(Action *act)
 {
   ArtifactList result;
   for (auto &input : act->inputs()) {
@@ -664,10 +831,6 @@ ArtifactList Driver::collectInputArtifacts(Action *act, InternalTool *it)
       result.push_back(inact->input());
       continue;
     }
-    // It is an error if an internal-tool action is receiving a result
-    // from an external tool (in the current model all internal-tool actions
-    // have to take place before any external-tool actions).
-    assert(it == nullptr || input->castToReadStdinAction() != nullptr);
     auto it = artmap_.find(input);
     assert(it != artmap_.end());
     result.push_back(it->second);
@@ -675,12 +838,45 @@ ArtifactList Driver::collectInputArtifacts(Action *act, InternalTool *it)
   return result;
 }
 
+// Returns TRUE if the result of 'act' (performed by 'tool') can be
+// kept in memory: the tool is internal and can produce it that way,
+// and every action consuming it uses an internal tool that can read
+// it that way. With -save-temps all intermediate results go to files.
+
+bool Driver::keepResultInMemory(Action *act, Tool *tool,
+                                Compilation &compilation)
+{
+  if (args_.hasArg(gollvm::options::OPT_save_temps))
+    return false;
+  InternalTool *it = tool->castToInternalTool();
+  if (it == nullptr || !it->writesBufferOutput())
+    return false;
+  bool consumed = false;
+  for (Action *user : compilation.actions()) {
+    if (!llvm::is_contained(user->inputs(), act))
+      continue;
+    Tool *ut = compilation.toolchain().getTool(user);
+    InternalTool *uit = ut->castToInternalTool();
+    if (uit == nullptr || !uit->readsBufferInputs())
+      return false;
+    consumed = true;
+  }
+  return consumed;
+}
+
 bool Driver::processAction(Action *act, Compilation &compilation, bool lastAct)
 {
+  // Select tool to process the action.
+  Tool *tool = compilation.toolchain().getTool(act);
+  assert(tool != nullptr);
+  InternalTool *it = tool->castToInternalTool();
+
   // Select the result file for this action.
   Artifact *result = nullptr;
   if (!lastAct) {
-    if (unitTesting()) {
+    if (keepResultInMemory(act, tool, compilation)) {
+      result = compilation.createMemoryArtifact(act);
+    } else if (unitTesting()) {
       result = compilation.createFakeFileArtifact(act);
     } else {
       auto tfa = compilation.createTemporaryFileArtifact(act);
@@ -693,20 +889,13 @@ bool Driver::processAction(Action *act, Compilation &compilation, bool lastAct)
   }
   artmap_[act] = result;
 
-  // Select tool to process the action.
-  Tool *tool = compilation.toolchain().getTool(act);
-  assert(tool != nullptr);
-  InternalTool *it = tool->castToInternalTool();
-
   // Collect input artifacts for this
-  ArtifactList actionInputs = collectInputArtifacts(act, it);
+  ArtifactList actionInputs = collectInputArtifacts(act);
 
-  // If internal tool, perform now.
+  // If internal tool, queue up the action to be performed along with
+  // any external commands (its inputs may come from them).
   if (it != nullptr) {
-    if (!unitTesting()) {
-      if (! it->performAction(compilation, *act, actionInputs, *result))
-        return false;
-    }
+    compilation.addInternalCommand(*act, *it, actionInputs, *result);
     return true;
   }
 
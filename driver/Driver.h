@@ -28,6 +28,7 @@
 #include "Artifact.h"
 #include "GollvmOptions.h"
 
+#include <memory>
 #include <unordered_map>
 
 namespace gollvm {
@@ -35,7 +36,9 @@ namespace driver {
 
 class Compilation;
 class InternalTool;
+class Tool;
 class ToolChain;
+class ToolchainCache;
 
 // Driver class. Drives the process of translating a given command
 // line into a series of compilation actions, then into commands to
@@ -100,6 +103,10 @@ class Driver {
   // Installed lib dir (binary dir above plus ../lib64)
   std::string installedLibDir();
 
+  // On-disk cache for toolchain discovery results, or NULL if
+  // caching is disabled.
+  ToolchainCache *toolchainCache() { return toolchainCache_.get(); }
+
   // Prefix directories (supplied via -B args)
   const std::vector<std::string> &prefixes() const { return prefixes_; }
 
@@ -111,6 +118,9 @@ class Driver {
   bool useIntegratedAssembler();
   bool supportedAsmOptions();
   bool determineDebugCompressionType(llvm::DebugCompressionType *dct);
+  bool debugLineTablesOnly();
+  bool xrayInstrument();
+  std::string splitDwarfFile(const Action &jobAction);
   bool usingSplitStack() const { return usingSplitStack_; }
   template<typename IT>
   llvm::Optional<IT> getLastArgAsInteger(gollvm::options::ID id,
@@ -145,11 +155,18 @@ class Driver {
   // Maps non-input actions to output artifacts.
   std::unordered_map<Action *, Artifact*> artmap_;
   std::vector<std::string> prefixes_;
+  std::unique_ptr<ToolchainCache> toolchainCache_;
   bool usingSplitStack_;
   bool unitTesting_;
 
   bool processAction(Action *act, Compilation &compilation, bool lastAct);
-  ArtifactList collectInputArtifacts(Action *act, InternalTool *it);
+  void setupToolchainCache();
+  std::string findFilePath(llvm::StringRef name, ToolChain &toolchain,
+                           std::vector<std::string> &deps);
+  std::string findProgramPath(llvm::StringRef name, ToolChain &toolchain,
+                              std::vector<std::string> &deps);
+  ArtifactList collectInputArtifacts(Action *act);
+  bool keepResultInMemory(Action *act, Tool *tool, Compilation &compilation);
   llvm::DebugCompressionType *gzArgToDCT(llvm::StringRef ga,
                                          llvm::DebugCompressionType *dct,
                                          const char *which);
@@ -15,6 +15,7 @@
 #include "GccUtils.h"
 
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
 
 namespace gnutools {
 
@@ -48,6 +49,36 @@ bool InspectRealFS::exists(const std::string &path)
 
 //........................................................................
 
+stringvec InspectTrackingFS::scanDir(const std::string &dir)
+{
+  consulted_.insert(dir);
+  return base_.scanDir(dir);
+}
+
+// Whether a path exists, or is a directory, can only change along
+// with its parent directory, so that is what gets recorded; many
+// probes then share a few directories.
+
+static std::string parentDir(const std::string &path)
+{
+  llvm::StringRef dir = llvm::sys::path::parent_path(path);
+  return dir.empty() ? "." : dir.str();
+}
+
+bool InspectTrackingFS::is_directory(const std::string &path)
+{
+  consulted_.insert(parentDir(path));
+  return base_.is_directory(path);
+}
+
+bool InspectTrackingFS::exists(const std::string &path)
+{
+  consulted_.insert(parentDir(path));
+  return base_.exists(path);
+}
+
+//........................................................................
+
 GCCVersion::GCCVersion()
     : maj_(-1), min_(-1)
 {
@@ -295,6 +326,21 @@ void GCCInstallationDetector::init()
   }
 }
 
+void GCCInstallationDetector::restore(llvm::StringRef versionText,
+                                      llvm::StringRef foundTriple,
+                                      llvm::StringRef installPath,
+                                      llvm::StringRef libPath,
+                                      llvm::StringRef parentLibPath)
+{
+  *version_ = GCCVersion::parse(versionText);
+  if (!version_->valid())
+    return;
+  foundTriple_.setTriple(foundTriple);
+  installPath_ = installPath.str();
+  libPath_ = libPath.str();
+  parentLibPath_ = parentLibPath.str();
+}
+
 std::string GCCInstallationDetector::toString()
 {
   std::stringstream ss;
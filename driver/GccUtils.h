@@ -13,6 +13,8 @@
 #ifndef GOLLVM_DRIVER_GCCUTILS_H
 #define GOLLVM_DRIVER_GCCUTILS_H
 
+#include <set>
+
 #include "ToolChain.h"
 #include "llvm/Option/ArgList.h"
 
@@ -44,8 +46,9 @@ class InspectFS;
 //
 // 2) Clang implements a filesystem cache to speed things up in
 //    the case where there are repeated "stat" calls made on files in
-//    a given directory (also not supported here, although in theory
-//    it could be added).
+//    a given directory. Here the results of init() as a whole are
+//    cached across driver runs instead (see ToolchainCache and
+//    restore() below).
 //
 // 3) There is (apparently) a great deal of variation regarding
 //    how/where GCC is installed across various Linux distributions--
@@ -62,6 +65,14 @@ class GCCInstallationDetector {
 
   void init();
 
+  // Reinstate the results of an earlier init() (as recorded in the
+  // toolchain cache) without inspecting the file system.
+  void restore(llvm::StringRef versionText,
+               llvm::StringRef foundTriple,
+               llvm::StringRef installPath,
+               llvm::StringRef libPath,
+               llvm::StringRef parentLibPath);
+
   // Return the version of the "best" or "most suitable" installation
   // of GCC on the host (or in the sysroot, depending). If no GCC
   // installation is found, version.valid() will return false.
@@ -145,8 +156,7 @@ class InspectFS {
   virtual bool is_directory(const std::string &path) = 0;
 };
 
-// A concrete file system inspector. No caching at the moment, could
-// be added later if need be.
+// A concrete file system inspector.
 
 class InspectRealFS : public InspectFS {
  public:
@@ -157,6 +167,26 @@ class InspectRealFS : public InspectFS {
   bool exists(const std::string &path) override;
 };
 
+// A file system inspector that forwards to some other inspector,
+// recording the directories it examined (those scanned, and those
+// holding the files and directories tested) along the way, for
+// validating cached detection results later on.
+
+class InspectTrackingFS : public InspectFS {
+ public:
+  explicit InspectTrackingFS(InspectFS &base) : base_(base) { }
+  ~InspectTrackingFS() { }
+  stringvec scanDir(const std::string &dir) override;
+  bool is_directory(const std::string &path) override;
+  bool exists(const std::string &path) override;
+
+  const std::set<std::string> &consulted() const { return consulted_; }
+
+ private:
+  InspectFS &base_;
+  std::set<std::string> consulted_;
+};
+
 } // end namespace gccdetect
 
 } // end namespace gnutools
@@ -16,9 +16,18 @@
 #include "Driver.h"
 #include "ToolChain.h"
 #include "GollvmConfig.h"
+#include "GollvmPasses.h"
 
+#include "llvm/Config/llvm-config.h"
 #include "llvm/Option/ArgList.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifdef GOLLVM_USE_LLD_LIBRARY
+#include "lld/Common/CommonLinkerContext.h"
+#include "lld/Common/Driver.h"
+#endif
 
 #include <set>
 
@@ -252,6 +261,59 @@ void Linker::addSharedAndOrStaticFlags(llvm::opt::ArgStringList &cmdArgs)
   }
 }
 
+// Pulls in the libgobegin object that registers the executable's
+// PC-to-stack-map index with the runtime (nothing else refers to it),
+// if the index is enabled with -mllvm -gogc-stackmap-index.
+
+void Linker::addStackMapIndexArgs(llvm::opt::ArgStringList &cmdArgs)
+{
+  if (!llvm::goStackMapIndexEnabled())
+    return;
+  cmdArgs.push_back("-u");
+  cmdArgs.push_back("__go_stackmap_index_module");
+}
+
+// Adds the XRay runtime for -fxray-instrument: as with clang, the
+// runtime as a whole archive, followed by the system libraries it
+// needs. It comes from compiler-rt, so besides the usual places look
+// in the clang resource directory of the LLVM installation the driver
+// is part of. Returns false if the library can't be found.
+//
+// The basic and FDR logging modes are left out: their handlers run on
+// the goroutine stack without split-stack checks, and may need more
+// than the compiler reserves for the trampoline. Go programs install
+// a handler through libgo's __go_xray_set_handler instead.
+
+bool Linker::addXRayRuntimeArgs(llvm::opt::ArgStringList &cmdArgs)
+{
+  llvm::opt::ArgList &args = toolchain().driver().args();
+  llvm::StringRef arch = llvm::Triple::getArchTypeName(
+      toolchain().driver().triple().getArch());
+  std::string name = (llvm::Twine("libclang_rt.xray-") + arch + ".a").str();
+  std::string path = toolchain().getFilePath(name.c_str());
+  if (!llvm::sys::fs::exists(path)) {
+    llvm::SmallString<256> rpath(toolchain().driver().installDir());
+    llvm::sys::path::append(rpath, "../lib/clang", LLVM_VERSION_STRING,
+                            "lib/linux", name);
+    if (!llvm::sys::fs::exists(rpath)) {
+      llvm::errs() << "error: unable to locate XRay runtime library '"
+                   << name << "'\n";
+      return false;
+    }
+    path = std::string(rpath);
+  }
+  cmdArgs.push_back("--whole-archive");
+  cmdArgs.push_back(args.MakeArgString(path));
+  cmdArgs.push_back("--no-whole-archive");
+
+  cmdArgs.push_back("--no-as-needed");
+  cmdArgs.push_back("-lpthread");
+  cmdArgs.push_back("-lrt");
+  cmdArgs.push_back("-lm");
+  cmdArgs.push_back("-ldl");
+  return true;
+}
+
 // Adds each thing in the toolchain filepath as an -L option.
 
 void Linker::addFilePathArgs(llvm::opt::ArgStringList &cmdArgs)
@@ -266,6 +328,7 @@ void Linker::addSysLibsStatic(llvm::opt::ArgList &args,
                               llvm::opt::ArgStringList &cmdArgs)
 {
   // Go and pthread related libs.
+  addStackMapIndexArgs(cmdArgs);
   cmdArgs.push_back("-lgobegin");
   cmdArgs.push_back("-lgo");
   addFilePathArgs(cmdArgs);
@@ -288,6 +351,7 @@ void Linker::addSysLibsShared(llvm::opt::ArgList &args,
 {
   bool isStaticLibgo = args.hasArg(gollvm::options::OPT_static_libgo);
   bool havePthreadFlag = args.hasArg(gollvm::options::OPT_pthreads);
+  addStackMapIndexArgs(cmdArgs);
   cmdArgs.push_back("-lgobegin");
   if (isStaticLibgo)
     cmdArgs.push_back("-Bstatic");
@@ -326,6 +390,22 @@ void Linker::addLibGcc(llvm::opt::ArgList &args,
     cmdArgs.push_back("-lgcc");
 }
 
+#ifdef GOLLVM_USE_LLD_LIBRARY
+// Carry out a link with the lld ELF driver library, in-process.
+// Diagnostics go to the driver's stdout/stderr just as they would
+// from ld.lld; lld picks its thread count (all cores by default, or
+// per --threads=) itself.
+static int linkWithLld(llvm::ArrayRef<const char *> argv,
+                       std::string *errMsg)
+{
+  bool ok = lld::elf::link(argv, llvm::outs(), llvm::errs(),
+                           /*exitEarly=*/false, /*disableOutput=*/false);
+  // Release lld's global state, as ld.lld itself does on exit.
+  lld::CommonLinkerContext::destroy();
+  return ok ? 0 : 1;
+}
+#endif
+
 bool Linker::constructCommand(Compilation &compilation,
                               const Action &jobAction,
                               const ArtifactList &inputArtifacts,
@@ -356,6 +436,23 @@ bool Linker::constructCommand(Compilation &compilation,
       linker = args.MakeArgString(llvm::StringRef("ld"));
     }
   }
+  llvm::StringRef ldvariant(variant);
+  bool namedVariant = (ldarg == nullptr ||
+                       !llvm::sys::path::is_absolute(ldarg->getValue()));
+  bool isLld = namedVariant && ldvariant == "lld";
+
+  // With lld, link within the driver itself if it was built with the
+  // lld library. This saves a fork/exec and process startup per link,
+  // which adds up for builds that produce many small binaries (test
+  // executables, for example). The argument vector is the same either
+  // way; an installed ld.lld is not needed.
+  bool inProcess = false;
+#ifdef GOLLVM_USE_LLD_LIBRARY
+  inProcess = isLld && toolchain().driver().reconcileOptionPair(
+      gollvm::options::OPT_fintegrated_ld,
+      gollvm::options::OPT_fno_integrated_ld, true);
+#endif
+
   if (executable == nullptr)
     executable = args.MakeArgString(toolchain().getProgramPath(linker));
   if (! executable) {
@@ -363,7 +460,7 @@ bool Linker::constructCommand(Compilation &compilation,
                  << linker << "\n";
     return false;
   }
-  assert(llvm::sys::path::is_absolute(executable));
+  assert(inProcess || llvm::sys::path::is_absolute(executable));
   cmdArgs.push_back(executable);
 
   // Output file.
@@ -380,6 +477,75 @@ bool Linker::constructCommand(Compilation &compilation,
   // Dynamic linker selection is also done here.
   addSharedAndOrStaticFlags(cmdArgs);
 
+  // Type descriptors, itabs and function descriptors make PIE and
+  // shared Go binaries very heavy on R_*_RELATIVE relocations; the
+  // packed RELR encoding shrinks these drastically and makes them
+  // much cheaper for the dynamic linker to process. Needs a linker
+  // and libc that support it, hence opt-in. Gold has no RELR support
+  // at all, so don't leave it to fail on the option.
+  if (!args.hasArg(gollvm::options::OPT_static) &&
+      toolchain().driver().reconcileOptionPair(
+          gollvm::options::OPT_fgo_pack_relative_relocs,
+          gollvm::options::OPT_fno_go_pack_relative_relocs, false)) {
+    if (namedVariant && ldvariant == "gold") {
+      llvm::errs() << "error: -fgo-pack-relative-relocs is not supported "
+                   << "by gold; use -fuse-ld=lld or -fuse-ld=bfd\n";
+      return false;
+    }
+    cmdArgs.push_back("-z");
+    cmdArgs.push_back("pack-relative-relocs");
+  }
+
+  // Package initializers are emitted into .text.startup.* sections.
+  // The default GNU ld script already groups these; gold and lld need
+  // to be told not to fold them in with the rest of .text.
+  if (namedVariant && (ldvariant == "gold" || isLld)) {
+    cmdArgs.push_back("-z");
+    cmdArgs.push_back("keep-text-section-prefix");
+  }
+
+  // Every Go function and variable is emitted into its own section, so
+  // with -flinker-gc-sections unreferenced ones are dropped. GNU ld,
+  // gold and lld all support this, whether lld runs in-process or not.
+  // These come before any -Wl, arguments, which can override them.
+  if (toolchain().driver().reconcileOptionPair(
+          gollvm::options::OPT_flinker_gc_sections,
+          gollvm::options::OPT_fno_linker_gc_sections, false))
+    cmdArgs.push_back("--gc-sections");
+
+  // Identical code folding is opt-in: a folded function shows up under
+  // the name of the one it was merged with in tracebacks, and in
+  // runtime.Caller and FuncForPC results. Safe ICF only folds functions
+  // whose address is not taken, per the address-significance tables
+  // the compiler emits.
+  if (isLld && toolchain().driver().reconcileOptionPair(
+          gollvm::options::OPT_flinker_icf,
+          gollvm::options::OPT_fno_linker_icf, false))
+    cmdArgs.push_back("--icf=safe");
+
+  // With split DWARF most of the debug info stays in the .dwo files;
+  // have gold/lld build a .gdb_index (from the GNU pubnames sections
+  // emitted in that mode) so that the debugger need not read all of
+  // them up front.
+  if (namedVariant && (ldvariant == "gold" || isLld) &&
+      args.hasArg(gollvm::options::OPT_gsplit_dwarf))
+    cmdArgs.push_back("--gdb-index");
+
+  // Symbol ordering file (for example one produced from a sample
+  // profile by gollvm-prof-order). Functions are always placed in
+  // their own sections, so this is all that is needed. Only lld has
+  // --symbol-ordering-file; gold and GNU ld would reject it.
+  if (llvm::opt::Arg *ordarg =
+      args.getLastArg(gollvm::options::OPT_ffunction_ordering_file_EQ)) {
+    if (!isLld) {
+      llvm::errs() << "error: " << ordarg->getAsString(args)
+                   << " requires -fuse-ld=lld\n";
+      return false;
+    }
+    cmdArgs.push_back(args.MakeArgString(
+        llvm::StringRef("--symbol-ordering-file=") + ordarg->getValue()));
+  }
+
   if (useStdLib)
     addBeginFiles(cmdArgs);
 
@@ -405,6 +571,12 @@ bool Linker::constructCommand(Compilation &compilation,
 
   if (useStdLib) {
 
+    // XRay runtime. As with clang, this goes into executables only.
+    if (toolchain().driver().xrayInstrument() &&
+        !args.hasArg(gollvm::options::OPT_shared) &&
+        !addXRayRuntimeArgs(cmdArgs))
+      return false;
+
     // Incorporate linker arguments needed for Go.
     bool isStatic = args.hasArg(gollvm::options::OPT_static);
     if (isStatic)
@@ -427,7 +599,12 @@ bool Linker::constructCommand(Compilation &compilation,
   cmdArgs.push_back(nullptr);
 
   // Add final command.
-  compilation.addCommand(jobAction, *this, executable, cmdArgs);
+  Command::InProcessHook hook;
+#ifdef GOLLVM_USE_LLD_LIBRARY
+  if (inProcess)
+    hook = linkWithLld;
+#endif
+  compilation.addCommand(jobAction, *this, executable, cmdArgs, hook);
   cmdArgs.push_back(nullptr);
 
   return true;
@@ -65,6 +65,8 @@ class Linker : public ExternalTool {
                  llvm::opt::ArgStringList &cmdArgs);
   void addSharedAndOrStaticFlags(llvm::opt::ArgStringList &cmdArgs);
   void addFilePathArgs(llvm::opt::ArgStringList &cmdArgs);
+  void addStackMapIndexArgs(llvm::opt::ArgStringList &cmdArgs);
+  bool addXRayRuntimeArgs(llvm::opt::ArgStringList &cmdArgs);
 };
 
 } // end namespace gnutools
@@ -24,4 +24,13 @@
 // Gollvm default linker
 #define GOLLVM_DEFAULT_LINKER "@GOLLVM_DEFAULT_LINKER@"
 
+// Define if the driver is linked with the lld ELF library, so that
+// -fuse-ld=lld links can be done in-process.
+#cmakedefine GOLLVM_USE_LLD_LIBRARY
+
+// Defined for each LLVM target supported by gollvm that is built
+// (see TargetSetup.cpp).
+#cmakedefine GOLLVM_HAVE_TARGET_X86
+#cmakedefine GOLLVM_HAVE_TARGET_AARCH64
+
 #endif // GOLLVM_CONFIG_H
@@ -25,6 +25,7 @@
 #include "ArchCpuSetup.h"
 #include "Artifact.h"
 #include "Driver.h"
+#include "TargetSetup.h"
 #include "ToolChain.h"
 
 #include "llvm/ADT/Triple.h"
@@ -60,7 +61,6 @@
 #include "llvm/Support/Regex.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/SourceMgr.h"
-#include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
 
@@ -90,9 +90,12 @@ class IntegAssemblerImpl {
   const char *progname_;
   std::string executablePath_;
   opt::InputArgList &args_;
+  const Artifact *input_;
   std::string inputFileName_;
   std::string objOutFileName_;
   std::unique_ptr<raw_fd_ostream> objout_;
+  std::string dwoOutFileName_;
+  std::unique_ptr<raw_fd_ostream> dwoout_;
 
   bool resolveInputOutput(const Action &jobAction,
                           const ArtifactList &inputArtifacts,
@@ -107,12 +110,9 @@ IntegAssemblerImpl::IntegAssemblerImpl(IntegAssembler &ia, ToolChain &tc, const
       driver_(tc.driver()),
       progname_(tc.driver().progname()),
       executablePath_(executablePath),
-      args_(tc.driver().args())
+      args_(tc.driver().args()),
+      input_(nullptr)
 {
-  InitializeAllTargets();
-  InitializeAllTargetMCs();
-  InitializeAllAsmPrinters();
-  InitializeAllAsmParsers();
 }
 
 bool IntegAssemblerImpl::resolveInputOutput(const Action &jobAction,
@@ -125,7 +125,8 @@ bool IntegAssemblerImpl::resolveInputOutput(const Action &jobAction,
            << inputArtifacts.size() << " provided.\n";
     return false;
   }
-  inputFileName_ = inputArtifacts[0]->file();
+  input_ = inputArtifacts[0];
+  inputFileName_ = input_->name();
   objOutFileName_ = output.file();
 
   // Remove output on signal.
@@ -142,6 +143,20 @@ bool IntegAssemblerImpl::resolveInputOutput(const Action &jobAction,
            << EC.message() << '\n';
     return false;
   }
+
+  // With -gsplit-dwarf, sections whose names end in .dwo (emitted by
+  // the compiler in that mode) go to a separate file.
+  dwoOutFileName_ = driver_.splitDwarfFile(jobAction);
+  if (!dwoOutFileName_.empty()) {
+    sys::RemoveFileOnSignal(dwoOutFileName_);
+    dwoout_ = std::make_unique<raw_fd_ostream>(
+        dwoOutFileName_, EC, OpenFlags);
+    if (EC) {
+      errs() << progname_ << ": error opening " << dwoOutFileName_ << ": "
+             << EC.message() << '\n';
+      return false;
+    }
+  }
   return true;
 }
 
@@ -156,8 +171,7 @@ bool IntegAssemblerImpl::invokeAssembler()
     return false;
   }
 
-  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
-      MemoryBuffer::getFileOrSTDIN(inputFileName_);
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = input_->contents();
   if (std::error_code EC = Buffer.getError()) {
     Error = EC.message();
     errs() << progname_ << ": opening/reading " << inputFileName_ << ": "
@@ -246,7 +260,9 @@ bool IntegAssemblerImpl::invokeAssembler()
       TheTarget->createMCCodeEmitter(*MCII, *MRI, Ctx));
   std::unique_ptr<MCAsmBackend> MAB(
       TheTarget->createMCAsmBackend(*STI, *MRI, MCOptions));
-  std::unique_ptr<MCObjectWriter> OW = MAB->createObjectWriter(*Out);
+  std::unique_ptr<MCObjectWriter> OW =
+      (dwoout_ ? MAB->createDwoObjectWriter(*Out, *dwoout_) :
+       MAB->createObjectWriter(*Out));
 
   Triple T(driver_.triple());
   unsigned RelaxAll = 0;
@@ -285,11 +301,14 @@ bool IntegAssemblerImpl::invokeAssembler()
   // Close the output stream early.
   BOS.reset();
   objout_.reset();
+  dwoout_.reset();
 
-  // Delete output file if there were errors.
+  // Delete output files if there were errors.
   if (Failed) {
     if (objOutFileName_ != "-")
       sys::fs::remove(objOutFileName_);
+    if (!dwoOutFileName_.empty())
+      sys::fs::remove(dwoOutFileName_);
   }
 
   return !Failed;
@@ -317,9 +336,9 @@ bool IntegAssemblerImpl::performAction(Compilation &compilation,
 //........................................................................
 
 IntegAssembler::IntegAssembler(ToolChain &tc, const std::string &executablePath)
-    : InternalTool("integassembler", tc, executablePath),
-      impl_(new IntegAssemblerImpl(*this, tc, executablePath))
+    : InternalTool("integassembler", tc, executablePath)
 {
+  initializeTargetFor(tc.driver().triple());
 }
 
 IntegAssembler::~IntegAssembler()
@@ -331,7 +350,10 @@ bool IntegAssembler::performAction(Compilation &compilation,
                               const ArtifactList &inputArtifacts,
                               const Artifact &output)
 {
-  return impl_->performAction(compilation, jobAction, inputArtifacts, output);
+  // A fresh implementation object per action, so that several files
+  // can be assembled at once.
+  IntegAssemblerImpl impl(*this, toolchain(), executablePath());
+  return impl.performAction(compilation, jobAction, inputArtifacts, output);
 }
 
 
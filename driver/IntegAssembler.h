@@ -22,7 +22,6 @@ class ToolChain;
 class Compilation;
 class Action;
 class Artifact;
-class IntegAssemblerImpl;
 
 // Integrated assembler tool. This tool is used by the driver to carry
 // out "assemble" actions when -fintegrated-as is in effect, e.g. "compile
@@ -39,8 +38,8 @@ class IntegAssembler : public InternalTool {
                      const ArtifactList &inputArtifacts,
                      const Artifact &output) override;
 
- private:
-  std::unique_ptr<IntegAssemblerImpl> impl_;
+  bool isReentrant() const override { return true; }
+  bool readsBufferInputs() const override { return true; }
 };
 
 } // end namespace driver
@@ -0,0 +1,110 @@
+//===-- Jobserver.cpp -----------------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Gollvm driver helper class Jobserver methods.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Jobserver.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Process.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace gollvm {
+namespace driver {
+
+Jobserver::Jobserver(int readfd, int writefd, bool ownFds)
+    : readfd_(readfd),
+      writefd_(writefd),
+      ownFds_(ownFds)
+{
+}
+
+Jobserver::~Jobserver()
+{
+  if (!ownFds_)
+    return;
+  ::close(readfd_);
+  if (writefd_ != readfd_)
+    ::close(writefd_);
+}
+
+static bool validFd(int fd)
+{
+  return fd >= 0 && ::fcntl(fd, F_GETFD) != -1;
+}
+
+std::unique_ptr<Jobserver> Jobserver::fromEnvironment()
+{
+  llvm::Optional<std::string> flags =
+      llvm::sys::Process::GetEnv("MAKEFLAGS");
+  if (!flags)
+    return nullptr;
+  return fromMakeflags(*flags);
+}
+
+std::unique_ptr<Jobserver> Jobserver::fromMakeflags(llvm::StringRef flags)
+{
+  // If the option appears more than once the last one wins, as in make.
+  llvm::StringRef auth;
+  llvm::SmallVector<llvm::StringRef, 8> words;
+  flags.split(words, ' ', -1, false);
+  for (llvm::StringRef w : words) {
+    if (w.consume_front("--jobserver-auth=") ||
+        w.consume_front("--jobserver-fds="))
+      auth = w;
+  }
+  if (auth.empty())
+    return nullptr;
+
+  if (auth.consume_front("fifo:")) {
+    std::string path(auth);
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+      return nullptr;
+    return std::unique_ptr<Jobserver>(new Jobserver(fd, fd, true));
+  }
+
+  std::pair<llvm::StringRef, llvm::StringRef> fds = auth.split(',');
+  int readfd, writefd;
+  if (fds.first.getAsInteger(10, readfd) ||
+      fds.second.getAsInteger(10, writefd))
+    return nullptr;
+  if (!validFd(readfd) || !validFd(writefd))
+    return nullptr;
+  return std::unique_ptr<Jobserver>(new Jobserver(readfd, writefd, false));
+}
+
+bool Jobserver::acquire(char *token)
+{
+  for (;;) {
+    ssize_t n = ::read(readfd_, token, 1);
+    if (n == 1)
+      return true;
+    if (n < 0 && errno == EINTR)
+      continue;
+    return false;
+  }
+}
+
+void Jobserver::release(char token)
+{
+  for (;;) {
+    ssize_t n = ::write(writefd_, &token, 1);
+    if (n < 0 && errno == EINTR)
+      continue;
+    return;
+  }
+}
+
+} // end namespace driver
+} // end namespace gollvm
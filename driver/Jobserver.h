@@ -0,0 +1,62 @@
+//===-- Jobserver.h -------------------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Defines the Jobserver class (helper for driver functionality).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef GOLLVM_DRIVER_JOBSERVER_H
+#define GOLLVM_DRIVER_JOBSERVER_H
+
+#include <memory>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace gollvm {
+namespace driver {
+
+// Client side of the GNU make jobserver protocol. When llvm-goc is
+// run from a recipe of a parallel make, make passes the jobserver in
+// MAKEFLAGS as a pipe (--jobserver-auth=R,W or the older
+// --jobserver-fds=R,W) or, from make 4.4 on, as a named fifo
+// (--jobserver-auth=fifo:PATH). Every process gets one implicit job
+// slot; each job beyond that needs a token read from the jobserver,
+// which must be written back once the job is done.
+
+class Jobserver {
+ public:
+  ~Jobserver();
+
+  // Return a jobserver client for the jobserver named in MAKEFLAGS,
+  // or null if there is none or it is not usable from this process
+  // (make closes the descriptors for recipes it does not consider
+  // recursive).
+  static std::unique_ptr<Jobserver> fromEnvironment();
+
+  // Parse a MAKEFLAGS value; exposed for unit testing.
+  static std::unique_ptr<Jobserver> fromMakeflags(llvm::StringRef flags);
+
+  // Wait until a token is available and take it. Returns false if
+  // the jobserver can no longer be read.
+  bool acquire(char *token);
+
+  // Give back a token obtained from acquire().
+  void release(char token);
+
+ private:
+  Jobserver(int readfd, int writefd, bool ownFds);
+
+  int readfd_;
+  int writefd_;
+  bool ownFds_;
+};
+
+} // end namespace driver
+} // end namespace gollvm
+
+#endif // GOLLVM_DRIVER_JOBSERVER_H
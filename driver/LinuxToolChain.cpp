@@ -26,10 +26,12 @@ using namespace gollvm::driver;
 
 namespace toolchains {
 
-static void addIfPathExists(pathlist &paths, const llvm::Twine &path)
+static void addIfPathExists(gnutools::gccdetect::InspectFS &ifs,
+                            pathlist &paths, const llvm::Twine &path)
 {
-  if (llvm::sys::fs::exists(path))
-    paths.push_back(path.str());
+  std::string p(path.str());
+  if (ifs.exists(p))
+    paths.push_back(p);
 }
 
 static llvm::StringRef getOSLibDir(const llvm::Triple &triple)
@@ -49,48 +51,95 @@ Linux::Linux(gollvm::driver::Driver &driver,
              const llvm::Triple &targetTriple)
     : ToolChain(driver, targetTriple),
       inspectFS_(gnutools::gccdetect::InspectRealFS()),
+      trackingFS_(inspectFS_),
       gccDetector_(targetTriple,
                    driver.gccToolchainDir(),
                    driver.sysRoot(),
-                   inspectFS_),
+                   trackingFS_),
       distro_(distro::DetectDistro(inspectFS_, targetTriple))
+{
+  // GCC detection and path setup are skipped if a previous run left
+  // results behind that are still valid.
+  ToolchainCache *cache = driver.toolchainCache();
+  if (!cache || !restoreFromCache(*cache)) {
+    detect(driver, targetTriple);
+    if (cache)
+      saveToCache(*cache);
+  }
+
+  // Include program and file paths in verbose output.
+  if (driver.args().hasArg(gollvm::options::OPT_v)) {
+    llvm::errs() << "Candidate GCC install:\n" << gccDetector_.toString();
+
+    llvm::errs() << "ProgramPaths:\n";
+    for (auto &path : programPaths())
+      llvm::errs() << path << "\n";
+    llvm::errs() << "FilePaths:\n";
+    for (auto &path : filePaths())
+      llvm::errs() << path << "\n";
+  }
+}
+
+void Linux::detect(gollvm::driver::Driver &driver,
+                   const llvm::Triple &targetTriple)
 {
   gccDetector_.init();
 
   // Program paths
   pathlist &ppaths = programPaths();
   auto ftrip = gccDetector_.foundTriple().str();
-  addIfPathExists(ppaths, llvm::Twine(gccDetector_.getParentLibPath() +
-                                      "/../../" + ftrip +
-                                      "/bin").str());
+  addIfPathExists(trackingFS_, ppaths,
+                  llvm::Twine(gccDetector_.getParentLibPath() +
+                              "/../../" + ftrip + "/bin").str());
 
   // File paths
   pathlist &fpaths = filePaths();
-  addIfPathExists(fpaths, gccDetector_.getLibPath());
+  addIfPathExists(trackingFS_, fpaths, gccDetector_.getLibPath());
   std::string osLibDir = getOSLibDir(targetTriple).str();
   if (!driver.sysRoot().empty()) {
-    addIfPathExists(fpaths, llvm::Twine(driver.sysRoot() + "/usr/"
-                                        + osLibDir).str());
+    addIfPathExists(trackingFS_, fpaths,
+                    llvm::Twine(driver.sysRoot() + "/usr/" + osLibDir).str());
     osLibDir = driver.sysRoot() + "/" + osLibDir;
   }
-  addIfPathExists(fpaths, llvm::Twine(gccDetector_.getParentLibPath() +
-                                      "/../" + ftrip).str());
-  addIfPathExists(fpaths, llvm::Twine(osLibDir).str());
-  addIfPathExists(fpaths, llvm::Twine(osLibDir + "/" + ftrip).str());
+  addIfPathExists(trackingFS_, fpaths,
+                  llvm::Twine(gccDetector_.getParentLibPath() +
+                              "/../" + ftrip).str());
+  addIfPathExists(trackingFS_, fpaths, llvm::Twine(osLibDir).str());
+  addIfPathExists(trackingFS_, fpaths,
+                  llvm::Twine(osLibDir + "/" + ftrip).str());
   if (this->distro_ == distro::DistroArchLinux || this->distro_ == distro::DistroRedhat)
-    addIfPathExists(fpaths, llvm::Twine("/usr/" + osLibDir).str());
+    addIfPathExists(trackingFS_, fpaths, llvm::Twine("/usr/" + osLibDir).str());
+}
 
-  // Include program and file paths in verbose output.
-  if (driver.args().hasArg(gollvm::options::OPT_v)) {
-    llvm::errs() << "Candidate GCC install:\n" << gccDetector_.toString();
+bool Linux::restoreFromCache(ToolchainCache &cache)
+{
+  std::string version, ftrip, install, lib, parentLib;
+  pathlist ppaths, fpaths;
+  if (!cache.lookup("gcc.version", version) ||
+      !cache.lookup("gcc.triple", ftrip) ||
+      !cache.lookup("gcc.installPath", install) ||
+      !cache.lookup("gcc.libPath", lib) ||
+      !cache.lookup("gcc.parentLibPath", parentLib) ||
+      !cache.lookupList("programPaths", ppaths) ||
+      !cache.lookupList("filePaths", fpaths))
+    return false;
+  gccDetector_.restore(version, ftrip, install, lib, parentLib);
+  programPaths() = ppaths;
+  filePaths() = fpaths;
+  return true;
+}
 
-    llvm::errs() << "ProgramPaths:\n";
-    for (auto &path : programPaths())
-      llvm::errs() << path << "\n";
-    llvm::errs() << "FilePaths:\n";
-    for (auto &path : filePaths())
-      llvm::errs() << path << "\n";
-  }
+void Linux::saveToCache(ToolchainCache &cache)
+{
+  std::vector<std::string> deps(trackingFS_.consulted().begin(),
+                                trackingFS_.consulted().end());
+  cache.insert("gcc.version", gccDetector_.version().text(), deps);
+  cache.insert("gcc.triple", gccDetector_.foundTriple().str(), deps);
+  cache.insert("gcc.installPath", gccDetector_.getInstallPath(), deps);
+  cache.insert("gcc.libPath", gccDetector_.getLibPath(), deps);
+  cache.insert("gcc.parentLibPath", gccDetector_.getParentLibPath(), deps);
+  cache.insertList("programPaths", programPaths(), deps);
+  cache.insertList("filePaths", filePaths(), deps);
 }
 
 Linux::~Linux()
@@ -16,6 +16,7 @@
 #include "ToolChain.h"
 #include "GccUtils.h"
 #include "Distro.h"
+#include "ToolchainCache.h"
 
 namespace toolchains {
 
@@ -34,8 +35,14 @@ class Linux : public gollvm::driver::ToolChain {
 
  private:
   gnutools::gccdetect::InspectRealFS inspectFS_;
+  gnutools::gccdetect::InspectTrackingFS trackingFS_;
   gnutools::gccdetect::GCCInstallationDetector gccDetector_;
   distro::DistroVariety distro_;
+
+  void detect(gollvm::driver::Driver &driver,
+              const llvm::Triple &targetTriple);
+  bool restoreFromCache(gollvm::driver::ToolchainCache &cache);
+  void saveToCache(gollvm::driver::ToolchainCache &cache);
 };
 
 } // end namespace toolchains
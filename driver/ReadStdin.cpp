@@ -59,6 +59,12 @@ bool ReadStdin::performAction(Compilation &compilation,
     return false;
   }
 
+  // Hand the buffer over as is if the output is kept in memory.
+  if (output.type() == Artifact::A_Buffer) {
+    output.setBuffer(std::move(stdinBuf));
+    return true;
+  }
+
   // Emit to the output artifact.
   std::error_code errc;
   llvm::raw_fd_ostream ostr(output.file(), errc,
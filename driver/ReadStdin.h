@@ -26,9 +26,10 @@ class Artifact;
 // This class encapsulates the reading of standard input during a compilation
 // that includes the pseudo-input flag "-". The driver handles this case
 // by creating a tool (ReadStdin) that consumes standard input and emits
-// a temporary file, which is then piped through the remainder of the compiler
-// as usual.  See also the notes in the command parsing code relating to
-// handling of and "-x c".
+// it as an in-memory artifact (or a temporary file, with -save-temps),
+// which is then piped through the remainder of the compiler as usual.
+// See also the notes in the command parsing code relating to handling
+// of and "-x c".
 
 class ReadStdin : public InternalTool {
  public:
@@ -43,6 +44,8 @@ class ReadStdin : public InternalTool {
                      const ArtifactList &inputArtifacts,
                      const Artifact &output) override;
 
+  bool writesBufferOutput() const override { return true; }
+
  private:
   bool mustBeEmpty_;
 };
@@ -0,0 +1,83 @@
+//===-- TargetSetup.cpp ---------------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Gollvm driver helper function initializeTargetFor.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TargetSetup.h"
+
+#include "GollvmConfig.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include <mutex>
+
+namespace gollvm {
+namespace driver {
+
+namespace {
+
+// Entry points for registering the pieces of one LLVM target.
+struct TargetInitializer {
+  llvm::Triple::ArchType arch;
+  void (*initTargetInfo)();
+  void (*initTarget)();
+  void (*initTargetMC)();
+  void (*initAsmPrinter)();
+  void (*initAsmParser)();
+};
+
+} // end anonymous namespace
+
+// Targets supported by gollvm that were also built into LLVM
+// (GOLLVM_HAVE_TARGET_* are set up by AddGollvm.cmake). When adding
+// an architecture here, add its LLVM target name to
+// gollvm_supported_targets as well.
+static const TargetInitializer initializers[] = {
+#ifdef GOLLVM_HAVE_TARGET_X86
+  { llvm::Triple::x86_64,
+    LLVMInitializeX86TargetInfo, LLVMInitializeX86Target,
+    LLVMInitializeX86TargetMC, LLVMInitializeX86AsmPrinter,
+    LLVMInitializeX86AsmParser },
+#endif
+#ifdef GOLLVM_HAVE_TARGET_AARCH64
+  { llvm::Triple::aarch64,
+    LLVMInitializeAArch64TargetInfo, LLVMInitializeAArch64Target,
+    LLVMInitializeAArch64TargetMC, LLVMInitializeAArch64AsmPrinter,
+    LLVMInitializeAArch64AsmParser },
+#endif
+  { llvm::Triple::UnknownArch, nullptr, nullptr, nullptr, nullptr, nullptr }
+};
+
+bool initializeTargetFor(const llvm::Triple &triple)
+{
+  static std::mutex mutex;
+  static bool initialized[llvm::array_lengthof(initializers)];
+
+  for (unsigned idx = 0; initializers[idx].initTarget; ++idx) {
+    const TargetInitializer &ti = initializers[idx];
+    if (ti.arch != triple.getArch())
+      continue;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized[idx]) {
+      ti.initTargetInfo();
+      ti.initTarget();
+      ti.initTargetMC();
+      ti.initAsmPrinter();
+      ti.initAsmParser();
+      initialized[idx] = true;
+    }
+    return true;
+  }
+  return false;
+}
+
+} // end namespace driver
+} // end namespace gollvm
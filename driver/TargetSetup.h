@@ -0,0 +1,37 @@
+//===-- TargetSetup.h -----------------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Declares gollvm driver helper function initializeTargetFor.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef GOLLVM_DRIVER_TARGETSETUP_H
+#define GOLLVM_DRIVER_TARGETSETUP_H
+
+#include "llvm/ADT/Triple.h"
+
+namespace gollvm {
+namespace driver {
+
+// Register the LLVM target (target info, MC layer, asm printer and
+// asm parser) for the architecture of 'triple' with the target
+// registry. Only the architectures that gollvm supports are known
+// here; for any other architecture nothing is registered (and the
+// subsequent target lookup reports the error). Returns TRUE if the
+// target is available. Safe to call more than once, and from
+// multiple threads.
+//
+// This replaces the InitializeAll* calls, which register every
+// target LLVM was configured with and pull all of them into the
+// llvm-goc binary (see GOLLVM_SUPPORTED_TARGETS_ONLY).
+bool initializeTargetFor(const llvm::Triple &triple);
+
+} // end namespace driver
+} // end namespace gollvm
+
+#endif // GOLLVM_DRIVER_TARGETSETUP_H
@@ -72,6 +72,18 @@ class InternalTool : public Tool {
                              const ArtifactList &inputArtifacts,
                              const Artifact &output) = 0;
 
+  // Whether performAction may be called for several actions at the
+  // same time, from different threads. Tools that keep per-action
+  // state, or that use global state (such as the Go front end), must
+  // leave this false; the driver then runs their actions one at a time.
+  virtual bool isReentrant() const { return false; }
+
+  // Whether the tool can take in-memory (A_Buffer) artifacts as input,
+  // and whether it can produce its output as one. Intermediate results
+  // passed between two internal tools that both agree stay in memory.
+  virtual bool readsBufferInputs() const { return false; }
+  virtual bool writesBufferOutput() const { return false; }
+
   // Helper to emit output for "-v" or "-###" command line option when supplied
   // to an internal tool. Return value is TRUE if if the compilation should be
   // stubbed out (-###) or FALSE otherwise.
@@ -0,0 +1,300 @@
+//===-- ToolchainCache.cpp ------------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Gollvm driver helper class ToolchainCache methods.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ToolchainCache.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <sstream>
+
+namespace gollvm {
+namespace driver {
+
+// Bump this if the meaning or format of the entries changes.
+static const int64_t cacheFormatVersion = 3;
+
+// Modification time of 'path' (file or directory), or -1 if it does
+// not exist.
+static int64_t modTime(llvm::StringRef path)
+{
+  llvm::sys::fs::file_status st;
+  if (llvm::sys::fs::status(path, st))
+    return -1;
+  return st.getLastModificationTime().time_since_epoch().count();
+}
+
+static std::string absolutePath(llvm::StringRef path)
+{
+  llvm::SmallString<256> abspath(path.empty() ? "." : path);
+  llvm::sys::fs::make_absolute(abspath);
+  llvm::sys::path::remove_dots(abspath);
+  return std::string(abspath);
+}
+
+std::string ToolchainCache::containingDir(llvm::StringRef path)
+{
+  llvm::StringRef dir = llvm::sys::path::parent_path(path);
+  return dir.empty() ? "." : dir.str();
+}
+
+ToolchainCache::ToolchainCache(const std::string &path,
+                               const std::string &key)
+    : path_(path),
+      key_(key),
+      loaded_(false),
+      dirty_(false)
+{
+}
+
+std::string ToolchainCache::defaultPath(llvm::StringRef key)
+{
+  llvm::SmallString<256> path;
+  if (!llvm::sys::path::cache_directory(path))
+    return "";
+  llvm::sys::path::append(path, "gollvm");
+  llvm::sys::path::append(path, "toolchain-" +
+                          llvm::utohexstr(llvm::xxHash64(key)) + ".json");
+  return std::string(path);
+}
+
+void ToolchainCache::clear()
+{
+  entries_.clear();
+  loaded_ = false;
+}
+
+// Read one entry of the cache file.
+static bool readEntry(const llvm::json::Object &obj,
+                      std::string &value,
+                      std::vector<std::string> &values,
+                      bool &isList,
+                      std::map<std::string, int64_t> &deps)
+{
+  const llvm::json::Object *depobj = obj.getObject("deps");
+  if (!depobj)
+    return false;
+  for (auto &dep : *depobj) {
+    llvm::Optional<int64_t> mtime = dep.second.getAsInteger();
+    if (!mtime)
+      return false;
+    deps[dep.first.str()] = *mtime;
+  }
+  if (llvm::Optional<llvm::StringRef> s = obj.getString("value")) {
+    value = s->str();
+    isList = false;
+    return true;
+  }
+  const llvm::json::Array *arr = obj.getArray("values");
+  if (!arr)
+    return false;
+  for (const llvm::json::Value &elem : *arr) {
+    llvm::Optional<llvm::StringRef> s = elem.getAsString();
+    if (!s)
+      return false;
+    values.push_back(s->str());
+  }
+  isList = true;
+  return true;
+}
+
+bool ToolchainCache::load()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  clear();
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> mbOrErr =
+      llvm::MemoryBuffer::getFile(path_);
+  if (!mbOrErr)
+    return false;
+  llvm::Expected<llvm::json::Value> val =
+      llvm::json::parse((*mbOrErr)->getBuffer());
+  if (!val) {
+    llvm::consumeError(val.takeError());
+    return false;
+  }
+  const llvm::json::Object *obj = val->getAsObject();
+  if (!obj || obj->getInteger("version") != cacheFormatVersion ||
+      obj->getString("key") != llvm::StringRef(key_))
+    return false;
+  const llvm::json::Object *entries = obj->getObject("entries");
+  if (!entries)
+    return false;
+
+  // The dependences are not checked here, but as entries are looked
+  // up; most runs only need a few of them.
+  for (auto &ent : *entries) {
+    const llvm::json::Object *entobj = ent.second.getAsObject();
+    Entry e;
+    if (!entobj ||
+        !readEntry(*entobj, e.value, e.values, e.isList, e.deps)) {
+      clear();
+      return false;
+    }
+    entries_[ent.first.str()] = std::move(e);
+  }
+  loaded_ = true;
+  return true;
+}
+
+bool ToolchainCache::save()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!dirty_)
+    return true;
+
+  llvm::json::Object entries;
+  for (auto &ent : entries_) {
+    llvm::json::Object deps;
+    for (auto &dep : ent.second.deps)
+      deps[dep.first] = dep.second;
+    llvm::json::Object entobj{{"deps", std::move(deps)}};
+    if (ent.second.isList)
+      entobj["values"] = llvm::json::Array(ent.second.values);
+    else
+      entobj["value"] = ent.second.value;
+    entries[ent.first] = std::move(entobj);
+  }
+  llvm::json::Object top{{"version", cacheFormatVersion},
+                         {"key", key_},
+                         {"entries", std::move(entries)}};
+  std::string buf;
+  llvm::raw_string_ostream os(buf);
+  os << llvm::formatv("{0:2}", llvm::json::Value(std::move(top))) << "\n";
+  os.flush();
+
+  // Write to a temporary and rename it into place, so that concurrent
+  // driver invocations never see a partially written cache.
+  llvm::StringRef dir = llvm::sys::path::parent_path(path_);
+  if (!dir.empty() && llvm::sys::fs::create_directories(dir))
+    return false;
+  llvm::Error err = llvm::writeFileAtomically(path_ + "-%%%%%%%%", path_, buf);
+  if (err) {
+    llvm::consumeError(std::move(err));
+    return false;
+  }
+  dirty_ = false;
+  return true;
+}
+
+// Returns the entry 'name' of the given kind if it is present and
+// still current, dropping it if it is out of date. Called with the
+// lock held.
+
+ToolchainCache::Entry *ToolchainCache::findCurrent(llvm::StringRef name,
+                                                   bool isList)
+{
+  auto it = entries_.find(name.str());
+  if (it == entries_.end() || it->second.isList != isList)
+    return nullptr;
+  for (auto &dep : it->second.deps) {
+    auto st = stamps_.find(dep.first);
+    if (st == stamps_.end())
+      st = stamps_.emplace(dep.first, modTime(dep.first)).first;
+    if (st->second != dep.second) {
+      entries_.erase(it);
+      dirty_ = true;
+      return nullptr;
+    }
+  }
+  return &it->second;
+}
+
+void ToolchainCache::add(llvm::StringRef name, Entry &&ent,
+                         llvm::ArrayRef<std::string> deps)
+{
+  for (const std::string &dep : deps) {
+    std::string abspath = absolutePath(dep);
+    int64_t mtime = modTime(abspath);
+    ent.deps[abspath] = mtime;
+    stamps_[abspath] = mtime;
+  }
+  entries_[name.str()] = std::move(ent);
+  dirty_ = true;
+}
+
+bool ToolchainCache::lookup(llvm::StringRef name, std::string &value)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry *ent = findCurrent(name, false);
+  if (!ent)
+    return false;
+  value = ent->value;
+  return true;
+}
+
+void ToolchainCache::insert(llvm::StringRef name, llvm::StringRef value,
+                            llvm::ArrayRef<std::string> deps)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry ent;
+  ent.value = value.str();
+  ent.isList = false;
+  add(name, std::move(ent), deps);
+}
+
+bool ToolchainCache::lookupList(llvm::StringRef name,
+                                llvm::SmallVectorImpl<std::string> &values)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry *ent = findCurrent(name, true);
+  if (!ent)
+    return false;
+  values.assign(ent->values.begin(), ent->values.end());
+  return true;
+}
+
+void ToolchainCache::insertList(llvm::StringRef name,
+                                llvm::ArrayRef<std::string> values,
+                                llvm::ArrayRef<std::string> deps)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry ent;
+  ent.values = values.vec();
+  ent.isList = true;
+  add(name, std::move(ent), deps);
+}
+
+std::string ToolchainCache::toString()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::stringstream ss;
+  ss << "cache: " << path_ << "\n";
+  ss << "key: " << key_ << "\n";
+  ss << "loaded: " << (loaded_ ? "yes" : "no") << "\n";
+  ss << "entries:\n";
+  for (auto &ent : entries_) {
+    if (ent.second.isList) {
+      ss << "  " << ent.first << ":\n";
+      for (auto &val : ent.second.values)
+        ss << "    " << val << "\n";
+    } else {
+      ss << "  " << ent.first << ": " << ent.second.value << "\n";
+    }
+    ss << "    deps:\n";
+    for (auto &dep : ent.second.deps)
+      ss << "      " << dep.first << " " << dep.second << "\n";
+  }
+  return ss.str();
+}
+
+} // end namespace driver
+} // end namespace gollvm
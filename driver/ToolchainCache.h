@@ -0,0 +1,122 @@
+//===-- ToolchainCache.h --------------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Defines the ToolchainCache class (helper for driver functionality).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef GOLLVM_DRIVER_TOOLCHAINCACHE_H
+#define GOLLVM_DRIVER_TOOLCHAINCACHE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace gollvm {
+namespace driver {
+
+// On-disk cache for the results of toolchain discovery (GCC
+// installation detection, program/file path lookups, Go package
+// search path setup). Each of these walks or stats a fair number of
+// directories on every driver invocation, which adds up when the
+// directories live on a network file system.
+//
+// A cache file is tied to a key (formed by the driver from the
+// target triple, sysroot, GCC toolchain dir, -B prefixes and the
+// identity of the driver binary). Entries are either strings or lists
+// of strings, named by the client. Each entry records the directories
+// its value was computed from, along with their modification times (a
+// directory's changes when entries are added or removed; a missing
+// directory counts as such). Clients record the directory a file was
+// looked for in rather than the file itself, so that the many entries
+// that search the same few directories share their checks. An entry
+// is dropped, and recomputed by the client, once any of its
+// directories has changed; other entries are not affected. Paths are
+// only checked when an entry is looked up, and each path at most once
+// per driver run.
+
+class ToolchainCache {
+ public:
+  ToolchainCache(const std::string &path, const std::string &key);
+
+  // Returns the default location of the cache file for the specified
+  // key (within the user's cache directory), or an empty string if
+  // there is no such directory.
+  static std::string defaultPath(llvm::StringRef key);
+
+  // Read the cache file, returning false if it does not exist or has
+  // a different key. In either case the cache starts out empty.
+  bool load();
+
+  // Write the cache back to disk if any entries were added since it
+  // was loaded. Returns false on error.
+  bool save();
+
+  // Look up a string entry. Returns false if there is none, or if
+  // any of the paths it depends on has changed.
+  bool lookup(llvm::StringRef name, std::string &value);
+
+  // Add a string entry whose value was computed from 'deps'
+  // (directories, or other paths, which need not exist).
+  void insert(llvm::StringRef name, llvm::StringRef value,
+              llvm::ArrayRef<std::string> deps);
+
+  // Look up/add a string list entry, as above.
+  bool lookupList(llvm::StringRef name,
+                  llvm::SmallVectorImpl<std::string> &values);
+  void insertList(llvm::StringRef name, llvm::ArrayRef<std::string> values,
+                  llvm::ArrayRef<std::string> deps);
+
+  // The directory to record as a dependence for the existence of
+  // 'path': its parent directory (or "." for a bare name).
+  static std::string containingDir(llvm::StringRef path);
+
+  // Location of the cache file.
+  const std::string &path() const { return path_; }
+
+  // Returns TRUE if the contents came from disk.
+  bool loaded() const { return loaded_; }
+
+  // For -print-toolchain-cache and unit testing.
+  std::string toString();
+
+ private:
+  struct Entry {
+    // Exactly one of these is used, depending on the kind of entry.
+    std::string value;
+    std::vector<std::string> values;
+    bool isList;
+    // Paths the value depends on, with their modification times (or
+    // -1 if not present) at the time it was computed.
+    std::map<std::string, int64_t> deps;
+  };
+
+  std::string path_;
+  std::string key_;
+  std::map<std::string, Entry> entries_;
+  // Current modification time of each path checked so far.
+  std::map<std::string, int64_t> stamps_;
+  std::mutex mutex_;
+  bool loaded_;
+  bool dirty_;
+
+  void clear();
+  Entry *findCurrent(llvm::StringRef name, bool isList);
+  void add(llvm::StringRef name, Entry &&ent,
+           llvm::ArrayRef<std::string> deps);
+};
+
+} // end namespace driver
+} // end namespace gollvm
+
+#endif // GOLLVM_DRIVER_TOOLCHAINCACHE_H
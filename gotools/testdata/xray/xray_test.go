@@ -0,0 +1,107 @@
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Checks that the XRay sleds of a program built with -fxray-instrument
+// can be patched to call a Go handler, and unpatched again, through
+// the hooks in libgo's go-xray.c.
+
+package xray
+
+import (
+	"runtime"
+	"strings"
+	"sync/atomic"
+	"testing"
+)
+
+//extern __go_xray_set_handler
+func xraySetHandler(func(id int32, kind int32)) int32
+
+//extern __go_xray_remove_handler
+func xrayRemoveHandler() int32
+
+//extern __go_xray_patch
+func xrayPatch() int32
+
+//extern __go_xray_unpatch
+func xrayUnpatch() int32
+
+//extern __go_xray_function_address
+func xrayFunctionAddress(id int32) uintptr
+
+type event struct {
+	id, kind int32
+}
+
+var (
+	events  [1024]event
+	nevents int32
+)
+
+// The handler only records the event; it must not block.
+func handler(id int32, kind int32) {
+	n := atomic.AddInt32(&nevents, 1) - 1
+	if int(n) < len(events) {
+		events[n] = event{id, kind}
+	}
+}
+
+// Small, but XRay instruments functions with loops regardless of
+// -fxray-instruction-threshold.
+//
+//go:noinline
+func traced(s []int) int {
+	t := 0
+	for _, v := range s {
+		t += v
+	}
+	return t
+}
+
+// Run traced, and return the events recorded for it.
+func trace(t *testing.T) []int32 {
+	atomic.StoreInt32(&nevents, 0)
+	if traced([]int{1, 2, 3}) != 6 {
+		t.Fatal("traced returned the wrong result")
+	}
+	n := int(atomic.LoadInt32(&nevents))
+	if n > len(events) {
+		t.Fatalf("%d events, more than the %d expected", n, len(events))
+	}
+	var kinds []int32
+	for _, e := range events[:n] {
+		f := runtime.FuncForPC(xrayFunctionAddress(e.id))
+		if f != nil && strings.HasSuffix(f.Name(), ".traced") {
+			kinds = append(kinds, e.kind)
+		}
+	}
+	return kinds
+}
+
+func TestPatchUnpatch(t *testing.T) {
+	if xraySetHandler(handler) != 0 {
+		t.Fatal("__go_xray_set_handler failed; XRay runtime not linked?")
+	}
+	defer xrayRemoveHandler()
+
+	if kinds := trace(t); len(kinds) != 0 {
+		t.Errorf("events %v before patching", kinds)
+	}
+
+	// XRayPatchingStatus SUCCESS is 1.
+	if st := xrayPatch(); st != 1 {
+		t.Fatalf("__go_xray_patch returned %d", st)
+	}
+	kinds := trace(t)
+	if st := xrayUnpatch(); st != 1 {
+		t.Fatalf("__go_xray_unpatch returned %d", st)
+	}
+	if len(kinds) != 2 || kinds[0] != 0 || kinds[1] != 1 {
+		t.Errorf("patched: got events %v, want entry and exit [0 1]", kinds)
+	}
+
+	if kinds := trace(t); len(kinds) != 0 {
+		t.Errorf("events %v after unpatching", kinds)
+	}
+}
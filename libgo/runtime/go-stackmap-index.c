@@ -0,0 +1,240 @@
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Lookup of stack maps via the PC-to-stack-map index the compiler
+// emits in the go_stackmap_index section (see passes/GoStackMap.h
+// for the layout). This lets the stack scanner find the stack map
+// for a frame with a couple of binary searches, instead of decoding
+// the function's LSDA.
+//
+// The index is only emitted with -mllvm -gogc-stackmap-index. Each
+// module (executable or shared library) built that way registers its
+// index at startup; registration just records where the index is. The
+// linker normally lays out the entries in the order of the functions
+// they describe; if it did not, a sorted copy is made on the first
+// lookup in the module.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+struct index_entry {
+	int32_t func;
+	uint32_t framesize;
+	int32_t callsites;
+	uint32_t ncallsites;
+};
+
+struct callsite_entry {
+	uint32_t pcoff;
+	int32_t stackmap;
+};
+
+struct sorted_entry {
+	uintptr_t func;
+	const struct index_entry *entry;
+};
+
+// States of a module's index.
+enum {
+	INDEX_UNCHECKED,	// not yet checked for order
+	INDEX_PREPARING,	// being checked (and sorted) by some thread
+	INDEX_READY,		// usable
+	INDEX_UNUSABLE		// out of order, and no memory to sort it
+};
+
+struct module_index {
+	const struct index_entry *start;
+	const struct index_entry *stop;
+	// Non-NULL if the entries were not in order.
+	struct sorted_entry *sorted;
+	uint32_t state;
+};
+
+#define MAX_MODULES 256
+
+static struct module_index modules[MAX_MODULES];
+static uint32_t nmodules;
+static char registering;
+
+static const void *
+rel(const int32_t *p)
+{
+	return (const char *)p + *p;
+}
+
+static uintptr_t
+entry_func(const struct index_entry *e)
+{
+	return (uintptr_t)rel(&e->func);
+}
+
+static int
+compare_sorted(const void *a, const void *b)
+{
+	uintptr_t fa = ((const struct sorted_entry *)a)->func;
+	uintptr_t fb = ((const struct sorted_entry *)b)->func;
+	return fa < fb ? -1 : fa > fb;
+}
+
+void __go_register_stackmap_index(const void *, const void *)
+  __attribute__((no_split_stack));
+
+void
+__go_register_stackmap_index(const void *start, const void *stop)
+{
+	const struct index_entry *s = start;
+	const struct index_entry *e = stop;
+	uint32_t i, m;
+
+	if (s == NULL || s >= e)
+		return;
+
+	while (__atomic_test_and_set(&registering, __ATOMIC_ACQUIRE))
+		;
+	m = __atomic_load_n(&nmodules, __ATOMIC_RELAXED);
+	for (i = 0; i < m; i++)
+		if (modules[i].start == s)
+			break;
+	if (i == m && m < MAX_MODULES) {
+		modules[m].start = s;
+		modules[m].stop = e;
+		__atomic_store_n(&nmodules, m + 1, __ATOMIC_RELEASE);
+	}
+	__atomic_clear(&registering, __ATOMIC_RELEASE);
+}
+
+// Makes the index of 'mod' ready for lookups, sorting it if needed.
+// Returns 0 if it can't be used (yet): while one thread prepares it,
+// lookups by others skip it and the caller falls back to the LSDA.
+static int
+prepare_index(struct module_index *mod)
+{
+	uint32_t state = __atomic_load_n(&mod->state, __ATOMIC_ACQUIRE);
+	struct sorted_entry *sorted;
+	size_t n, i;
+
+	if (state != INDEX_UNCHECKED)
+		return state == INDEX_READY;
+	if (!__atomic_compare_exchange_n(&mod->state, &state, INDEX_PREPARING,
+					 0, __ATOMIC_ACQUIRE,
+					 __ATOMIC_ACQUIRE))
+		return state == INDEX_READY;
+
+	n = mod->stop - mod->start;
+	for (i = 1; i < n; i++)
+		if (entry_func(&mod->start[i]) < entry_func(&mod->start[i - 1]))
+			break;
+	if (i < n) {
+		sorted = malloc(n * sizeof(struct sorted_entry));
+		if (sorted == NULL) {
+			__atomic_store_n(&mod->state, INDEX_UNUSABLE,
+					 __ATOMIC_RELEASE);
+			return 0;
+		}
+		for (i = 0; i < n; i++) {
+			sorted[i].func = entry_func(&mod->start[i]);
+			sorted[i].entry = &mod->start[i];
+		}
+		qsort(sorted, n, sizeof(struct sorted_entry), compare_sorted);
+		mod->sorted = sorted;
+	}
+	__atomic_store_n(&mod->state, INDEX_READY, __ATOMIC_RELEASE);
+	return 1;
+}
+
+// Returns the index entry of the function in 'mod' that starts
+// closest to, but not after, 'pc'.
+static const struct index_entry *
+find_function(const struct module_index *mod, uintptr_t pc)
+{
+	size_t lo = 0, hi = mod->stop - mod->start;
+
+	if (mod->sorted != NULL) {
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (mod->sorted[mid].func <= pc)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo == 0 ? NULL : mod->sorted[lo - 1].entry;
+	}
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (entry_func(&mod->start[mid]) <= pc)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo == 0 ? NULL : &mod->start[lo - 1];
+}
+
+const void *__go_stackmap_lookup(uintptr_t, uintptr_t *)
+  __attribute__((no_split_stack));
+
+// Returns the stack map for the call whose return address is 'pc',
+// or NULL if the indices have no stack map for it (in which case the
+// caller should fall back to the LSDA). If 'framesize' is not NULL,
+// stores the frame size of the function in it.
+//
+// Only an exact match of a callsite's return address counts, so a
+// PC in a function without an index entry (which the search above
+// attributes to whichever indexed function precedes it) is never
+// mistaken for a callsite.
+const void *
+__go_stackmap_lookup(uintptr_t pc, uintptr_t *framesize)
+{
+	uint32_t m = __atomic_load_n(&nmodules, __ATOMIC_ACQUIRE);
+	uint32_t i;
+
+	for (i = 0; i < m; i++) {
+		const struct index_entry *f;
+		const struct callsite_entry *cs;
+		uintptr_t pcoff;
+		size_t lo, hi;
+
+		if (!prepare_index(&modules[i]))
+			continue;
+		f = find_function(&modules[i], pc);
+		if (f == NULL)
+			continue;
+		pcoff = pc - entry_func(f);
+		if (pcoff > UINT32_MAX)
+			continue;
+		cs = rel(&f->callsites);
+		lo = 0;
+		hi = f->ncallsites;
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (cs[mid].pcoff == pcoff) {
+				if (framesize != NULL)
+					*framesize = f->framesize;
+				return rel(&cs[mid].stackmap);
+			}
+			if (cs[mid].pcoff < pcoff)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+	}
+	return NULL;
+}
+
+// The linker defines these for the module containing this file
+// (libgo, or the executable when linking libgo statically).
+extern const char __start_go_stackmap_index[]
+  __attribute__((weak, visibility("hidden")));
+extern const char __stop_go_stackmap_index[]
+  __attribute__((weak, visibility("hidden")));
+
+static void register_libgo_stackmap_index(void)
+  __attribute__((constructor, no_split_stack));
+
+static void
+register_libgo_stackmap_index(void)
+{
+	__go_register_stackmap_index(__start_go_stackmap_index,
+				     __stop_go_stackmap_index);
+}
@@ -0,0 +1,28 @@
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Registers the PC-to-stack-map index of the module this file is
+// linked into (see go-stackmap-index.c). Lives in libgobegin and
+// libgolibbegin, since the copy in libgo only covers libgo itself
+// when that is a shared library. The driver passes
+// -u __go_stackmap_index_module, when the index is enabled with
+// -mllvm -gogc-stackmap-index, so that this object is linked in.
+
+extern void __go_register_stackmap_index(const void *, const void *);
+
+extern const char __start_go_stackmap_index[]
+  __attribute__((weak, visibility("hidden")));
+extern const char __stop_go_stackmap_index[]
+  __attribute__((weak, visibility("hidden")));
+
+const char __go_stackmap_index_module = 1;
+
+static void register_stackmap_index(void) __attribute__((constructor));
+
+static void
+register_stackmap_index(void)
+{
+	__go_register_stackmap_index(__start_go_stackmap_index,
+				     __stop_go_stackmap_index);
+}
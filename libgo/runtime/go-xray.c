@@ -0,0 +1,142 @@
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Hooks for using XRay from Go. Code compiled with -fxray-instrument
+// has sleds (runs of nops) at function entry and exit; these let Go
+// code install a trace handler and patch the sleds to call it, or
+// unpatch them again. Go code declares the hooks with //extern, e.g.
+//
+//	//extern __go_xray_set_handler
+//	func xraySetHandler(func(id int32, kind int32)) int32
+//
+// The handler is called with the XRay function id and the event kind
+// (0 for function entry, 1 for exit). It is not called recursively,
+// so it may itself be instrumented. It should be a top-level function
+// (a closure must be kept alive by the caller, since the collector
+// can't see the reference held here), and must not block.
+//
+// The handler runs on the goroutine stack of the traced function. The
+// compiler sizes the stack check of instrumented functions to leave
+// room for the XRay trampoline; from there on, xray_handler and the Go
+// handler check and grow the stack like any other split-stack code.
+// This is why the driver does not link XRay's own logging modes, whose
+// handlers are not compiled with split stacks.
+//
+// The XRay runtime is only linked into programs built with
+// -fxray-instrument, so it is referenced weakly here; without it the
+// hooks return -1.
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern int __xray_set_handler(void (*)(int32_t, int))
+  __attribute__((weak));
+extern int __xray_remove_handler(void) __attribute__((weak));
+extern int __xray_patch(void) __attribute__((weak));
+extern int __xray_unpatch(void) __attribute__((weak));
+extern int __xray_patch_function(int32_t) __attribute__((weak));
+extern int __xray_unpatch_function(int32_t) __attribute__((weak));
+extern uintptr_t __xray_function_address(int32_t) __attribute__((weak));
+extern size_t __xray_max_function_id(void) __attribute__((weak));
+
+// A Go func value.
+struct funcval {
+	void (*fn)(int32_t, int32_t);
+};
+
+static const struct funcval *handler;
+static __thread int in_handler;
+
+// Called by the XRay trampolines.
+
+static void
+xray_handler(int32_t id, int kind)
+{
+	const struct funcval *fv;
+
+	fv = __atomic_load_n(&handler, __ATOMIC_ACQUIRE);
+	if (fv == NULL || in_handler)
+		return;
+	in_handler = 1;
+	__builtin_call_with_static_chain(fv->fn(id, kind), fv);
+	in_handler = 0;
+}
+
+// Install 'fv' as the handler. Returns 0 on success.
+
+int32_t
+__go_xray_set_handler(const struct funcval *fv)
+{
+	if (__xray_set_handler == NULL)
+		return -1;
+	__atomic_store_n(&handler, fv, __ATOMIC_RELEASE);
+	return __xray_set_handler(xray_handler) ? 0 : -1;
+}
+
+// Remove the handler (the sleds stay patched). Returns 0 on success.
+
+int32_t
+__go_xray_remove_handler(void)
+{
+	if (__xray_remove_handler == NULL)
+		return -1;
+	__atomic_store_n(&handler, NULL, __ATOMIC_RELEASE);
+	return __xray_remove_handler() ? 0 : -1;
+}
+
+// Patch/unpatch all sleds, or those of one function. These return
+// XRay's XRayPatchingStatus (1 on success), or -1.
+
+int32_t
+__go_xray_patch(void)
+{
+	if (__xray_patch == NULL)
+		return -1;
+	return __xray_patch();
+}
+
+int32_t
+__go_xray_unpatch(void)
+{
+	if (__xray_unpatch == NULL)
+		return -1;
+	return __xray_unpatch();
+}
+
+int32_t
+__go_xray_patch_function(int32_t id)
+{
+	if (__xray_patch_function == NULL)
+		return -1;
+	return __xray_patch_function(id);
+}
+
+int32_t
+__go_xray_unpatch_function(int32_t id)
+{
+	if (__xray_unpatch_function == NULL)
+		return -1;
+	return __xray_unpatch_function(id);
+}
+
+// Returns the address of the function with XRay id 'id' (ids start
+// at 1), for symbolization with runtime.FuncForPC, or 0.
+
+uintptr_t
+__go_xray_function_address(int32_t id)
+{
+	if (__xray_function_address == NULL)
+		return 0;
+	return __xray_function_address(id);
+}
+
+// Returns the largest XRay function id, or 0.
+
+uintptr_t
+__go_xray_max_function_id(void)
+{
+	if (__xray_max_function_id == NULL)
+		return 0;
+	return __xray_max_function_id();
+}
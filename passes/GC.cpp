@@ -14,17 +14,27 @@
 #include "GollvmPasses.h"
 
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Twine.h"
+#include "llvm/BinaryFormat/ELF.h"
 #include "llvm/CodeGen/AsmPrinter.h"
 #include "llvm/CodeGen/GCMetadataPrinter.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/IR/GCStrategy.h"
 #include "llvm/CodeGen/StackMaps.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Module.h"
 #include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCExpr.h"
 #include "llvm/MC/MCObjectFileInfo.h"
+#include "llvm/MC/MCSectionELF.h"
 #include "llvm/MC/MCStreamer.h"
+#include "llvm/MC/MCSymbolELF.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Target/TargetLoweringObjectFile.h"
+#include "llvm/Target/TargetMachine.h"
 #include <vector>
 
 using namespace llvm;
@@ -33,6 +43,11 @@ using namespace llvm;
 // conservative scan of a frame in case of debugging.
 static cl::opt<bool> Padding("gogc-stackmap-pad", cl::Hidden, cl::init(false));
 
+// Emit the PC-to-stack-map index (see GoStackMap.h). Off by default,
+// since the runtime's frame scanner does not use it yet.
+static cl::opt<bool> EmitIndex("gogc-stackmap-index", cl::Hidden,
+                               cl::init(false));
+
 namespace {
 
 class GoGC : public GCStrategy {
@@ -66,16 +81,24 @@ GCMetadataPrinterRegistry::Add<GoGCPrinter>
 static std::vector<uint8_t>
 computeBitVector(uint64_t StackSize,
                  const StackMaps::LocationVec &CSLocs,
-                 uint32_t &Size) {
+                 uint32_t &Size, uint32_t &RegMask) {
   // TODO: this function is silly -- BitVector internally has
   // a bitmap storage, but it is private. We basically recompute
   // it. Can we do better?
 
   const int PtrSize = 8; // TODO: get from target info
   BitVector BV(StackSize / PtrSize);
+  RegMask = 0;
   for (unsigned i = 0, n = CSLocs.size(); i < n; i++) {
     const auto &Loc = CSLocs[i];
     switch (Loc.Type) {
+    case StackMaps::Location::Register:
+      // A pointer in a callee-saved register (see -gogc-ptrs-in-regs).
+      if (Loc.Reg >= 32)
+        report_fatal_error("stack map: pointer in unsupported register " +
+                           Twine(Loc.Reg));
+      RegMask |= 1u << Loc.Reg;
+      break;
     case StackMaps::Location::Direct:
     case StackMaps::Location::Indirect: {
       // TODO: verify that the base register is SP.
@@ -144,15 +167,70 @@ computeBitVector(uint64_t StackSize,
   return Bytes;
 }
 
+// Emits a relative reference to 'Sym' (Sym - .).
 static void
-emitCallsiteEntries(StackMaps &SM, MCStreamer &OS) {
+emitRelativeRef(const MCSymbol *Sym, MCStreamer &OS) {
+  MCContext &OutContext = OS.getContext();
+  MCSymbol *Here = OutContext.createTempSymbol();
+  OS.emitLabel(Here);
+  OS.emitValue(MCBinaryExpr::createSub(
+                   MCSymbolRefExpr::create(Sym, OutContext),
+                   MCSymbolRefExpr::create(Here, OutContext), OutContext),
+               4);
+}
+
+// Returns the section to hold the index entry for the function in
+// 'TextSec', or null if the index can't be emitted.
+static MCSection *
+getIndexSection(const MCSection &TextSec, MCContext &OutContext) {
+  const auto *ElfSec = dyn_cast<MCSectionELF>(&TextSec);
+  if (!ElfSec)
+    return nullptr;
+  unsigned Flags = ELF::SHF_ALLOC | ELF::SHF_LINK_ORDER;
+  StringRef GroupName;
+  if (const MCSymbol *Group = ElfSec->getGroup()) {
+    GroupName = Group->getName();
+    Flags |= ELF::SHF_GROUP;
+  }
+  return OutContext.getELFSection(
+      GO_STACKMAP_INDEX_SECTION, ELF::SHT_PROGBITS, Flags, 0, GroupName,
+      true, ElfSec->getUniqueID(),
+      cast<MCSymbolELF>(TextSec.getBeginSymbol()));
+}
+
+// Maps function symbols to the text sections holding them, for the
+// functions that can be indexed.
+static DenseMap<const MCSymbol *, MCSection *>
+getIndexableFunctions(AsmPrinter &AP) {
+  DenseMap<const MCSymbol *, MCSection *> Result;
+  if (!EmitIndex || !AP.TM.getTargetTriple().isOSBinFormatELF())
+    return Result;
+  // With basic block sections (or function splitting) a function's
+  // callsites are not all at known offsets from its entry.
+  if (AP.TM.getBBSectionsType() == BasicBlockSection::All ||
+      AP.TM.getBBSectionsType() == BasicBlockSection::List ||
+      AP.TM.Options.EnableMachineFunctionSplitter)
+    return Result;
+  const TargetLoweringObjectFile &TLOF = AP.getObjFileLowering();
+  for (const Function &F : *AP.MMI->getModule())
+    if (!F.isDeclaration())
+      Result[AP.getSymbol(&F)] = TLOF.SectionForGlobal(&F, AP.TM);
+  return Result;
+}
+
+static void
+emitCallsiteEntries(StackMaps &SM, AsmPrinter &AP) {
   auto &CSInfos = SM.getCSInfos();
   if (CSInfos.empty())
     return;
 
+  MCStreamer &OS = *AP.OutStreamer;
   MCContext &OutContext = OS.getContext();
+  DenseMap<const MCSymbol *, MCSection *> Indexable =
+      getIndexableFunctions(AP);
   auto CSI = CSInfos.begin();
   for (auto const &FR : SM.getFnInfos()) {
+    auto FirstCSI = CSI;
     for (unsigned i = 0; i < FR.second.RecordCount; i++, CSI++) {
       Twine Name = Twine(GO_STACKMAP_SYM_PREFIX) + Twine((*CSI).ID);
       MCSymbol *Sym = OutContext.getOrCreateSymbol(Name);
@@ -163,14 +241,52 @@ emitCallsiteEntries(StackMaps &SM, MCStreamer &OS) {
 
       // Stack map entry:
       //   uint32_t nbits;
+      //   uint32_t regs;  (if GO_STACKMAP_HAS_REGS)
       //   uint8_t *data;
-      uint32_t Size;
-      std::vector<uint8_t> V =
-          computeBitVector(FR.second.StackSize, (*CSI).Locations, Size);
-      OS.emitIntValue(Size, 4);
+      uint32_t Size, RegMask;
+      std::vector<uint8_t> V = computeBitVector(
+          FR.second.StackSize, (*CSI).Locations, Size, RegMask);
+      if (RegMask) {
+        OS.emitIntValue(Size | GO_STACKMAP_HAS_REGS, 4);
+        OS.emitIntValue(RegMask, 4);
+      } else
+        OS.emitIntValue(Size, 4);
       for (uint8_t Byte : V)
         OS.emitIntValue(Byte, 1);
     }
+
+    MCSection *IndexSec = nullptr;
+    auto It = Indexable.find(FR.first);
+    if (FR.second.RecordCount && It != Indexable.end())
+      IndexSec = getIndexSection(*It->second, OutContext);
+    if (IndexSec) {
+      // Callsite table, in increasing order of PC offset (the order
+      // in which the records were created).
+      //   uint32_t pcoff;
+      //   int32_t  stackmap;
+      OS.emitValueToAlignment(4);
+      MCSymbol *Table = OutContext.createTempSymbol();
+      OS.emitLabel(Table);
+      for (auto C = FirstCSI; C != CSI; C++) {
+        OS.emitValue((*C).CSOffsetExpr, 4);
+        Twine Name = Twine(GO_STACKMAP_SYM_PREFIX) + Twine((*C).ID);
+        emitRelativeRef(OutContext.getOrCreateSymbol(Name), OS);
+      }
+
+      // Index entry.
+      //   int32_t  func;
+      //   uint32_t framesize;
+      //   int32_t  callsites;
+      //   uint32_t ncallsites;
+      OS.PushSection();
+      OS.SwitchSection(IndexSec);
+      OS.emitValueToAlignment(4);
+      emitRelativeRef(FR.first, OS);
+      OS.emitIntValue(FR.second.StackSize, 4);
+      emitRelativeRef(Table, OS);
+      OS.emitIntValue(FR.second.RecordCount, 4);
+      OS.PopSection();
+    }
     OS.emitValueToAlignment(8);
   }
 }
@@ -185,10 +301,12 @@ GoGCPrinter::emitStackMaps(StackMaps &SM, AsmPrinter &AP) {
       OutContext.getObjectFileInfo()->getStackMapSection();
   OS.SwitchSection(StackMapSection);
 
-  emitCallsiteEntries(SM, OS);
+  emitCallsiteEntries(SM, AP);
 
   return true;
 }
 
 void llvm::linkGoGC() {}
 void llvm::linkGoGCPrinter() {}
+
+bool llvm::goStackMapIndexEnabled() { return EmitIndex; }
@@ -0,0 +1,326 @@
+//===--- GoMultiversion.cpp -----------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// LLVM IR pass implementing -fgo-multiversion. Each selected function F
+// is cloned once per requested CPU, with that CPU's features added to
+// the clone's "target-features". F itself becomes an ifunc whose
+// resolver checks the features of the running CPU (via libgcc's
+// __cpu_model on x86_64, via the AT_HWCAP value passed to the resolver
+// on aarch64) and picks the most capable clone, falling back to the
+// original body.
+//
+// Only features the resolver can test are given to a clone, so a clone
+// never uses an instruction that has not been checked for. Only
+// functions that are hot according to the sample profile are selected;
+// without a profile nothing is cloned, since cloning every function
+// that might benefit would multiply the size of the text.
+//
+// This runs before the module optimization pipeline so that each clone
+// is then optimized (and vectorized) for its own features.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GollvmPasses.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalIFunc.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Pass.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "go-multiversion"
+
+STATISTIC(NumVersioned, "Number of functions multiversioned");
+STATISTIC(NumClones, "Number of CPU specific clones created");
+
+static cl::opt<bool> Disabled("disable-go-multiversion",
+                              cl::desc("Disable Go function multiversioning"),
+                              cl::init(false), cl::Hidden);
+
+namespace {
+
+// One CPU to clone for: the features to add to a clone, and the bits
+// that must all be set in the word the resolver tests.
+struct CpuVersion {
+  std::string Cpu;
+  std::string Features;
+  uint64_t Mask;
+};
+
+class GoMultiversion : public ModulePass {
+ public:
+  static char ID;
+
+  GoMultiversion()
+      : ModulePass(ID) {
+    initializeGoMultiversionPass(*PassRegistry::getPassRegistry());
+  }
+
+  GoMultiversion(ArrayRef<std::pair<std::string, std::string>> Cpus)
+      : ModulePass(ID), cpus_(Cpus.begin(), Cpus.end()) {
+    initializeGoMultiversionPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnModule(Module &M) override;
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<ProfileSummaryInfoWrapperPass>();
+  }
+
+ private:
+  std::vector<std::pair<std::string, std::string>> cpus_;
+  std::vector<CpuVersion> versions_;
+  Triple triple_;
+
+  bool computeVersions();
+  bool shouldVersion(Function &F, ProfileSummaryInfo *PSI);
+  Function *buildResolver(Function &F, const std::string &Name,
+                          ArrayRef<Function *> Clones);
+  void versionFunction(Function &F);
+};
+
+}  // namespace
+
+char GoMultiversion::ID = 0;
+INITIALIZE_PASS_BEGIN(GoMultiversion, "go-multiversion",
+                      "Clone hot Go functions per CPU", false, false)
+INITIALIZE_PASS_DEPENDENCY(ProfileSummaryInfoWrapperPass)
+INITIALIZE_PASS_END(GoMultiversion, "go-multiversion",
+                    "Clone hot Go functions per CPU", false, false)
+ModulePass *llvm::createGoMultiversionPass(
+    ArrayRef<std::pair<std::string, std::string>> Cpus) {
+  return new GoMultiversion(Cpus);
+}
+
+// Bits of libgcc's __cpu_model.__cpu_features[0] (the first 32 entries
+// of enum processor_features), keyed by LLVM feature name.
+static const StringMap<unsigned> &x86FeatureBits() {
+  static const StringMap<unsigned> bits = {
+      {"cmov", 0},        {"mmx", 1},         {"popcnt", 2},
+      {"sse", 3},         {"sse2", 4},        {"sse3", 5},
+      {"ssse3", 6},       {"sse4.1", 7},      {"sse4.2", 8},
+      {"avx", 9},         {"avx2", 10},       {"sse4a", 11},
+      {"fma4", 12},       {"xop", 13},        {"fma", 14},
+      {"avx512f", 15},    {"bmi", 16},        {"bmi2", 17},
+      {"aes", 18},        {"pclmul", 19},     {"avx512vl", 20},
+      {"avx512bw", 21},   {"avx512dq", 22},   {"avx512cd", 23},
+      {"avx512er", 24},   {"avx512pf", 25},   {"avx512vbmi", 26},
+      {"avx512ifma", 27}, {"avx5124vnniw", 28}, {"avx5124fmaps", 29},
+      {"avx512vpopcntdq", 30}, {"avx512vbmi2", 31},
+  };
+  return bits;
+}
+
+// AT_HWCAP bits on aarch64 Linux, keyed by LLVM feature name.
+static const StringMap<uint64_t> &aarch64FeatureBits() {
+  static const StringMap<uint64_t> bits = {
+      {"fp-armv8", 1 << 0},  {"neon", 1 << 1},     {"aes", 1 << 3},
+      {"sha2", 1 << 6},      {"crc", 1 << 7},      {"lse", 1 << 8},
+      {"fullfp16", (1 << 9) | (1 << 10)},          {"rdm", 1 << 12},
+      {"rcpc", 1 << 15},     {"sha3", 1 << 17},    {"dotprod", 1 << 20},
+      {"fp16fml", 1 << 23},  {"sve", 1 << 22},
+  };
+  return bits;
+}
+
+// Reduce each requested CPU to the features the resolver can test.
+bool GoMultiversion::computeVersions() {
+  bool isX86 = triple_.getArch() == Triple::x86_64;
+  if (!isX86 && triple_.getArch() != Triple::aarch64)
+    return false;
+
+  for (auto &cpu : cpus_) {
+    SmallVector<StringRef, 32> feats;
+    StringRef(cpu.second).split(feats, ',', -1, false);
+    CpuVersion v = {cpu.first, "", 0};
+    for (StringRef f : feats) {
+      if (!f.consume_front("+"))
+        continue;
+      uint64_t bit = 0;
+      if (isX86) {
+        auto it = x86FeatureBits().find(f);
+        if (it != x86FeatureBits().end())
+          bit = uint64_t(1) << it->second;
+      } else {
+        auto it = aarch64FeatureBits().find(f);
+        if (it != aarch64FeatureBits().end())
+          bit = it->second;
+      }
+      if (!bit)
+        continue;
+      v.Mask |= bit;
+      v.Features += (v.Features.empty() ? "+" : ",+") + f.str();
+    }
+    // Nothing to test means nothing to gain over the default version.
+    if (v.Mask != 0)
+      versions_.push_back(v);
+  }
+
+  // The resolver takes the first match, so try the most capable
+  // versions first.
+  std::stable_sort(versions_.begin(), versions_.end(),
+                   [](const CpuVersion &a, const CpuVersion &b) {
+                     return countPopulation(a.Mask) > countPopulation(b.Mask);
+                   });
+  return !versions_.empty();
+}
+
+bool GoMultiversion::shouldVersion(Function &F, ProfileSummaryInfo *PSI) {
+  if (F.isDeclaration() || F.hasComdat() || F.hasSection())
+    return false;
+  if (!F.hasExternalLinkage() && !F.hasLocalLinkage())
+    return false;
+  if (F.getName().endswith("..import") || F.getName() == "__go_init_main")
+    return false;
+
+  return PSI->isFunctionEntryHot(&F);
+}
+
+// Build "<Name>..mv.resolver", returning a pointer to the clone of F
+// to use, or to F itself.
+Function *GoMultiversion::buildResolver(Function &F, const std::string &Name,
+                                        ArrayRef<Function *> Clones) {
+  Module &M = *F.getParent();
+  LLVMContext &C = M.getContext();
+  bool isX86 = triple_.getArch() == Triple::x86_64;
+  Type *i32Ty = Type::getInt32Ty(C);
+  Type *i64Ty = Type::getInt64Ty(C);
+  PointerType *fnPtrTy = F.getFunctionType()->getPointerTo(
+      F.getAddressSpace());
+
+  // On aarch64 the dynamic linker passes AT_HWCAP as the first argument;
+  // calling getauxval from a resolver is not safe that early.
+  FunctionType *resolverTy =
+      isX86 ? FunctionType::get(fnPtrTy, false)
+            : FunctionType::get(fnPtrTy, {i64Ty}, false);
+  Function *resolver =
+      Function::Create(resolverTy, GlobalValue::InternalLinkage,
+                       Name + "..mv.resolver", &M);
+  resolver->addFnAttr(Attribute::NoUnwind);
+  resolver->addFnAttr("target-cpu", F.getFnAttribute("target-cpu")
+                                        .getValueAsString());
+  resolver->addFnAttr("target-features", F.getFnAttribute("target-features")
+                                             .getValueAsString());
+
+  IRBuilder<> builder(BasicBlock::Create(C, "entry", resolver));
+  Value *word;
+  if (isX86) {
+    // struct __processor_model { u32 vendor, type, subtype; u32 features[1]; }
+    // These come from libgcc_s in a -shared link (the driver passes no
+    // -lgcc there), so they are not dso_local.
+    FunctionCallee init = M.getOrInsertFunction(
+        "__cpu_indicator_init", FunctionType::get(Type::getVoidTy(C), false));
+    builder.CreateCall(init);
+    StructType *modelTy =
+        StructType::get(C, {i32Ty, i32Ty, i32Ty, ArrayType::get(i32Ty, 1)});
+    auto *model = cast<GlobalVariable>(
+        M.getOrInsertGlobal("__cpu_model", modelTy));
+    Value *addr = builder.CreateConstInBoundsGEP2_32(modelTy, model, 0, 3);
+    addr = builder.CreateConstInBoundsGEP2_32(ArrayType::get(i32Ty, 1),
+                                              addr, 0, 0);
+    word = builder.CreateZExt(builder.CreateLoad(i32Ty, addr), i64Ty);
+  } else {
+    word = resolver->getArg(0);
+  }
+
+  for (unsigned i = 0; i < Clones.size(); ++i) {
+    Constant *mask = ConstantInt::get(i64Ty, versions_[i].Mask);
+    Value *match =
+        builder.CreateICmpEQ(builder.CreateAnd(word, mask), mask);
+    BasicBlock *yes = BasicBlock::Create(C, versions_[i].Cpu, resolver);
+    BasicBlock *no = BasicBlock::Create(C, "next", resolver);
+    builder.CreateCondBr(match, yes, no);
+    builder.SetInsertPoint(yes);
+    builder.CreateRet(Clones[i]);
+    builder.SetInsertPoint(no);
+  }
+  builder.CreateRet(&F);
+  return resolver;
+}
+
+void GoMultiversion::versionFunction(Function &F) {
+  std::string name = F.getName().str();
+  GlobalValue::LinkageTypes linkage = F.getLinkage();
+  GlobalValue::VisibilityTypes visibility = F.getVisibility();
+  StringRef baseFeatures =
+      F.getFnAttribute("target-features").getValueAsString();
+
+  SmallVector<Function *, 4> clones;
+  for (const CpuVersion &v : versions_) {
+    ValueToValueMapTy vmap;
+    Function *clone = CloneFunction(&F, vmap);
+    clone->setName(name + "..mv." + v.Cpu);
+    clone->setLinkage(GlobalValue::InternalLinkage);
+    clone->addFnAttr("target-features",
+                     baseFeatures.empty()
+                         ? v.Features
+                         : (baseFeatures + "," + v.Features).str());
+    clone->addFnAttr("tune-cpu", v.Cpu);
+    clones.push_back(clone);
+    NumClones++;
+  }
+
+  // The original body becomes the default version, and its name goes
+  // to an ifunc that every existing reference is redirected to.
+  F.setName(name + "..mv.default");
+  F.setLinkage(GlobalValue::InternalLinkage);
+  F.setVisibility(GlobalValue::DefaultVisibility);
+
+  Function *resolver = buildResolver(F, name, clones);
+  Constant *resolverCast = ConstantExpr::getBitCast(
+      resolver, GlobalIFunc::getResolverFunctionType(F.getFunctionType())
+                    ->getPointerTo());
+  GlobalIFunc *ifunc =
+      GlobalIFunc::create(F.getFunctionType(), F.getAddressSpace(), linkage,
+                          name, resolverCast, F.getParent());
+  ifunc->setVisibility(visibility);
+  F.replaceUsesWithIf(ifunc, [&](Use &U) {
+    auto *I = dyn_cast<Instruction>(U.getUser());
+    return !(I && I->getFunction() == resolver);
+  });
+  NumVersioned++;
+}
+
+bool GoMultiversion::runOnModule(Module &M) {
+  if (Disabled || cpus_.empty())
+    return false;
+  triple_ = Triple(M.getTargetTriple());
+  if (!triple_.isOSBinFormatELF() || !computeVersions())
+    return false;
+
+  ProfileSummaryInfo *PSI =
+      &getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI();
+  if (!PSI->hasProfileSummary())
+    return false;
+
+  SmallVector<Function *, 16> worklist;
+  for (Function &F : M)
+    if (shouldVersion(F, PSI))
+      worklist.push_back(&F);
+  for (Function *F : worklist)
+    versionFunction(*F);
+  return !worklist.empty();
+}
@@ -0,0 +1,321 @@
+//===--- GoNilCheckElim.cpp -----------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// LLVM IR pass to remove Go nil checks that are made redundant by an
+// earlier check of the same pointer, or by an earlier dereference of it
+// that would already have faulted had it been nil.
+//
+// Go functions are marked "null-pointer-is-valid" so that LLVM does not
+// treat a nil dereference as undefined behavior, which also keeps the
+// usual optimizations from using dereferences as non-null facts. This
+// pass uses them anyway, since in Go a dereference of a nil pointer at a
+// small offset never returns: it faults and panics.
+//
+// Pointers are compared after stripping casts and constant-offset GEPs,
+// so a check of p is made redundant by a load of p.f. Non-null facts are
+// also pushed into internal functions: a pointer parameter is marked
+// nonnull when every caller passes a pointer known to be non-nil.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GollvmPasses.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include <memory>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "go-nilcheck-elim"
+
+STATISTIC(NumChecksRemoved, "Number of redundant nil checks removed");
+STATISTIC(NumNonNullParams, "Number of parameters marked nonnull");
+
+static cl::opt<bool> Disabled("disable-go-nilcheck-elim",
+                              cl::desc("Disable Go redundant nil check "
+                                       "elimination"),
+                              cl::init(false), cl::Hidden);
+
+static cl::opt<int64_t> GuardSize("go-nilcheck-elim-guard-size",
+                                  cl::desc("Dereferences at offsets below "
+                                           "this are assumed to fault on a "
+                                           "nil pointer"),
+                                  cl::init(4096), cl::Hidden);
+
+namespace {
+
+// Non-nil facts about the pointers in one function.
+class NilFacts {
+ public:
+  explicit NilFacts(Function &F);
+
+  // Whether Base (as returned by nilCheckBase) is known not to be nil
+  // when At executes.
+  bool isNonNull(Value *Base, Instruction *At) const;
+
+  // Comparisons of a pointer against nil.
+  ArrayRef<ICmpInst *> checks() const { return checks_; }
+
+ private:
+  const DataLayout &DL_;
+  DominatorTree DT_;
+  // Base pointer -> instructions dereferencing it close to offset zero.
+  DenseMap<Value *, SmallVector<Instruction *, 4>> derefs_;
+  // Base pointer -> CFG edges taken only if it is not nil.
+  DenseMap<Value *, SmallVector<BasicBlockEdge, 2>> edges_;
+  SmallVector<ICmpInst *, 16> checks_;
+
+  void addDeref(Value *Ptr, Instruction *I);
+};
+
+class GoNilCheckElim : public ModulePass {
+ public:
+  static char ID;
+
+  GoNilCheckElim() : ModulePass(ID) {
+    initializeGoNilCheckElimPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnModule(Module &M) override;
+
+ private:
+  DenseMap<Function *, std::unique_ptr<NilFacts>> facts_;
+
+  NilFacts &factsFor(Function &F);
+  bool addNonNullParams(Function &F);
+  bool removeRedundantChecks(Function &F);
+};
+
+}  // namespace
+
+char GoNilCheckElim::ID = 0;
+INITIALIZE_PASS(GoNilCheckElim, "go-nilcheck-elim",
+                "Remove redundant Go nil checks", false,
+                false)
+ModulePass *llvm::createGoNilCheckElimPass() { return new GoNilCheckElim(); }
+
+// Strip casts and constant offsets from V, returning the base pointer
+// and setting Offset to the distance of V from it.
+static Value *nilCheckBase(Value *V, const DataLayout &DL, int64_t &Offset) {
+  APInt off(DL.getIndexTypeSizeInBits(V->getType()), 0);
+  Value *base = V->stripAndAccumulateConstantOffsets(DL, off,
+                                                     /*AllowNonInbounds*/ true);
+  if (off.getMinSignedBits() > 64)
+    return nullptr;
+  Offset = off.getSExtValue();
+  return base;
+}
+
+// If I compares a pointer against nil, return the pointer.
+static Value *nilCheckedPointer(ICmpInst *I) {
+  if (!I->isEquality() || !I->getOperand(0)->getType()->isPointerTy())
+    return nullptr;
+  if (isa<ConstantPointerNull>(I->getOperand(1)))
+    return I->getOperand(0);
+  if (isa<ConstantPointerNull>(I->getOperand(0)))
+    return I->getOperand(1);
+  return nullptr;
+}
+
+NilFacts::NilFacts(Function &F)
+    : DL_(F.getParent()->getDataLayout()), DT_(F) {
+  for (Instruction &I : instructions(F)) {
+    if (auto *LI = dyn_cast<LoadInst>(&I))
+      addDeref(LI->getPointerOperand(), &I);
+    else if (auto *SI = dyn_cast<StoreInst>(&I))
+      addDeref(SI->getPointerOperand(), &I);
+    else if (auto *RMW = dyn_cast<AtomicRMWInst>(&I))
+      addDeref(RMW->getPointerOperand(), &I);
+    else if (auto *CX = dyn_cast<AtomicCmpXchgInst>(&I))
+      addDeref(CX->getPointerOperand(), &I);
+    else if (auto *MI = dyn_cast<MemIntrinsic>(&I)) {
+      auto *len = dyn_cast<ConstantInt>(MI->getLength());
+      if (len && !len->isZero()) {
+        addDeref(MI->getRawDest(), &I);
+        if (auto *MT = dyn_cast<MemTransferInst>(MI))
+          addDeref(MT->getRawSource(), &I);
+      }
+    } else if (auto *C = dyn_cast<ICmpInst>(&I)) {
+      if (nilCheckedPointer(C))
+        checks_.push_back(C);
+    }
+  }
+
+  // A conditional branch on a nil comparison makes the pointer non-nil
+  // on one of its edges.
+  for (ICmpInst *C : checks_) {
+    int64_t off;
+    Value *base = nilCheckBase(nilCheckedPointer(C), DL_, off);
+    if (!base || off != 0)
+      continue;
+    for (User *U : C->users()) {
+      auto *BI = dyn_cast<BranchInst>(U);
+      if (!BI || !BI->isConditional() || BI->getCondition() != C ||
+          BI->getSuccessor(0) == BI->getSuccessor(1))
+        continue;
+      unsigned idx = C->getPredicate() == ICmpInst::ICMP_EQ ? 1 : 0;
+      edges_[base].push_back(
+          BasicBlockEdge(BI->getParent(), BI->getSuccessor(idx)));
+    }
+  }
+}
+
+void NilFacts::addDeref(Value *Ptr, Instruction *I) {
+  int64_t off;
+  Value *base = nilCheckBase(Ptr, DL_, off);
+  if (base && !isa<Constant>(base) && off >= 0 && off < GuardSize)
+    derefs_[base].push_back(I);
+}
+
+bool NilFacts::isNonNull(Value *Base, Instruction *At) const {
+  if (isKnownNonZero(Base, DL_, 0, nullptr, At, &DT_))
+    return true;
+  auto dit = derefs_.find(Base);
+  if (dit != derefs_.end())
+    for (Instruction *D : dit->second)
+      if (DT_.dominates(D, At))
+        return true;
+  auto eit = edges_.find(Base);
+  if (eit != edges_.end())
+    for (const BasicBlockEdge &E : eit->second)
+      if (DT_.dominates(E, At->getParent()))
+        return true;
+  return false;
+}
+
+NilFacts &GoNilCheckElim::factsFor(Function &F) {
+  std::unique_ptr<NilFacts> &facts = facts_[&F];
+  if (!facts)
+    facts.reset(new NilFacts(F));
+  return *facts;
+}
+
+// Mark pointer parameters of F nonnull if every caller passes a
+// non-nil pointer. Only done for internal functions whose every use is
+// a direct call, since other callers cannot be seen.
+bool GoNilCheckElim::addNonNullParams(Function &F) {
+  if (F.isDeclaration() || !F.hasLocalLinkage() || F.arg_empty())
+    return false;
+  SmallVector<CallBase *, 8> calls;
+  for (Use &U : F.uses()) {
+    auto *CB = dyn_cast<CallBase>(U.getUser());
+    if (!CB || !CB->isCallee(&U) ||
+        CB->getFunctionType() != F.getFunctionType())
+      return false;
+    calls.push_back(CB);
+  }
+  if (calls.empty())
+    return false;
+
+  bool changed = false;
+  for (Argument &A : F.args()) {
+    if (!A.getType()->isPointerTy() || A.hasNonNullAttr())
+      continue;
+    bool nonNull = true;
+    for (CallBase *CB : calls) {
+      Function *caller = CB->getFunction();
+      const DataLayout &DL = caller->getParent()->getDataLayout();
+      int64_t off;
+      Value *base = nilCheckBase(CB->getArgOperand(A.getArgNo()), DL, off);
+      if (!base || off != 0 || !factsFor(*caller).isNonNull(base, CB)) {
+        nonNull = false;
+        break;
+      }
+    }
+    if (nonNull) {
+      A.addAttr(Attribute::NonNull);
+      NumNonNullParams++;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+bool GoNilCheckElim::removeRedundantChecks(Function &F) {
+  NilFacts &facts = factsFor(F);
+  const DataLayout &DL = F.getParent()->getDataLayout();
+
+  // Decide on all checks against the unmodified function first; each
+  // one is redundant in the original program, so they can then be
+  // folded together.
+  SmallVector<ICmpInst *, 8> redundant;
+  for (ICmpInst *C : facts.checks()) {
+    int64_t off;
+    Value *base = nilCheckBase(nilCheckedPointer(C), DL, off);
+    if (base && off == 0 && facts.isNonNull(base, C))
+      redundant.push_back(C);
+  }
+  if (redundant.empty())
+    return false;
+
+  SmallPtrSet<BasicBlock *, 8> branchBlocks;
+  for (ICmpInst *C : redundant) {
+    for (User *U : C->users())
+      if (auto *BI = dyn_cast<BranchInst>(U))
+        branchBlocks.insert(BI->getParent());
+    bool isEq = C->getPredicate() == ICmpInst::ICMP_EQ;
+    C->replaceAllUsesWith(ConstantInt::get(C->getType(), !isEq));
+    C->eraseFromParent();
+    NumChecksRemoved++;
+  }
+  for (BasicBlock *BB : branchBlocks)
+    ConstantFoldTerminator(BB, /*DeleteDeadConditions*/ true);
+  removeUnreachableBlocks(F);
+
+  // The non-nil successors are now mostly straight-line continuations
+  // of the blocks that held the checks.
+  for (BasicBlock &BB : make_early_inc_range(F))
+    MergeBlockIntoPredecessor(&BB);
+  return true;
+}
+
+bool GoNilCheckElim::runOnModule(Module &M) {
+  if (Disabled)
+    return false;
+
+  // Parameter attributes only depend on the callers' facts, which do not
+  // change, but a new nonnull parameter can make a call further down
+  // the call graph pass a non-nil pointer. Iterate to a fixed point.
+  bool changed = false;
+  for (bool again = true; again;) {
+    again = false;
+    for (Function &F : M)
+      if (addNonNullParams(F))
+        again = changed = true;
+  }
+
+  for (Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    if (removeRedundantChecks(F))
+      changed = true;
+    // The function's CFG may have changed; drop its facts.
+    facts_.erase(&F);
+  }
+
+  facts_.clear();
+  return changed;
+}
@@ -20,6 +20,12 @@
 //
 // With an exception table entry that covers the load/store instruction.
 //
+// The dereference does not have to be in the immediate successor of the
+// check: any block that is entered unconditionally from the non-nil
+// successor (and from nowhere else) is searched as well. A dereference at
+// an offset too large to be sure to hit the guard page is covered by
+// inserting a probe load of the pointer itself in place of the branch.
+//
 //===----------------------------------------------------------------------===//
 
 #include "GollvmPasses.h"
@@ -30,6 +36,7 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/Triple.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/MemoryLocation.h"
 #include "llvm/CodeGen/FaultMaps.h"
@@ -40,6 +47,7 @@
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineMemOperand.h"
 #include "llvm/CodeGen/MachineOperand.h"
+#include "llvm/CodeGen/MachineOptimizationRemarkEmitter.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/PseudoSourceValue.h"
 #include "llvm/CodeGen/TargetInstrInfo.h"
@@ -55,6 +63,7 @@
 #include "llvm/Pass.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Target/TargetMachine.h"
 #include <cassert>
 #include <cstdint>
 #include <iterator>
@@ -66,19 +75,32 @@ static cl::opt<bool> Disabled("disable-go-nil-check",
                               cl::init(false), cl::Hidden);
 
 static cl::opt<int> PageSize("go-nil-check-page-size",
-                             cl::desc("The page size of the target in bytes"),
-                             cl::init(4096), cl::Hidden);
+                             cl::desc("The size in bytes of the region above "
+                                      "address zero that is guaranteed to "
+                                      "fault (0 selects the target default)"),
+                             cl::init(0), cl::Hidden);
 
 static cl::opt<unsigned> MaxInstsToConsider(
     "go-nil-max-insts-to-consider",
     cl::desc("The max number of instructions to consider hoisting loads over "
              "(the algorithm is quadratic over this number)"),
-    cl::Hidden, cl::init(8));
+    cl::Hidden, cl::init(16));
+
+static cl::opt<bool> DisableProbes("disable-go-nil-check-probes",
+                                   cl::desc("Do not use probe loads for "
+                                            "dereferences at large offsets"),
+                                   cl::init(false), cl::Hidden);
 
 #define DEBUG_TYPE "go-nil-checks"
 
 STATISTIC(NumImplicitNullChecks,
           "Number of explicit null checks made implicit");
+STATISTIC(NumExplicitNullChecks,
+          "Number of nil checks that had to stay explicit");
+STATISTIC(NumDominatedNullChecks,
+          "Number of nil checks folded into an access in a later block");
+STATISTIC(NumProbedNullChecks,
+          "Number of nil checks made implicit with a probe load");
 
 namespace {
 
@@ -142,15 +164,19 @@ class GoNilChecks : public MachineFunctionPass {
     // instruction; and it needs to be hoisted to execute before MemOperation.
     MachineInstr *OnlyDependency;
 
+    // If set, MemOperation is a freshly built probe load that is not in
+    // any block yet, rather than an existing instruction to be hoisted.
+    bool Probe;
+
   public:
     explicit NullCheck(MachineInstr *memOperation, MachineInstr *checkOperation,
                        MachineBasicBlock *checkBlock,
                        MachineBasicBlock *notNullSucc,
                        MachineBasicBlock *nullSucc,
-                       MachineInstr *onlyDependency)
+                       MachineInstr *onlyDependency, bool probe = false)
         : MemOperation(memOperation), CheckOperation(checkOperation),
           CheckBlock(checkBlock), NotNullSucc(notNullSucc), NullSucc(nullSucc),
-          OnlyDependency(onlyDependency) {}
+          OnlyDependency(onlyDependency), Probe(probe) {}
 
     MachineInstr *getMemOperation() const { return MemOperation; }
 
@@ -163,18 +189,33 @@ class GoNilChecks : public MachineFunctionPass {
     MachineBasicBlock *getNullSucc() const { return NullSucc; }
 
     MachineInstr *getOnlyDependency() const { return OnlyDependency; }
+
+    bool isProbe() const { return Probe; }
   };
 
   const TargetInstrInfo *TII = nullptr;
   const TargetRegisterInfo *TRI = nullptr;
   AliasAnalysis *AA = nullptr;
   MachineFrameInfo *MFI = nullptr;
+  MachineOptimizationRemarkEmitter *ORE = nullptr;
+
+  /// Accesses at offsets in [0, GuardSize) from a nil pointer are known to
+  /// fault and to be reported by the runtime as nil dereferences.
+  int64_t GuardSize = 0;
 
   bool analyzeBlockForNullChecks(MachineBasicBlock &MBB,
                                  SmallVectorImpl<NullCheck> &NullCheckList);
   void rewriteNullChecks(ArrayRef<NullCheck> NullCheckList);
   void insertLandingPad(MachineInstr *FaultMI, MachineBasicBlock *FaultBB);
 
+  /// Emit a missed-optimization remark for the nil check terminating
+  /// \p MBB and return false.
+  bool keepExplicit(MachineBasicBlock &MBB, const char *Reason);
+
+  /// Build a detached copy of the load \p MI that reads from offset zero
+  /// of \p PointerReg instead, or return null if that cannot be done.
+  MachineInstr *buildProbe(MachineInstr &MI, unsigned PointerReg);
+
   enum AliasResult {
     AR_NoAlias,
     AR_MayAlias,
@@ -189,12 +230,14 @@ class GoNilChecks : public MachineFunctionPass {
 
   enum SuitabilityResult {
     SR_Suitable,
+    SR_NeedsProbe,
     SR_Unsuitable,
     SR_Impossible
   };
 
   /// Return SR_Suitable if \p MI a memory operation that can be used to
-  /// implicitly null check the value in \p PointerReg, SR_Unsuitable if
+  /// implicitly null check the value in \p PointerReg, SR_NeedsProbe if
+  /// \p MI dereferences \p PointerReg beyond the guard page, SR_Unsuitable if
   /// \p MI cannot be used to null check and SR_Impossible if there is
   /// no sense to continue lookup due to any other instruction will not be able
   /// to be used. \p PrevInsts is the set of instruction seen since
@@ -221,6 +264,7 @@ public:
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequired<AAResultsWrapperPass>();
+    AU.addRequired<MachineOptimizationRemarkEmitterPass>();
     MachineFunctionPass::getAnalysisUsage(AU);
   }
 
@@ -297,14 +341,33 @@ bool GoNilChecks::canReorder(const MachineInstr *A,
   return true;
 }
 
+// Return the size of the region starting at address zero in which a
+// load or store is certain to fault and be turned into a nil-pointer
+// panic. The operating system usually leaves more than that unmapped,
+// but libgo's sigpanic only treats faulting addresses below 0x1000 as
+// nil dereferences, so that is the bound everywhere page zero is
+// unmapped. On AIX page zero is readable and nothing is guaranteed.
+static int64_t guardPageSize(const Triple &T) {
+  if (PageSize.getNumOccurrences())
+    return PageSize;
+  if (T.isOSAIX())
+    return 0;
+  return 4096;
+}
+
 bool GoNilChecks::runOnMachineFunction(MachineFunction &MF) {
   if (Disabled)
     return false;
 
+  GuardSize = guardPageSize(MF.getTarget().getTargetTriple());
+  if (GuardSize <= 0)
+    return false;
+
   TII = MF.getSubtarget().getInstrInfo();
   TRI = MF.getRegInfo().getTargetRegisterInfo();
   MFI = &MF.getFrameInfo();
   AA = &getAnalysis<AAResultsWrapperPass>().getAAResults();
+  ORE = &getAnalysis<MachineOptimizationRemarkEmitterPass>().getORE();
 
   SmallVector<NullCheck, 16> NullCheckList;
 
@@ -383,10 +446,18 @@ GoNilChecks::isSuitableMemoryOp(const MachineInstr &MI,
   if (OffsetIsScalable)
     return SR_Unsuitable;
 
+  if (!(MI.mayLoad() || MI.mayStore()) || MI.isPredicable())
+    return SR_Unsuitable;
+
   // We want the mem access to be issued at a sane offset from PointerReg,
   // so that if PointerReg is null then the access reliably page faults.
-  if (!((MI.mayLoad() || MI.mayStore()) && !MI.isPredicable() &&
-        -PageSize < Offset && Offset < PageSize))
+  // Further out, a probe of the pointer itself can take its place; the
+  // access proves the probe is safe for non-nil pointers as long as it
+  // is at a positive offset (the pointer is then the start of the object
+  // or an interior pointer into it).
+  if (Offset >= GuardSize)
+    return DisableProbes ? SR_Unsuitable : SR_NeedsProbe;
+  if (Offset <= -GuardSize)
     return SR_Unsuitable;
 
   // Finally, check whether the current memory access aliases with previous one.
@@ -400,6 +471,25 @@ GoNilChecks::isSuitableMemoryOp(const MachineInstr &MI,
   return SR_Suitable;
 }
 
+// Return true if \p MI is a load that can be executed earlier, and on
+// paths where it originally was not, without faulting or reading a
+// different value.
+static bool isSpeculatableLoad(const MachineInstr &MI,
+                               const MachineFrameInfo *MFI) {
+  if (!MI.mayLoad() || MI.mayStore() || MI.memoperands_empty())
+    return false;
+  for (MachineMemOperand *MMO : MI.memoperands()) {
+    if (MMO->isVolatile() || MMO->isAtomic() || !MMO->isDereferenceable())
+      return false;
+    if (MMO->isInvariant())
+      continue;
+    const PseudoSourceValue *PSV = MMO->getPseudoValue();
+    if (!PSV || !PSV->isConstant(MFI))
+      return false;
+  }
+  return true;
+}
+
 bool GoNilChecks::canHoistInst(MachineInstr *FaultingMI,
                                unsigned PointerReg,
                                ArrayRef<MachineInstr *> InstsSeenSoFar,
@@ -417,13 +507,16 @@ bool GoNilChecks::canHoistInst(MachineInstr *FaultingMI,
   auto DependenceItr = *DepResult.PotentialDependence;
   auto *DependenceMI = *DependenceItr;
 
-  // We don't want to reason about speculating loads.  Note -- at this point
-  // we should have already filtered out all of the other non-speculatable
-  // things, like calls and stores.
+  // We don't want to reason about speculating loads in general, only
+  // about ones that can neither fault nor observe a store they are hoisted
+  // over (constant pool, GOT and other invariant dereferenceable memory).
+  // Note -- at this point we should have already filtered out all of the
+  // other non-speculatable things, like calls and stores.
   // We also do not want to hoist stores because it might change the memory
   // while the FaultingMI may result in faulting.
   assert(canHandle(DependenceMI) && "Should never have reached here!");
-  if (DependenceMI->mayLoadOrStore())
+  if (DependenceMI->mayLoadOrStore() &&
+      !isSpeculatableLoad(*DependenceMI, MFI))
     return false;
 
   for (auto &DependenceMO : DependenceMI->operands()) {
@@ -485,18 +578,18 @@ bool GoNilChecks::analyzeBlockForNullChecks(
   MachineBranchPredicate MBP;
 
   if (TII->analyzeBranchPredicate(MBB, MBP, true))
-    return false;
+    return keepExplicit(MBB, "branch could not be analyzed");
 
   // Is the predicate comparing an integer to zero?
   if (!(MBP.LHS.isReg() && MBP.RHS.isImm() && MBP.RHS.getImm() == 0 &&
         (MBP.Predicate == MachineBranchPredicate::PRED_NE ||
          MBP.Predicate == MachineBranchPredicate::PRED_EQ)))
-    return false;
+    return keepExplicit(MBB, "branch is not a comparison against nil");
 
   // If we cannot erase the test instruction itself, then making the null check
   // implicit does not buy us much.
   if (!MBP.SingleUseCondition)
-    return false;
+    return keepExplicit(MBB, "comparison result has other uses");
 
   MachineBasicBlock *NotNullSucc, *NullSucc;
 
@@ -508,10 +601,10 @@ bool GoNilChecks::analyzeBlockForNullChecks(
     NullSucc = MBP.TrueDest;
   }
 
-  // We handle the simplest case for now.  We can potentially do better by using
-  // the machine dominator tree.
+  // The non-nil successor must only be reachable through the check, so
+  // that everything searched below is dominated by it.
   if (NotNullSucc->pred_size() != 1)
-    return false;
+    return keepExplicit(MBB, "non-nil successor has other predecessors");
 
   // To prevent the invalid transformation of the following code:
   //
@@ -537,7 +630,7 @@ bool GoNilChecks::analyzeBlockForNullChecks(
 
   for (auto I = MBB.rbegin(); MBP.ConditionDef != &*I; ++I)
     if (I->modifiesRegister(PointerReg, TRI))
-      return false;
+      return keepExplicit(MBB, "pointer is redefined after the comparison");
 
   // Starting with a code fragment like:
   //
@@ -592,36 +685,150 @@ bool GoNilChecks::analyzeBlockForNullChecks(
   // the safety of ptr->field can be dependent on some_cond; and, for instance,
   // ptr could be some non-null invalid reference that never gets loaded from
   // because some_cond is always true.
+  //
+  // It does extend to blocks that are entered unconditionally: if the
+  // non-null successor falls through (or jumps) to a block that has no other
+  // predecessor, that block executes whenever the non-null successor does,
+  // and so on down the chain. Such blocks are dominated by the non-null
+  // successor and clause (2) holds for their loads just the same.
 
   SmallVector<MachineInstr *, 8> InstsSeenSoFar;
+  MachineBasicBlock *CurBB = NotNullSucc;
 
-  for (auto &MI : *NotNullSucc) {
-    if (!canHandle(&MI) || InstsSeenSoFar.size() >= MaxInstsToConsider)
-      return false;
+  while (true) {
+    for (auto &MI : *CurBB) {
+      // Debug instructions do not constrain code motion.
+      if (MI.isDebugInstr())
+        continue;
 
-    MachineInstr *Dependence;
-    SuitabilityResult SR = isSuitableMemoryOp(MI, PointerReg, InstsSeenSoFar);
-    if (SR == SR_Impossible)
-      return false;
-    if (SR == SR_Suitable &&
-        canHoistInst(&MI, PointerReg, InstsSeenSoFar, NullSucc, Dependence)) {
-      NullCheckList.emplace_back(&MI, MBP.ConditionDef, &MBB, NotNullSucc,
-                                 NullSucc, Dependence);
-      return true;
+      // Only an unconditional branch lets us continue into the next block.
+      if (MI.isTerminator()) {
+        if (!MI.isUnconditionalBranch())
+          return keepExplicit(MBB, "no suitable dereference found");
+        break;
+      }
+
+      if (!canHandle(&MI))
+        return keepExplicit(MBB, "instruction with side effects before the "
+                                 "first dereference");
+      if (InstsSeenSoFar.size() >= MaxInstsToConsider)
+        return keepExplicit(MBB, "too many instructions before the first "
+                                 "dereference");
+
+      MachineInstr *Dependence;
+      SuitabilityResult SR =
+          isSuitableMemoryOp(MI, PointerReg, InstsSeenSoFar);
+      if (SR == SR_Impossible)
+        return keepExplicit(MBB, "dereference may alias an earlier store");
+      if (SR == SR_Suitable &&
+          canHoistInst(&MI, PointerReg, InstsSeenSoFar, NullSucc, Dependence)) {
+        NullCheckList.emplace_back(&MI, MBP.ConditionDef, &MBB, NotNullSucc,
+                                   NullSucc, Dependence);
+        if (CurBB != NotNullSucc)
+          NumDominatedNullChecks++;
+        return true;
+      }
+      if (SR == SR_NeedsProbe) {
+        if (MachineInstr *Probe = buildProbe(MI, PointerReg)) {
+          if (canHoistInst(Probe, PointerReg, InstsSeenSoFar, NullSucc,
+                           Dependence)) {
+            NullCheckList.emplace_back(Probe, MBP.ConditionDef, &MBB,
+                                       NotNullSucc, NullSucc, Dependence,
+                                       /*probe=*/true);
+            NumProbedNullChecks++;
+            return true;
+          }
+          MBB.getParent()->deleteMachineInstr(Probe);
+        }
+      }
+
+      // If MI re-defines the PointerReg then we cannot move further.
+      if (llvm::any_of(MI.operands(), [&](MachineOperand &MO) {
+            return MO.isReg() && MO.getReg() && MO.isDef() &&
+                   TRI->regsOverlap(MO.getReg(), PointerReg);
+          }))
+        return keepExplicit(MBB, "pointer is redefined before use");
+      InstsSeenSoFar.push_back(&MI);
     }
 
-    // If MI re-defines the PointerReg then we cannot move further.
-    if (llvm::any_of(MI.operands(), [&](MachineOperand &MO) {
-          return MO.isReg() && MO.getReg() && MO.isDef() &&
-                 TRI->regsOverlap(MO.getReg(), PointerReg);
-        }))
-      return false;
-    InstsSeenSoFar.push_back(&MI);
+    if (CurBB->succ_size() != 1)
+      break;
+    MachineBasicBlock *Next = *CurBB->succ_begin();
+    if (Next == &MBB || Next->pred_size() != 1 || Next->isEHPad() ||
+        Next->hasAddressTaken())
+      break;
+    CurBB = Next;
   }
 
+  return keepExplicit(MBB, "no suitable dereference found");
+}
+
+bool GoNilChecks::keepExplicit(MachineBasicBlock &MBB, const char *Reason) {
+  NumExplicitNullChecks++;
+  ORE->emit([&]() {
+    return MachineOptimizationRemarkMissed(DEBUG_TYPE, "ExplicitNilCheck",
+                                           MBB.findBranchDebugLoc(), &MBB)
+           << "nil check kept explicit: " << Reason;
+  });
   return false;
 }
 
+MachineInstr *GoNilChecks::buildProbe(MachineInstr &MI, unsigned PointerReg) {
+  // The probe executes in addition to MI, so it must be a plain load
+  // whose results are overwritten by MI without being read by it.
+  if (!MI.mayLoad() || MI.mayStore() || MI.getNumMemOperands() > 1)
+    return nullptr;
+  for (const MachineOperand &MO : MI.operands())
+    if (MO.isReg() && MO.isDef() && MO.getReg() &&
+        MI.readsRegister(MO.getReg(), TRI))
+      return nullptr;
+
+  // There is no target independent way to build a load, so rewrite the
+  // displacement of a copy of MI and let the target confirm that the
+  // result addresses offset zero from the pointer.
+  MachineFunction &MF = *MI.getMF();
+  MachineInstr *Probe = MF.CloneMachineInstr(&MI);
+  for (MachineOperand &MO : Probe->explicit_uses()) {
+    if (!MO.isImm() || MO.getImm() == 0)
+      continue;
+    int64_t Saved = MO.getImm();
+    MO.setImm(0);
+
+    int64_t Offset;
+    const MachineOperand *BaseOp;
+    bool OffsetIsScalable;
+    if (TII->getMemOperandWithOffset(*Probe, BaseOp, Offset, OffsetIsScalable,
+                                     TRI) &&
+        BaseOp->isReg() && BaseOp->getReg() == PointerReg && Offset == 0 &&
+        !OffsetIsScalable) {
+      // Its results are dead and it must not end any live ranges early.
+      Probe->dropMemRefs(MF);
+      Probe->clearKillInfo();
+      for (MachineOperand &Def : Probe->defs())
+        Def.setIsDead();
+      return Probe;
+    }
+    MO.setImm(Saved);
+  }
+  MF.deleteMachineInstr(Probe);
+  return nullptr;
+}
+
+// Record the registers defined by \p MI as live into every block from
+// \p From down to \p To, which \p MI has been hoisted out of.
+static void addLiveIns(const MachineInstr &MI, MachineBasicBlock *From,
+                       MachineBasicBlock *To) {
+  for (MachineBasicBlock *BB = From;; BB = *BB->succ_begin()) {
+    for (const MachineOperand &MO : MI.operands())
+      if (MO.isReg() && MO.isDef() && MO.getReg() && !MO.isDead() &&
+          !BB->isLiveIn(MO.getReg()))
+        BB->addLiveIn(MO.getReg());
+    if (BB == To)
+      break;
+    assert(BB->succ_size() == 1 && "not a chain of blocks");
+  }
+}
+
 /// Rewrite the null checks in NullCheckList into implicit null checks.
 void
 GoNilChecks::rewriteNullChecks(
@@ -637,6 +844,7 @@ GoNilChecks::rewriteNullChecks(
     MachineBasicBlock* CheckBB = NC.getCheckBlock();
 
     if (auto *DepMI = NC.getOnlyDependency()) {
+      addLiveIns(*DepMI, NC.getNotNullSucc(), DepMI->getParent());
       DepMI->removeFromParent();
       CheckBB->insert(CheckBB->end(), DepMI);
     }
@@ -645,8 +853,13 @@ GoNilChecks::rewriteNullChecks(
     // originally. We check earlier ensures that this bit of code motion
     // is legal.  We do not touch the successors list for any basic block
     // since we haven't changed control flow, we've just made it implicit.
+    // A probe's results are dead; the access it stands in for still
+    // produces them.
     MachineInstr *FaultMI = NC.getMemOperation();
-    FaultMI->removeFromParent();
+    if (!NC.isProbe()) {
+      addLiveIns(*FaultMI, NC.getNotNullSucc(), FaultMI->getParent());
+      FaultMI->removeFromParent();
+    }
     CheckBB->insert(CheckBB->end(), FaultMI);
 
     NC.getCheckOperation()->eraseFromParent();
@@ -657,6 +870,12 @@ GoNilChecks::rewriteNullChecks(
                         /*Cond=*/None, DL);
 
     NumImplicitNullChecks++;
+    ORE->emit([&]() {
+      return MachineOptimizationRemark(DEBUG_TYPE, "ImplicitNilCheck",
+                                       FaultMI->getDebugLoc(), CheckBB)
+             << (NC.isProbe() ? "nil check replaced by a probe load"
+                              : "nil check folded into a memory access");
+    });
 
     if (!FaultMI->getMF()->getLandingPads().empty())
       insertLandingPad(FaultMI, NC.getNullSucc());
@@ -744,6 +963,7 @@ char GoNilChecks::ID = 0;
 INITIALIZE_PASS_BEGIN(GoNilChecks, DEBUG_TYPE,
                       "Make nil checks implicit", false, false)
 INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(MachineOptimizationRemarkEmitterPass)
 INITIALIZE_PASS_END(GoNilChecks, DEBUG_TYPE,
                     "Make nil checks implicit", false, false)
 
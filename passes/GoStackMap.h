@@ -14,6 +14,17 @@
 #define GO_FUNC_SYM            "go..func"
 #define GO_STACKMAP_SYM_PREFIX "go..stackmap."
 
+// Set in the nbits field of a stack map entry if some of the live
+// pointers are held in callee-saved registers. The entry is then
+//
+//   uint32_t nbits;       // with GO_STACKMAP_HAS_REGS set
+//   uint32_t regs;        // DWARF numbers of the registers
+//   uint8_t  data[];      // stack slot bitmap
+//
+// rather than just nbits and data. The runtime recovers the register
+// contents as of the frame from the unwinder (_Unwind_GetGR).
+#define GO_STACKMAP_HAS_REGS 0x80000000u
+
 // A sentinel value that will be inserted to the exception table
 // to indicate this is a Go function. The value is known to the
 // runtime.
@@ -22,4 +33,27 @@
                           ((uint64_t)'F'<<32) | ((uint64_t)'U'<<40) | \
                           ((uint64_t)'N'<<48) | ((uint64_t)'C'<<56))
 
+// PC-to-stack-map index, which lets the runtime find the stack map
+// for a return PC without going through the exception tables. Each
+// function with stack maps gets an entry
+//
+//   int32_t  func;        // function entry, relative to this field
+//   uint32_t framesize;   // frame size in bytes
+//   int32_t  callsites;   // callsite table, relative to this field
+//   uint32_t ncallsites;
+//
+// in a section of this name tied to the function's text section
+// (SHF_LINK_ORDER), so that the linker keeps or discards the entry
+// along with the function and lays entries out in the order of the
+// functions themselves. The callsite table (in the stack map section)
+// holds, in increasing order of offset,
+//
+//   uint32_t pcoff;       // return PC, relative to function entry
+//   int32_t  stackmap;    // GO_STACKMAP_SYM_PREFIX<ID>, relative
+//                         // to this field
+//
+// The section name is a C identifier, so that the runtime can locate
+// the index via the __start_/__stop_ symbols the linker defines.
+#define GO_STACKMAP_INDEX_SECTION "go_stackmap_index"
+
 #endif
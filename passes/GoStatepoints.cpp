@@ -21,12 +21,14 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/None.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Analysis/DomTreeUpdater.h"
@@ -85,6 +87,14 @@
 using namespace llvm;
 using namespace gollvm::passes;
 
+STATISTIC(NumStatepoints, "Number of statepoints inserted");
+STATISTIC(NumGCLeafCalls, "Number of calls to GC leaf functions");
+STATISTIC(NumInferredGCLeaf, "Number of functions inferred to be GC leaves");
+STATISTIC(NumSlotsZeroed, "Number of ambiguously live slots zeroed");
+STATISTIC(NumSlotsNotZeroed,
+          "Number of slots not zeroed as they are in no stack map");
+STATISTIC(NumZeroingSunk, "Number of slot zeroings moved out of the entry block");
+
 // Print the liveset found at the insert location
 static cl::opt<bool> PrintLiveSet("gogc-print-liveset", cl::Hidden,
                                   cl::init(false));
@@ -98,6 +108,28 @@ static cl::opt<std::string> PrintFunc("gogc-print-func", cl::Hidden,
 static cl::opt<bool> ClobberNonLive("gogc-clobber-non-live",
                                     cl::Hidden, cl::init(false));
 
+// Mark functions that cannot reach a safepoint as GC leaves, so
+// that calls to them are not statepoints.
+static cl::opt<bool> InferGCLeaf("gogc-infer-leaf", cl::Hidden,
+                                 cl::init(true));
+
+// Let the register allocator keep pointers that are live across a
+// statepoint in callee-saved registers, instead of always spilling
+// them to the stack. Needs a runtime that understands register
+// locations in stack maps (GO_STACKMAP_HAS_REGS). Values in caller-
+// saved registers are still spilled at the call (by the
+// FixupStatepointCallerSaved pass).
+static cl::opt<bool> PtrsInRegs(
+    "gogc-ptrs-in-regs", cl::Hidden, cl::init(false),
+    cl::callback([](const bool &Val) {
+      // Statepoint lowering spills all pointer typed operands, and
+      // keeps others in registers only if asked to.
+      auto &Opts = cl::getRegisteredOptions();
+      auto It = Opts.find("use-registers-for-deopt-values");
+      if (It != Opts.end())
+        It->second->addOccurrence(0, It->first(), Val ? "true" : "false");
+    }));
+
 // Statepoint ID. TODO: this is not thread safe.
 static uint64_t ID = 0;
 
@@ -120,6 +152,9 @@ static void stripNonValidData(Module &M);
 
 static bool shouldRewriteStatepointsIn(Function &F);
 
+static void inferGCLeafFunctions(
+    Module &M, function_ref<const TargetLibraryInfo &(Function &)> GetTLI);
+
 PreservedAnalyses GoStatepoints::run(Module &M,
                                      ModuleAnalysisManager &AM) {
   // Create a sentinel global variable for stack maps.
@@ -129,8 +164,12 @@ PreservedAnalyses GoStatepoints::run(Module &M,
                      ConstantInt::get(Int64Ty, GO_FUNC_SENTINEL),
                      GO_FUNC_SYM);
 
-  bool Changed = false;
   auto &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  inferGCLeafFunctions(M, [&FAM](Function &F) -> const TargetLibraryInfo & {
+    return FAM.getResult<TargetLibraryAnalysis>(F);
+  });
+
+  bool Changed = false;
   for (Function &F : M) {
     // Nothing to do for declarations.
     if (F.isDeclaration() || F.empty())
@@ -181,6 +220,10 @@ public:
                        ConstantInt::get(Int64Ty, GO_FUNC_SENTINEL),
                        GO_FUNC_SYM);
 
+    inferGCLeafFunctions(M, [this](Function &F) -> const TargetLibraryInfo & {
+      return getAnalysis<TargetLibraryInfoWrapperPass>().getTLI(F);
+    });
+
     bool Changed = false;
     for (Function &F : M) {
       // Nothing to do for declarations.
@@ -1444,6 +1487,15 @@ makeStatepointExplicitImpl(CallBase *Call, /* to replace */
       PtrFields.push_back(V);
   }
 
+  // To keep a pointer in a register, pass it as an integer (see
+  // PtrsInRegs). Stack slots and bitmap constants stay as they are.
+  if (PtrsInRegs)
+    for (Value *&V : PtrFields)
+      if (V->getType()->isPointerTy() && !isa<Constant>(V) &&
+          !isa<AllocaInst>(V) &&
+          !(isa<Argument>(V) && cast<Argument>(V)->hasByValAttr()))
+        V = Builder.CreatePtrToInt(V, DL.getIntPtrType(V->getType()));
+
   ArrayRef<Value *> GCArgs(PtrFields);
   uint64_t StatepointID = ID;
   ID++;
@@ -1669,15 +1721,69 @@ phiContainsAlloca(Value *V, SetVector<Value *> &ToZero,
   return false;
 }
 
+// Insert zeroing of slot V at the builder's insertion point. An
+// aggregate is cleared with a single memset, as storing a zero
+// aggregate is lowered to a store per element.
+static void
+emitSlotZeroing(IRBuilder<> &Builder, Value *V, const DataLayout &DL) {
+  Type *ElemTyp = V->getType()->getPointerElementType();
+  uint64_t Size = DL.getTypeStoreSize(ElemTyp);
+  if (ElemTyp->isAggregateType() && Size > DL.getPointerSize()) {
+    MaybeAlign Align;
+    if (auto *AI = dyn_cast<AllocaInst>(V))
+      Align = AI->getAlign();
+    Builder.CreateMemSet(V, Builder.getInt8(0), Size, Align);
+  } else
+    Builder.CreateStore(Constant::getNullValue(ElemTyp), V);
+  ++NumSlotsZeroed;
+}
+
+// Returns the place to zero the entry block slot AI: the start of the
+// nearest common dominator of its uses, so that the zeroing is off
+// the entry path if the slot is only used on some (e.g. cold) path.
+// That block must not be in a cycle, where the zeroing could clobber
+// a value stored in an earlier iteration; if it is, we move up the
+// dominator tree. Returns null if the zeroing should stay right after
+// the alloca.
+static Instruction *
+findZeroingPoint(AllocaInst *AI, DominatorTree &DT,
+                 const SmallPtrSetImpl<BasicBlock *> &CyclicBlocks) {
+  BasicBlock *Entry = AI->getParent();
+  BasicBlock *BB = nullptr;
+  for (Use &U : AI->uses()) {
+    Instruction *User = cast<Instruction>(U.getUser());
+    BasicBlock *UseBB = User->getParent();
+    if (auto *Phi = dyn_cast<PHINode>(User))
+      UseBB = Phi->getIncomingBlock(U);
+    BB = BB ? DT.findNearestCommonDominator(BB, UseBB) : UseBB;
+    if (BB == Entry)
+      return nullptr;
+  }
+  while (BB && BB != Entry && CyclicBlocks.count(BB))
+    BB = DT.getNode(BB)->getIDom()->getBlock();
+  if (!BB || BB == Entry)
+    return nullptr;
+  return &*BB->getFirstInsertionPt();
+}
+
 // Zero ambigously lived stack slots. We insert zeroing at lifetime
 // start (or the entry block), so the GC won't see uninitialized
 // content. We also insert zeroing at kill sites, to ensure the GC
 // won't see a dead slot come back to life.
 // We also conservatively extend the lifetime of address-taken slots,
 // to prevent the slot being reused while it is still recorded live.
+// None of this is needed for slots that are not in any stack map
+// (InStackMap), which the GC never looks at.
 static void
 zeroAmbiguouslyLiveSlots(Function &F, SetVector<Value *> &ToZero,
-                         SetVector<Value *> &AddrTakenAllocas) {
+                         SetVector<Value *> &AddrTakenAllocas,
+                         const SmallPtrSetImpl<Value *> &InStackMap) {
+  unsigned NumToZero = ToZero.size();
+  ToZero.remove_if([&](Value *V) { return !InStackMap.count(V); });
+  NumSlotsNotZeroed += NumToZero - ToZero.size();
+  if (ToZero.empty())
+    return;
+
   SmallVector<Instruction *, 16> InstToDelete;
   SetVector<Value *> Done;
   const DataLayout &DL = F.getParent()->getDataLayout();
@@ -1702,8 +1808,7 @@ zeroAmbiguouslyLiveSlots(Function &F, SetVector<Value *> &ToZero,
           } else if (ToZero.count(V) != 0) {
             // Non-addrtaken alloca. Just insert zeroing, keep the lifetime marker.
             IRBuilder<> Builder(I.getNextNode());
-            Value *Zero = Constant::getNullValue(V->getType()->getPointerElementType());
-            Builder.CreateStore(Zero, V);
+            emitSlotZeroing(Builder, V, DL);
             // Don't remove V from ToZero for now, as there may be multiple
             // lifetime start markers, where we need to insert zeroing.
             Done.insert(V);
@@ -1733,21 +1838,33 @@ zeroAmbiguouslyLiveSlots(Function &F, SetVector<Value *> &ToZero,
   if (ToZero.empty())
     return;
 
-  // Otherwise, place the zeroing in the entry block after the alloca.
+  // Otherwise, place the zeroing in the entry block after the alloca,
+  // or further down if possible (see findZeroingPoint).
+  DominatorTree DT(F);
+  SmallPtrSet<BasicBlock *, 16> CyclicBlocks;
+  for (scc_iterator<Function *> It = scc_begin(&F); !It.isAtEnd(); ++It)
+    if (It.hasCycle())
+      CyclicBlocks.insert(It->begin(), It->end());
+  SmallVector<AllocaInst *, 16> EntrySlots;
   for (Instruction &I : F.getEntryBlock())
-    if (ToZero.count(&I) != 0) {
-      IRBuilder<> Builder(I.getNextNode());
-      Type *ElemTyp = I.getType()->getPointerElementType();
-      if (AddrTakenAllocas.count(&I) != 0) {
-        // For addrtaken alloca, we removed the lifetime marker above.
-        // Insert a new one at the entry block.
-        unsigned Size = DL.getTypeStoreSize(ElemTyp);
-        Builder.CreateLifetimeStart(&I, ConstantInt::get(Int64Ty, Size));
-      }
-      Value *Zero = Constant::getNullValue(ElemTyp);
-      Builder.CreateStore(Zero, &I);
-      ToZero.remove(&I);
+    if (ToZero.count(&I) != 0)
+      EntrySlots.push_back(cast<AllocaInst>(&I));
+  for (AllocaInst *AI : EntrySlots) {
+    Instruction *InsertPt = findZeroingPoint(AI, DT, CyclicBlocks);
+    if (InsertPt)
+      ++NumZeroingSunk;
+    else
+      InsertPt = AI->getNextNode();
+    IRBuilder<> Builder(InsertPt);
+    if (AddrTakenAllocas.count(AI) != 0) {
+      // For addrtaken alloca, we removed the lifetime marker above.
+      // Insert a new one where we zero it.
+      unsigned Size = DL.getTypeStoreSize(AI->getAllocatedType());
+      Builder.CreateLifetimeStart(AI, ConstantInt::get(Int64Ty, Size));
     }
+    emitSlotZeroing(Builder, AI, DL);
+    ToZero.remove(AI);
+  }
 
   assert(ToZero.empty());
 }
@@ -1971,7 +2088,15 @@ static bool insertParsePoints(Function &F, DominatorTree &DT,
            "must be a gc pointer type");
 #endif
 
-  zeroAmbiguouslyLiveSlots(F, ToZero, AddrTakenAllocas);
+  // The values recorded in the stack maps (which are the deopt
+  // operands, see makeStatepointExplicitImpl).
+  SmallPtrSet<Value *, 32> InStackMap;
+  for (auto &Info : Records)
+    if (auto Bundle =
+            Info.StatepointToken->getOperandBundle(LLVMContext::OB_deopt))
+      for (const Use &U : Bundle->Inputs)
+        InStackMap.insert(U.get());
+  zeroAmbiguouslyLiveSlots(F, ToZero, AddrTakenAllocas, InStackMap);
 
   // In clobber-non-live mode, delete all lifetime markers, as the
   // inserted clobbering may be beyond the original lifetime.
@@ -2111,6 +2236,37 @@ static bool shouldRewriteStatepointsIn(Function &F) {
   return F.hasGC();
 }
 
+// Marks the Go functions defined in this module whose only calls are
+// to GC leaf functions as GC leaves themselves: no GC can happen while
+// such a function runs, so its callers need not describe their frames
+// at the call. Iterates to a fixed point, so that chains of such
+// functions are found (but recursive ones are not). Functions whose
+// definition may be replaced at link time are left alone.
+static void inferGCLeafFunctions(
+    Module &M, function_ref<const TargetLibraryInfo &(Function &)> GetTLI) {
+  if (!InferGCLeaf)
+    return;
+  bool Changed;
+  do {
+    Changed = false;
+    for (Function &F : M) {
+      if (F.isDeclaration() || F.empty() || !shouldRewriteStatepointsIn(F) ||
+          !F.isDefinitionExact() || F.hasFnAttribute("gc-leaf-function"))
+        continue;
+      const TargetLibraryInfo &TLI = GetTLI(F);
+      bool IsLeaf = llvm::all_of(instructions(F), [&](Instruction &I) {
+        const auto *Call = dyn_cast<CallBase>(&I);
+        return !Call || callsGCLeafFunction(Call, TLI);
+      });
+      if (IsLeaf) {
+        F.addFnAttr("gc-leaf-function");
+        ++NumInferredGCLeaf;
+        Changed = true;
+      }
+    }
+  } while (Changed);
+}
+
 static void stripNonValidData(Module &M) {
 #ifndef NDEBUG
   assert(llvm::any_of(M, shouldRewriteStatepointsIn) && "precondition!");
@@ -2194,6 +2350,9 @@ bool GoStatepoints::runOnFunction(Function &F, DominatorTree &DT,
   // when rewriting.  We'll delete the unreachable ones in a moment.
   SmallVector<CallBase *, 64> ParsePointNeeded;
   for (Instruction &I : instructions(F)) {
+    if (const auto *Call = dyn_cast<CallBase>(&I))
+      if (Call->hasFnAttr("gc-leaf-function"))
+        ++NumGCLeafCalls;
     // TODO: only the ones with the flag set!
     if (NeedsRewrite(I)) {
       // NOTE removeUnreachableBlocks() is stronger than
@@ -2209,6 +2368,7 @@ bool GoStatepoints::runOnFunction(Function &F, DominatorTree &DT,
   // Return early if no work to do.
   if (ParsePointNeeded.empty())
     return MadeChange;
+  NumStatepoints += ParsePointNeeded.size();
 
   // As a prepass, go ahead and aggressively destroy single entry phi nodes.
   // These are created by LCSSA.  They have the effect of increasing the size
@@ -0,0 +1,475 @@
+//===--- GoStringSwitch.cpp -----------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// LLVM IR pass to speed up long chains of comparisons of a string
+// against constant strings, as produced for Go switch statements
+// of the form
+//
+//   switch s { case "GET": ... case "POST": ... ... }
+//
+// The front end lowers such a switch into a linear chain of tests,
+// each a length compare followed by a call to runtime.memequal.
+// This pass rewrites the chain into a switch on the length, then
+// (for lengths shared by several cases) a switch on a word loaded
+// from the bytes that best tell the cases apart, leaving a single
+// memequal call to confirm the match.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GollvmPasses.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PatternMatch.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Pass.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include <set>
+#include <string>
+
+using namespace llvm;
+using namespace llvm::PatternMatch;
+
+static cl::opt<bool> Disabled("disable-go-string-switch",
+                              cl::desc("Disable Go string switch pass"),
+                              cl::init(false), cl::Hidden);
+
+static cl::opt<unsigned> MinCases(
+    "go-string-switch-min-cases",
+    cl::desc("Minimum number of constant string compares in a chain "
+             "before it is rewritten into a switch"),
+    cl::init(4), cl::Hidden);
+
+#define DEBUG_TYPE "go-string-switch"
+
+STATISTIC(NumChains, "Number of string compare chains rewritten");
+STATISTIC(NumCases, "Number of string compares in rewritten chains");
+
+namespace {
+
+// One "case" of a compare chain. Test is the block doing the length
+// compare, Confirm the block calling memequal, Dest the block reached
+// when the strings are equal.
+struct StrCase {
+  BasicBlock *Test;
+  BasicBlock *Confirm;
+  BasicBlock *Dest;
+  BranchInst *ConfirmBr;
+  unsigned FailIdx; // successor index of ConfirmBr taken on mismatch
+  std::string Str;
+};
+
+class GoStringSwitch : public FunctionPass {
+ public:
+  static char ID;
+
+  GoStringSwitch() : FunctionPass(ID) {
+    initializeGoStringSwitchPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnFunction(Function &F) override;
+
+ private:
+  // The string (pointer, length) the current chain tests.
+  Value *Ptr;
+  Value *Len;
+
+  bool matchLengthTest(BasicBlock *BB, uint64_t &Size, BasicBlock *&EqBB,
+                       BasicBlock *&NeBB);
+  bool matchConfirm(BasicBlock *BB, uint64_t Size, StrCase &C,
+                    BasicBlock *&NeBB);
+  bool collectChain(BasicBlock *Head, SmallVectorImpl<StrCase> &Cases,
+                    BasicBlock *&Default);
+  void rewriteChain(Function &F, SmallVectorImpl<StrCase> &Cases,
+                    BasicBlock *Default);
+};
+
+}  // namespace
+
+char GoStringSwitch::ID = 0;
+INITIALIZE_PASS(GoStringSwitch, "go-string-switch",
+                "Dispatch chains of Go string compares by length and content",
+                false, false)
+FunctionPass *llvm::createGoStringSwitchPass() { return new GoStringSwitch(); }
+
+// Match a block ending in
+//
+//   %c = icmp eq i64 %len, <Size>
+//   br i1 %c, label %EqBB, label %NeBB
+//
+// (or the icmp ne form with successors swapped). If Len is already
+// set, %len must be the same value.
+bool
+GoStringSwitch::matchLengthTest(BasicBlock *BB, uint64_t &Size,
+                                BasicBlock *&EqBB, BasicBlock *&NeBB) {
+  auto *BI = dyn_cast<BranchInst>(BB->getTerminator());
+  if (!BI || !BI->isConditional())
+    return false;
+  ICmpInst::Predicate Pred;
+  Value *L;
+  ConstantInt *C;
+  if (!match(BI->getCondition(),
+             m_OneUse(m_ICmp(Pred, m_Value(L), m_ConstantInt(C)))))
+    return false;
+  if (Pred != ICmpInst::ICMP_EQ && Pred != ICmpInst::ICMP_NE)
+    return false;
+  if (Len && L != Len)
+    return false;
+  Size = C->getZExtValue();
+  EqBB = BI->getSuccessor(Pred == ICmpInst::ICMP_EQ ? 0 : 1);
+  NeBB = BI->getSuccessor(Pred == ICmpInst::ICMP_EQ ? 1 : 0);
+  if (!Len)
+    Len = L;
+  return true;
+}
+
+// Match a block comparing the string against a constant of length
+// Size and branching on the result, e.g.
+//
+//   %r = call i8 @runtime.memequal(i8* nest undef, i8* %p, i8* @str, i64 %len)
+//   %t = trunc i8 %r to i1
+//   br i1 %t, label %Dest, label %NeBB
+//
+// memcmp/bcmp results compared against zero are accepted as well.
+bool
+GoStringSwitch::matchConfirm(BasicBlock *BB, uint64_t Size, StrCase &C,
+                             BasicBlock *&NeBB) {
+  if (!BB->getSinglePredecessor() || isa<PHINode>(BB->front()))
+    return false;
+  auto *BI = dyn_cast<BranchInst>(BB->getTerminator());
+  if (!BI || !BI->isConditional())
+    return false;
+
+  // Peel the test of the call result down to the call itself,
+  // tracking whether a true condition means "equal".
+  bool TrueIsEq = true;
+  Value *V = BI->getCondition();
+  ICmpInst::Predicate Pred;
+  Value *X;
+  for (;;) {
+    if (match(V, m_Trunc(m_Value(X))) || match(V, m_ZExt(m_Value(X)))) {
+      V = X;
+    } else if (match(V, m_ICmp(Pred, m_Value(X), m_Zero())) &&
+               (Pred == ICmpInst::ICMP_EQ || Pred == ICmpInst::ICMP_NE)) {
+      if (Pred == ICmpInst::ICMP_EQ)
+        TrueIsEq = !TrueIsEq;
+      V = X;
+    } else {
+      break;
+    }
+  }
+  auto *CI = dyn_cast<CallInst>(V);
+  if (!CI || CI->getParent() != BB)
+    return false;
+  Function *Callee = CI->getCalledFunction();
+  if (!Callee || CI->arg_size() < 3)
+    return false;
+  StringRef Name = Callee->getName();
+  if (Name == "memcmp" || Name == "bcmp")
+    TrueIsEq = !TrueIsEq; // zero result means equal
+  else if (Name != "runtime.memequal")
+    return false;
+
+  // The last three arguments are (a, b, size); a Go function also
+  // has a leading closure argument.
+  unsigned N = CI->arg_size();
+  Value *A = CI->getArgOperand(N - 3);
+  Value *B = CI->getArgOperand(N - 2);
+  Value *S = CI->getArgOperand(N - 1);
+  if (S != Len) {
+    auto *SC = dyn_cast<ConstantInt>(S);
+    if (!SC || SC->getZExtValue() != Size)
+      return false;
+  }
+  StringRef Str;
+  if (getConstantStringInfo(B, Str, 0, false)) {
+    // constant on the right
+  } else if (getConstantStringInfo(A, Str, 0, false)) {
+    std::swap(A, B);
+  } else {
+    return false;
+  }
+  if (Str.size() < Size)
+    return false;
+  if (Ptr && A != Ptr)
+    return false;
+
+  // Everything else in the block must be free of side effects,
+  // as the block may now be reached along a different path.
+  for (Instruction &I : *BB)
+    if (&I != CI && &I != BI && I.mayHaveSideEffects())
+      return false;
+
+  C.Confirm = BB;
+  C.ConfirmBr = BI;
+  C.FailIdx = TrueIsEq ? 1 : 0;
+  C.Dest = BI->getSuccessor(TrueIsEq ? 0 : 1);
+  C.Str = Str.substr(0, Size).str();
+  NeBB = BI->getSuccessor(C.FailIdx);
+  if (!Ptr)
+    Ptr = A;
+  return true;
+}
+
+// Walk the chain of compares starting at Head. Each link is a length
+// test whose "equal" edge leads to a confirm block; the "not equal"
+// edges of both lead to the next length test. Returns the cases in
+// source order, and the block reached when nothing matched.
+bool
+GoStringSwitch::collectChain(BasicBlock *Head, SmallVectorImpl<StrCase> &Cases,
+                             BasicBlock *&Default) {
+  Ptr = nullptr;
+  Len = nullptr;
+  BasicBlock *BB = Head;
+  SmallPtrSet<BasicBlock *, 16> InChain;
+  for (;;) {
+    uint64_t Size;
+    BasicBlock *EqBB, *NeBB, *FailBB;
+    StrCase C;
+    if (!matchLengthTest(BB, Size, EqBB, NeBB) ||
+        !matchConfirm(EqBB, Size, C, FailBB) ||
+        FailBB != NeBB)
+      break;
+    C.Test = BB;
+    Cases.push_back(C);
+    InChain.insert(BB);
+    InChain.insert(EqBB);
+    Default = NeBB;
+
+    // The next link must consist of the length test only, and must
+    // not be reachable from outside the chain.
+    BasicBlock *Next = NeBB;
+    if (InChain.count(Next) || !Next->hasNPredecessors(2) ||
+        &Next->front() != Next->getTerminator()->getPrevNode())
+      break;
+    BB = Next;
+  }
+  if (Cases.size() < MinCases)
+    return false;
+
+  // The string pointer has to be available at the head of the chain.
+  if (auto *PI = dyn_cast<Instruction>(Ptr))
+    if (InChain.count(PI->getParent()) && PI->getParent() != Head)
+      return false;
+
+  // Case destinations must lie outside the chain, and must not be the
+  // default block (whose PHIs are rewritten below).
+  for (StrCase &C : Cases)
+    if (InChain.count(C.Dest) || C.Dest == Default)
+      return false;
+
+  // PHIs in the default block must receive the same value from every
+  // chain block, since the set of incoming edges changes.
+  for (PHINode &PN : Default->phis()) {
+    Value *V = nullptr;
+    for (unsigned i = 0, e = PN.getNumIncomingValues(); i < e; ++i) {
+      if (!InChain.count(PN.getIncomingBlock(i)))
+        continue;
+      if (V && PN.getIncomingValue(i) != V)
+        return false;
+      V = PN.getIncomingValue(i);
+    }
+  }
+  return true;
+}
+
+// Pick the offset of a Width-byte window within strings of length
+// Size that yields the most distinct keys among Cases.
+static uint64_t
+bestWindow(ArrayRef<StrCase *> Cases, uint64_t Size, unsigned Width) {
+  uint64_t Best = 0;
+  size_t BestCount = 0;
+  for (uint64_t Off = 0; Off + Width <= Size && Off < 64; ++Off) {
+    std::set<std::string> Keys;
+    for (StrCase *C : Cases)
+      Keys.insert(C->Str.substr(Off, Width));
+    if (Keys.size() > BestCount) {
+      Best = Off;
+      BestCount = Keys.size();
+      if (BestCount == Cases.size())
+        break;
+    }
+  }
+  return Best;
+}
+
+static uint64_t
+keyFor(StringRef Bytes, bool LittleEndian) {
+  uint64_t K = 0;
+  for (unsigned i = 0, e = Bytes.size(); i < e; ++i) {
+    uint64_t B = (unsigned char)Bytes[LittleEndian ? e - 1 - i : i];
+    K = (K << 8) | B;
+  }
+  return K;
+}
+
+void
+GoStringSwitch::rewriteChain(Function &F, SmallVectorImpl<StrCase> &Cases,
+                             BasicBlock *Default) {
+  LLVMContext &Ctx = F.getContext();
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  BasicBlock *Head = Cases.front().Test;
+
+  // Value each default-block PHI receives from the chain.
+  SmallVector<std::pair<PHINode *, Value *>, 4> DefaultVals;
+  SmallPtrSet<BasicBlock *, 16> ChainBlocks;
+  for (StrCase &C : Cases) {
+    ChainBlocks.insert(C.Test);
+    ChainBlocks.insert(C.Confirm);
+  }
+  for (PHINode &PN : Default->phis())
+    for (unsigned i = 0, e = PN.getNumIncomingValues(); i < e; ++i)
+      if (ChainBlocks.count(PN.getIncomingBlock(i))) {
+        DefaultVals.push_back({&PN, PN.getIncomingValue(i)});
+        break;
+      }
+  auto addDefaultEdge = [&](BasicBlock *From) {
+    for (auto &P : DefaultVals)
+      P.first->addIncoming(P.second, From);
+  };
+  auto setFail = [&](StrCase &C, BasicBlock *Target) {
+    BasicBlock *Old = C.ConfirmBr->getSuccessor(C.FailIdx);
+    if (Old == Target)
+      return;
+    if (Old == Default)
+      for (auto &P : DefaultVals)
+        P.first->removeIncomingValue(C.Confirm, false);
+    C.ConfirmBr->setSuccessor(C.FailIdx, Target);
+    if (Target == Default)
+      addDefaultEdge(C.Confirm);
+  };
+
+  // Group cases by length, dropping duplicates (the first one wins,
+  // as in the original chain).
+  MapVector<uint64_t, SmallVector<StrCase *, 4>> BySize;
+  std::set<std::string> Seen;
+  SmallVector<StrCase *, 4> Dead;
+  for (StrCase &C : Cases) {
+    if (!Seen.insert(C.Str).second) {
+      Dead.push_back(&C);
+      continue;
+    }
+    BySize[C.Str.size()].push_back(&C);
+  }
+
+  // Detach the head's length test; the rest of the test blocks become
+  // unreachable and are deleted below.
+  Instruction *OldTerm = Head->getTerminator();
+  Value *OldCond = cast<BranchInst>(OldTerm)->getCondition();
+  for (auto &P : DefaultVals)
+    if (P.first->getBasicBlockIndex(Head) >= 0)
+      P.first->removeIncomingValue(Head, false);
+  OldTerm->eraseFromParent();
+  RecursivelyDeleteTriviallyDeadInstructions(OldCond);
+
+  IRBuilder<> Builder(Head);
+  Type *LenTy = Len->getType();
+  SwitchInst *LenSw = Builder.CreateSwitch(Len, Default, BySize.size());
+  addDefaultEdge(Head);
+
+  unsigned AS = Ptr->getType()->getPointerAddressSpace();
+  for (auto &Group : BySize) {
+    uint64_t Size = Group.first;
+    SmallVectorImpl<StrCase *> &G = Group.second;
+    auto *SizeVal = cast<ConstantInt>(ConstantInt::get(LenTy, Size));
+    if (G.size() == 1) {
+      LenSw->addCase(SizeVal, G[0]->Confirm);
+      setFail(*G[0], Default);
+      continue;
+    }
+
+    // Several cases of the same length: switch on a word loaded from
+    // the window of bytes that best separates them.
+    unsigned Width = 8;
+    while (Width > Size)
+      Width /= 2;
+    uint64_t Off = bestWindow(G, Size, Width);
+    BasicBlock *KeyBB = BasicBlock::Create(Ctx, "strswitch.key", &F, Default);
+    LenSw->addCase(SizeVal, KeyBB);
+    Builder.SetInsertPoint(KeyBB);
+    Value *P = Builder.CreatePointerCast(Ptr, Type::getInt8PtrTy(Ctx, AS));
+    P = Builder.CreateConstInBoundsGEP1_64(Type::getInt8Ty(Ctx), P, Off);
+    IntegerType *KeyTy = IntegerType::get(Ctx, Width * 8);
+    P = Builder.CreatePointerCast(P, KeyTy->getPointerTo(AS));
+    Value *Key = Builder.CreateAlignedLoad(KeyTy, P, Align(1), "strswitch.word");
+    SwitchInst *KeySw = Builder.CreateSwitch(Key, Default);
+    addDefaultEdge(KeyBB);
+
+    // Cases sharing a key are confirmed one after another.
+    MapVector<uint64_t, SmallVector<StrCase *, 2>> ByKey;
+    for (StrCase *C : G)
+      ByKey[keyFor(StringRef(C->Str).substr(Off, Width),
+                   DL.isLittleEndian())].push_back(C);
+    for (auto &K : ByKey) {
+      SmallVectorImpl<StrCase *> &KG = K.second;
+      KeySw->addCase(ConstantInt::get(KeyTy, K.first), KG[0]->Confirm);
+      for (unsigned i = 0, e = KG.size(); i < e; ++i)
+        setFail(*KG[i], i + 1 < e ? KG[i + 1]->Confirm : Default);
+    }
+  }
+
+  // The remaining length tests, and the confirm blocks of duplicate
+  // cases, can no longer be reached.
+  SmallVector<BasicBlock *, 16> DeadBlocks;
+  for (StrCase *C : Dead)
+    DeadBlocks.push_back(C->Confirm);
+  for (StrCase &C : Cases)
+    if (C.Test != Head)
+      DeadBlocks.push_back(C.Test);
+  DeleteDeadBlocks(DeadBlocks);
+
+  ++NumChains;
+  NumCases += Cases.size();
+}
+
+bool
+GoStringSwitch::runOnFunction(Function &F) {
+  if (Disabled || skipFunction(F))
+    return false;
+
+  SmallVector<BasicBlock *, 16> Worklist;
+  for (BasicBlock &BB : F)
+    Worklist.push_back(&BB);
+
+  bool Changed = false;
+  SmallPtrSet<BasicBlock *, 16> Erased;
+  for (BasicBlock *BB : Worklist) {
+    if (Erased.count(BB))
+      continue;
+    SmallVector<StrCase, 16> Cases;
+    BasicBlock *Default = nullptr;
+    if (!collectChain(BB, Cases, Default))
+      continue;
+    LLVM_DEBUG(dbgs() << "go-string-switch: " << Cases.size()
+                      << " cases in " << F.getName() << "\n");
+    for (StrCase &C : Cases) {
+      Erased.insert(C.Test);
+      Erased.insert(C.Confirm);
+    }
+    rewriteChain(F, Cases, Default);
+    Changed = true;
+  }
+  return Changed;
+}
@@ -0,0 +1,183 @@
+//===--- GoXRaySleds.cpp --------------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Adapt XRay sleds to split-stack functions, with two passes.
+//
+// GoXRaySleds moves the XRay function entry sled past the split-stack
+// prologue. XRay puts the entry sled at the very start of the
+// function, ahead of the stack limit check. The linker needs to find
+// that check at the start of the function, so that it can adjust it
+// when the function calls code not compiled with split stacks. Moving
+// the sled into the function body also means it runs once per call,
+// on the new stack segment if __morestack was called.
+//
+// GoXRayStackReserve makes sure the stack limit check leaves room for
+// the XRay trampoline. A patched sled calls the trampoline, which
+// saves registers on the goroutine stack before calling the handler,
+// and does no stack check of its own. The entry sled runs before the
+// frame is set up and the exit sleds after it is torn down, so frame
+// space that the check has already accounted for is free then. The
+// pass grows small frames to go-xray-stack-reserve bytes, which makes
+// the check cover the trampoline. The handler itself must check its
+// stack (as libgo's C code and Go code do). This runs before prologue
+// insertion, as the check is sized from the frame.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GollvmPasses.h"
+
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/CommandLine.h"
+
+using namespace llvm;
+
+static cl::opt<bool> Disabled("disable-go-xray-sleds",
+                              cl::desc("Disable Go XRay sleds pass"),
+                              cl::init(false), cl::Hidden);
+
+static cl::opt<unsigned> StackReserve(
+    "go-xray-stack-reserve",
+    cl::desc("Minimum frame size of XRay instrumented split-stack "
+             "functions, to fit the XRay trampoline"),
+    cl::init(512), cl::Hidden);
+
+namespace {
+
+class GoXRaySleds : public MachineFunctionPass {
+ public:
+  static char ID;
+
+  GoXRaySleds() : MachineFunctionPass(ID) {
+    initializeGoXRaySledsPass(*PassRegistry::getPassRegistry());
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  bool runOnMachineFunction(MachineFunction &MF) override;
+};
+
+}  // namespace
+
+char GoXRaySleds::ID = 0;
+INITIALIZE_PASS(GoXRaySleds, "go-xray-sleds",
+                "Move XRay entry sleds past the split-stack prologue", false,
+                false)
+FunctionPass *llvm::createGoXRaySledsPass() { return new GoXRaySleds(); }
+
+namespace {
+
+class GoXRayStackReserve : public MachineFunctionPass {
+ public:
+  static char ID;
+
+  GoXRayStackReserve() : MachineFunctionPass(ID) {
+    initializeGoXRayStackReservePass(*PassRegistry::getPassRegistry());
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  bool runOnMachineFunction(MachineFunction &MF) override;
+};
+
+}  // namespace
+
+char GoXRayStackReserve::ID = 0;
+INITIALIZE_PASS(GoXRayStackReserve, "go-xray-stack-reserve",
+                "Reserve stack for XRay trampolines in split-stack functions",
+                false, false)
+FunctionPass *llvm::createGoXRayStackReservePass() {
+  return new GoXRayStackReserve();
+}
+
+// Returns true if MBB calls __morestack.
+static bool callsMorestack(const MachineBasicBlock &MBB) {
+  for (const MachineInstr &MI : MBB)
+    if (MI.isCall() && MI.getOperand(0).isSymbol() &&
+        strcmp(MI.getOperand(0).getSymbolName(), "__morestack") == 0)
+      return true;
+  return false;
+}
+
+bool
+GoXRaySleds::runOnMachineFunction(MachineFunction &MF) {
+  if (Disabled)
+    return false;
+
+  if (!MF.shouldSplitStack())
+    return false;
+
+  MachineBasicBlock &Entry = MF.front();
+  auto Sled = llvm::find_if(Entry, [](const MachineInstr &MI) {
+    return MI.getOpcode() == TargetOpcode::PATCHABLE_FUNCTION_ENTER;
+  });
+  if (Sled == Entry.end())
+    return false;
+
+  // The split-stack prologue: the entry block compares the stack
+  // pointer against the limit, and either goes on to the body or to
+  // a block that calls __morestack (which calls the body on a new
+  // stack segment).
+  if (Entry.succ_size() != 2)
+    return false;
+  MachineBasicBlock *Alloc = nullptr;
+  MachineBasicBlock *Body = nullptr;
+  for (MachineBasicBlock *Succ : Entry.successors()) {
+    if (callsMorestack(*Succ))
+      Alloc = Succ;
+    else
+      Body = Succ;
+  }
+  if (!Alloc || !Body || !Alloc->isSuccessor(Body))
+    return false;
+
+  Body->splice(Body->begin(), &Entry, Sled);
+  return true;
+}
+
+// Whether XRay may instrument F (see XRayInstrumentation; whether the
+// function is big enough is not known yet).
+static bool mayInstrument(const Function &F) {
+  Attribute InstrAttr = F.getFnAttribute("function-instrument");
+  if (InstrAttr.isStringAttribute()) {
+    StringRef Val = InstrAttr.getValueAsString();
+    if (Val == "xray-never")
+      return false;
+    if (Val == "xray-always")
+      return true;
+  }
+  return F.hasFnAttribute("xray-instruction-threshold");
+}
+
+bool
+GoXRayStackReserve::runOnMachineFunction(MachineFunction &MF) {
+  if (Disabled)
+    return false;
+
+  if (!MF.shouldSplitStack() || !mayInstrument(MF.getFunction()))
+    return false;
+
+  // The estimate leaves out callee-saved register spills, so the
+  // final frame is at least this big.
+  MachineFrameInfo &MFI = MF.getFrameInfo();
+  uint64_t Size = MFI.estimateStackSize(MF);
+  if (Size >= StackReserve)
+    return false;
+  MFI.CreateStackObject(StackReserve - Size, Align(8), false);
+  return true;
+}
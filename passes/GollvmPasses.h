@@ -9,8 +9,12 @@
 #ifndef LLVM_GOLLVM_PASSES_GOLLVMPASSES_H
 #define LLVM_GOLLVM_PASSES_GOLLVMPASSES_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
 
+#include <string>
+#include <utility>
+
 namespace llvm {
 
 class DataLayout;
@@ -21,22 +25,36 @@ class Type;
 class Value;
 
 void initializeGoAnnotationPass(PassRegistry&);
+void initializeGoMultiversionPass(PassRegistry&);
+void initializeGoNilCheckElimPass(PassRegistry&);
 void initializeGoNilChecksPass(PassRegistry&);
 void initializeGoSafeGetgPass(PassRegistry&);
 void initializeGoStatepointsLegacyPassPass(PassRegistry&);
+void initializeGoStringSwitchPass(PassRegistry&);
 void initializeGoWrappersPass(PassRegistry&);
+void initializeGoXRaySledsPass(PassRegistry&);
+void initializeGoXRayStackReservePass(PassRegistry&);
 void initializeRemoveAddrSpacePassPass(PassRegistry&);
 
 FunctionPass *createGoAnnotationPass();
+ModulePass *createGoMultiversionPass(
+    ArrayRef<std::pair<std::string, std::string>> Cpus);
+ModulePass *createGoNilCheckElimPass();
 FunctionPass *createGoNilChecksPass();
 ModulePass *createGoSafeGetgPass();
 ModulePass *createGoStatepointsLegacyPass();
+FunctionPass *createGoStringSwitchPass();
 FunctionPass *createGoWrappersPass();
+FunctionPass *createGoXRaySledsPass();
+FunctionPass *createGoXRayStackReservePass();
 ModulePass *createRemoveAddrSpacePass(const DataLayout&);
 
 void linkGoGC();
 void linkGoGCPrinter();
 
+// Whether the PC-to-stack-map index is emitted (-gogc-stackmap-index).
+bool goStackMapIndexEnabled();
+
 } // namespace llvm
 
 namespace gollvm {
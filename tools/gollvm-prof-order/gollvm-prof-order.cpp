@@ -0,0 +1,121 @@
+//===-- gollvm-prof-order.cpp - sample profile to symbol ordering ---------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+//
+// Reads a sample profile (the same file passed to -fprofile-sample-use=,
+// typically produced from "perf record" data by create_llvm_prof) and
+// writes out a symbol ordering file listing functions hottest first.
+// The result is meant to be handed back to llvm-goc via
+// -ffunction-ordering-file=, which passes it on to the linker as
+// --symbol-ordering-file, packing hot code from all packages together.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/ProfileData/SampleProf.h"
+#include "llvm/ProfileData/SampleProfReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<std::string> InputFilename(cl::Positional, cl::Required,
+                                          cl::desc("<sample profile>"));
+
+static cl::opt<std::string> OutputFilename("o", cl::init("-"),
+                                           cl::desc("Output ordering file"),
+                                           cl::value_desc("filename"));
+
+static cl::opt<unsigned> MinSamples("min-samples", cl::init(1),
+                                    cl::desc("Omit functions with fewer "
+                                             "total samples than this"));
+
+static cl::opt<bool> IncludeInlined("include-inlined", cl::init(false),
+                                    cl::desc("Also list functions that only "
+                                             "appear inlined into others"));
+
+typedef DenseMap<StringRef, uint64_t> HotnessMap;
+
+// Credit the samples of functions inlined into FS to the callees
+// themselves, recursively, so that callees with out-of-line copies
+// are ordered next to their hot callers.
+static void collectInlinees(const sampleprof::FunctionSamples &FS,
+                            HotnessMap &hotness) {
+  for (const auto &cs : FS.getCallsiteSamples()) {
+    for (const auto &callee : cs.second) {
+      const sampleprof::FunctionSamples &cfs = callee.second;
+      hotness[cfs.getName()] += cfs.getTotalSamples();
+      collectInlinees(cfs, hotness);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv,
+                              "gollvm sample profile to symbol ordering\n");
+
+  LLVMContext context;
+  auto readerOrErr =
+      sampleprof::SampleProfileReader::create(InputFilename, context);
+  if (std::error_code ec = readerOrErr.getError()) {
+    errs() << argv[0] << ": unable to read profile '" << InputFilename
+           << "': " << ec.message() << "\n";
+    return 1;
+  }
+  std::unique_ptr<sampleprof::SampleProfileReader> reader =
+      std::move(readerOrErr.get());
+  if (std::error_code ec = reader->read()) {
+    errs() << argv[0] << ": error reading profile '" << InputFilename
+           << "': " << ec.message() << "\n";
+    return 1;
+  }
+
+  // Total samples per out-of-line function.
+  HotnessMap hotness;
+  for (const auto &entry : reader->getProfiles()) {
+    const sampleprof::FunctionSamples &fs = entry.second;
+    hotness[fs.getName()] += fs.getTotalSamples();
+    if (IncludeInlined)
+      collectInlinees(fs, hotness);
+  }
+
+  std::vector<std::pair<StringRef, uint64_t>> order;
+  for (const auto &h : hotness)
+    if (h.second >= MinSamples)
+      order.push_back(std::make_pair(h.first, h.second));
+
+  // Hottest first; break ties by name so the output is deterministic.
+  std::sort(order.begin(), order.end(),
+            [](const std::pair<StringRef, uint64_t> &a,
+               const std::pair<StringRef, uint64_t> &b) {
+              if (a.second != b.second)
+                return a.second > b.second;
+              return a.first < b.first;
+            });
+
+  std::error_code ec;
+  ToolOutputFile out(OutputFilename, ec, sys::fs::OF_None);
+  if (ec) {
+    errs() << argv[0] << ": unable to open '" << OutputFilename
+           << "': " << ec.message() << "\n";
+    return 1;
+  }
+  for (const auto &o : order)
+    out.os() << o.first << "\n";
+  out.keep();
+  return 0;
+}
@@ -111,6 +111,41 @@ TEST_P(BackendCoreTests, TypeHashAndCompare) {
   Btype *st2 = mkBackendThreeFieldStruct(be.get());
   EXPECT_EQ(st1->hash(), st2->hash());
   EXPECT_TRUE(st1->equal(*st1));
+
+  // Structs that lower to the same LLVM type but differ in field
+  // signedness or field names must not be commoned.
+  Btype *bi32t = be->integer_type(false, 32);
+  Btype *bu32t = be->integer_type(true, 32);
+  Btype *sa = mkBackendStruct(be.get(), bi32t, "a", nullptr);
+  Btype *sa2 = mkBackendStruct(be.get(), bi32t, "a", nullptr);
+  Btype *su = mkBackendStruct(be.get(), bu32t, "a", nullptr);
+  Btype *sb = mkBackendStruct(be.get(), bi32t, "b", nullptr);
+  EXPECT_EQ(sa, sa2);
+  EXPECT_EQ(sa->type(), su->type());
+  EXPECT_NE(sa, su);
+  EXPECT_NE(sa, sb);
+  EXPECT_NE(sa->hash(), su->hash());
+  EXPECT_NE(sa->hash(), sb->hash());
+  EXPECT_FALSE(sa->equal(*su));
+  EXPECT_FALSE(sa->equal(*sb));
+
+  // The cached hash has to track placeholder resolution: an array
+  // of a placeholder hashed before resolution must still be found
+  // (and hash the same as a new candidate) afterwards.
+  Location loc;
+  Btype *ph = be->placeholder_pointer_type("ph", loc, false);
+  Bexpression *val4 = mkInt64Const(be.get(), int64_t(4));
+  Btype *ap = be->array_type(ph, val4);
+  EXPECT_TRUE(ap->isPlaceholder());
+  ap->hash();
+  Btype *pi32t = be->pointer_type(bi32t);
+  be->set_placeholder_pointer_type(ph, pi32t);
+  EXPECT_FALSE(ap->isPlaceholder());
+  BArrayType cand(ph, val4, ap->type(), loc);
+  EXPECT_TRUE(ap->equal(cand));
+  EXPECT_EQ(ap->hash(), cand.hash());
+  Btype *ap2 = be->array_type(ph, mkInt64Const(be.get(), int64_t(4)));
+  EXPECT_EQ(ap, ap2);
 }
 
 TEST_P(BackendCoreTests, ComplexTypes) {
@@ -235,6 +270,58 @@ TEST_P(BackendCoreTests, PlaceholderTypes) {
   EXPECT_EQ(php4->type(), cpt->type());
 }
 
+TEST_P(BackendCoreTests, ManyRecursivePlaceholderTypes) {
+  LLVMContext C;
+  auto cc = GetParam();
+  std::unique_ptr<Backend> be(go_get_backend(C, cc));
+  Location loc;
+  const unsigned N = 4000;
+  Btype *bi64t = be->integer_type(false, 64);
+
+  // A large ring of mutually recursive types, of the form
+  //
+  //   type T<i> struct { next *T<i+1>; prev *T<i-1>; x int64 }
+  //
+  std::vector<Btype *> pts(N), sts(N);
+  for (unsigned i = 0; i < N; ++i)
+    pts[i] = be->placeholder_pointer_type("pt", loc, false);
+  for (unsigned i = 0; i < N; ++i) {
+    sts[i] = mkBackendStruct(be.get(), pts[(i + 1) % N], "next",
+                             pts[(i + N - 1) % N], "prev", bi64t, "x",
+                             nullptr);
+    ASSERT_TRUE(sts[i]->isPlaceholder());
+  }
+
+  // Size queries on unresolved types are answered via proxy types;
+  // repeat them while resolution is underway.
+  for (unsigned i = 0; i < N; ++i) {
+    EXPECT_EQ(be->type_size(sts[(i + N / 2) % N]), int64_t(24));
+    be->set_placeholder_pointer_type(pts[i], be->pointer_type(sts[i]));
+    EXPECT_EQ(be->type_size(sts[(i + N / 2) % N]), int64_t(24));
+  }
+  for (unsigned i = 0; i < N; ++i) {
+    EXPECT_FALSE(pts[i]->isPlaceholder());
+    EXPECT_FALSE(sts[i]->isPlaceholder());
+    EXPECT_TRUE(sts[i]->type()->isSized());
+    EXPECT_EQ(be->type_size(sts[i]), int64_t(24));
+    EXPECT_EQ(be->type_field_offset(sts[i], 2), int64_t(16));
+  }
+
+  // A long chain of pointers hanging off a single placeholder, all of
+  // which are resolved by a single event.
+  std::vector<Btype *> chain(N);
+  chain[0] = be->placeholder_pointer_type("chain", loc, false);
+  for (unsigned i = 1; i < N; ++i) {
+    chain[i] = be->pointer_type(chain[i-1]);
+    ASSERT_TRUE(chain[i]->isPlaceholder());
+  }
+  be->set_placeholder_pointer_type(chain[0], be->pointer_type(bi64t));
+  for (unsigned i = 0; i < N; ++i)
+    EXPECT_FALSE(chain[i]->isPlaceholder());
+  EXPECT_EQ(chain[2]->type(),
+            llvm::PointerType::get(chain[1]->type(), 0));
+}
+
 TEST_P(BackendCoreTests, ArrayTypes) {
   LLVMContext C;
   auto cc = GetParam();
@@ -326,6 +413,21 @@ TEST_P(BackendCoreTests, TypeUtils) {
   // type field alignment
   Btype *u32 = be->integer_type(true, 32);
   EXPECT_EQ(be->type_field_alignment(u32), 4);
+  EXPECT_EQ(be->type_field_alignment(st), 8);
+  EXPECT_EQ(be->type_field_alignment(u32), 4);
+
+  // Layout results are cached; make sure the answers track the
+  // filling in of a placeholder struct.
+  Btype *phst2 = be->placeholder_struct_type("ph3", loc);
+  EXPECT_EQ(be->type_size(phst2), int64_t(0));
+  std::vector<Backend::Btyped_identifier> fields2 = {
+    Backend::Btyped_identifier("f1", u64, loc),
+    Backend::Btyped_identifier("f2", i8t, loc)};
+  be->set_placeholder_struct_type(phst2, fields2);
+  EXPECT_EQ(be->type_size(phst2), int64_t(16));
+  EXPECT_EQ(be->type_alignment(phst2), 8);
+  EXPECT_EQ(be->type_field_offset(phst2, 1), int64_t(8));
+  EXPECT_EQ(be->type_size(phst2), int64_t(16));
 }
 
 TEST_P(BackendCoreTests, TestTypeEquivalence) {
@@ -271,6 +271,52 @@ TEST_P(BackendDebugEmit, TestDebugPrefixMap) {
   EXPECT_TRUE(ok);
 }
 
+TEST_P(BackendDebugEmit, TestLineTablesOnly) {
+  auto cc = GetParam();
+  FcnTestHarness h(cc);
+  Llvm_backend *be = h.be();
+  be->setDebugLineTablesOnly();
+  Btype *bi64t = be->integer_type(false, 64);
+  BFunctionType *befty = mkFuncTyp(be, L_PARM, bi64t, L_RES, bi64t, L_END);
+  Bfunction *func = h.mkFunction("bar", befty);
+  Bvariable *p0 = func->getNthParamVar(0);
+
+  Location loc = h.loc();
+  Bvariable *xv = h.mkLocal("x", bi64t, be->var_expression(p0, loc));
+  h.mkReturn(std::vector<Bexpression*>{be->var_expression(xv, loc)});
+
+  bool broken = h.finish(PreserveDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+
+  // The function and its locations are described, but not its
+  // variables or their types.
+  bool ok = h.expectModuleDumpContains("emissionKind: LineTablesOnly");
+  EXPECT_TRUE(ok);
+  ok = h.expectModuleDumpContains("!DISubprogram(name: \"bar\"");
+  EXPECT_TRUE(ok);
+  EXPECT_EQ(h.countInstancesInModuleDump("@llvm.dbg.declare(metadata"), 0u);
+  EXPECT_EQ(h.countInstancesInModuleDump("!DILocalVariable(name:"), 0u);
+  EXPECT_EQ(h.countInstancesInModuleDump("!DIBasicType(name:"), 0u);
+}
+
+TEST_P(BackendDebugEmit, TestSplitDwarfFile) {
+  auto cc = GetParam();
+  FcnTestHarness h(cc);
+  Llvm_backend *be = h.be();
+  be->setSplitDwarfFile("foo.dwo");
+  BFunctionType *befty = mkFuncTyp(be, L_END);
+  h.mkFunction("foo", befty);
+  h.mkLocal("x", be->integer_type(true, 32));
+
+  bool broken = h.finish(PreserveDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+
+  bool ok = h.expectModuleDumpContains("splitDebugFilename: \"foo.dwo\"");
+  EXPECT_TRUE(ok);
+  ok = h.expectModuleDumpContains("nameTableKind: GNU");
+  EXPECT_TRUE(ok);
+}
+
 TEST_P(BackendDebugEmit, TestFileLineDirectives) {
   auto cc = GetParam();
   FcnTestHarness h(cc);
@@ -144,6 +144,101 @@ TEST_P(BackendFcnTests, MakeFunction) {
   EXPECT_EQ(mistake, be_error_fcn);
 }
 
+TEST_P(BackendFcnTests, InitFunctionSectionPrefix) {
+  LLVMContext C;
+  auto cc = GetParam();
+  std::unique_ptr<Backend> be(go_get_backend(C, cc));
+  Location loc;
+
+  // Package initializers go in .text.startup; other functions whose
+  // names merely look similar do not.
+  BFunctionType *befty = mkFuncTyp(be.get(), L_END);
+  unsigned fflags = Backend::function_is_visible;
+  const std::pair<const char *, bool> cases[] = {
+    { "foo..import", true },
+    { "__go_init_main", true },
+    { "foo.init.0", true },
+    { "foo.init.12", true },
+    { "foo.init", false },
+    { "foo.init.x", false },
+    { "foo.T.initialize", false },
+  };
+  for (auto &c : cases) {
+    Bfunction *befcn = be->function(befty, c.first, c.first, fflags, loc);
+    llvm::Function *llfunc = befcn->function();
+    ASSERT_TRUE(llfunc != NULL);
+    Optional<StringRef> prefix = llfunc->getSectionPrefix();
+    EXPECT_EQ(prefix.hasValue(), c.second) << c.first;
+    if (c.second && prefix.hasValue())
+      EXPECT_EQ(*prefix, "startup");
+  }
+}
+
+TEST_P(BackendFcnTests, GCLeafRuntimeFunctions) {
+  LLVMContext C;
+  auto cc = GetParam();
+  std::unique_ptr<Backend> be(go_get_backend(C, cc));
+  Location loc;
+
+  // Calls to runtime helpers that cannot trigger a GC are not
+  // statepoints.
+  BFunctionType *befty = mkFuncTyp(be.get(), L_END);
+  unsigned fflags = (Backend::function_is_declaration |
+                     Backend::function_is_visible);
+  const std::pair<const char *, bool> cases[] = {
+    { "runtime.gcWriteBarrier", true },
+    { "runtime.memequal", true },
+    { "runtime.strhash", true },
+    { "runtime.nanotime", true },
+    { "runtime.newobject", false },
+    { "runtime.growslice", false },
+    { "foo.memequal", false },
+  };
+  for (auto &c : cases) {
+    Bfunction *befcn = be->function(befty, c.first, c.first, fflags, loc);
+    llvm::Function *llfunc = befcn->function();
+    ASSERT_TRUE(llfunc != NULL);
+    EXPECT_EQ(llfunc->hasFnAttribute("gc-leaf-function"), c.second)
+        << c.first;
+  }
+}
+
+TEST_P(BackendFcnTests, XRayInstrumentAttributes) {
+  auto cc = GetParam();
+  FcnTestHarness h(cc);
+  Llvm_backend *be = h.be();
+  be->setXRayInstrument(100);
+  Location loc;
+
+  BFunctionType *befty = mkFuncTyp(be, L_END);
+  unsigned fflags = (Backend::function_is_declaration |
+                     Backend::function_is_visible);
+  Bfunction *plain = be->function(befty, "plain", "plain", fflags, loc);
+  EXPECT_EQ(plain->function()
+                ->getFnAttribute("xray-instruction-threshold")
+                .getValueAsString(),
+            "100");
+  EXPECT_FALSE(plain->function()->hasFnAttribute("function-instrument"));
+
+  // Nosplit functions are not instrumented.
+  Bfunction *nosplit =
+      be->function(befty, "nosplit", "nosplit",
+                   fflags | Backend::function_no_split_stack, loc);
+  EXPECT_FALSE(
+      nosplit->function()->hasFnAttribute("xray-instruction-threshold"));
+
+  // Nor are functions that read their static chain, on x86_64,
+  // where the entry sled clobbers it.
+  Bfunction *closure = h.mkFunction("closure", befty);
+  Btype *bpi8t = be->pointer_type(be->integer_type(false, 8));
+  be->static_chain_variable(closure, "closure", bpi8t, 0, loc);
+  bool isX86 = (cc == llvm::CallingConv::X86_64_SysV);
+  EXPECT_EQ(closure->function()->hasFnAttribute("function-instrument"), isX86);
+
+  bool broken = h.finish(StripDebugInfo);
+  EXPECT_FALSE(broken && "Module failed to verify.");
+}
+
 TEST_P(BackendFcnTests, BuiltinFunctionsMisc) {
   LLVMContext C;
   auto cc = GetParam();
@@ -0,0 +1,187 @@
+//===- llvm/tools/gollvm/unittests/BackendCore/ImportIndexTests.cpp -----===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "go-import-index.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Object/ArchiveWriter.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Returns a minimal relocatable x86_64 ELF object whose only contents
+// is a .go_export section holding 'exportData'.
+std::string makeObject(llvm::StringRef exportData)
+{
+  const char shstrtab[] = "\0.go_export\0.shstrtab";
+  uint64_t dataOff = 64;
+  uint64_t strOff = dataOff + exportData.size();
+  uint64_t shOff = llvm::alignTo(strOff + sizeof(shstrtab), 8);
+
+  std::string buf;
+  llvm::raw_string_ostream os(buf);
+  llvm::support::endian::Writer w(os, llvm::support::little);
+  os << "\x7f" "ELF" << '\x02' << '\x01' << '\x01';
+  os.write_zeros(9);
+  w.write<uint16_t>(1);   // ET_REL
+  w.write<uint16_t>(62);  // EM_X86_64
+  w.write<uint32_t>(1);   // EV_CURRENT
+  w.write<uint64_t>(0);   // e_entry
+  w.write<uint64_t>(0);   // e_phoff
+  w.write<uint64_t>(shOff);
+  w.write<uint32_t>(0);   // e_flags
+  w.write<uint16_t>(64);  // e_ehsize
+  w.write<uint16_t>(0);   // e_phentsize
+  w.write<uint16_t>(0);   // e_phnum
+  w.write<uint16_t>(64);  // e_shentsize
+  w.write<uint16_t>(3);   // e_shnum
+  w.write<uint16_t>(2);   // e_shstrndx
+  os << exportData;
+  os.write(shstrtab, sizeof(shstrtab));
+  os.write_zeros(shOff - strOff - sizeof(shstrtab));
+
+  auto section = [&](uint32_t name, uint32_t type, uint64_t off,
+                     uint64_t size) {
+    w.write<uint32_t>(name);
+    w.write<uint32_t>(type);
+    w.write<uint64_t>(0);  // sh_flags
+    w.write<uint64_t>(0);  // sh_addr
+    w.write<uint64_t>(off);
+    w.write<uint64_t>(size);
+    w.write<uint32_t>(0);  // sh_link
+    w.write<uint32_t>(0);  // sh_info
+    w.write<uint64_t>(1);  // sh_addralign
+    w.write<uint64_t>(0);  // sh_entsize
+  };
+  section(0, 0, 0, 0);
+  section(1, 1, dataOff, exportData.size());   // .go_export, SHT_PROGBITS
+  section(12, 3, strOff, sizeof(shstrtab));    // .shstrtab, SHT_STRTAB
+  os.flush();
+  return buf;
+}
+
+void writeFile(const llvm::Twine &path, llvm::StringRef contents)
+{
+  llvm::sys::fs::create_directories(llvm::sys::path::parent_path(path.str()));
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path.str(), ec, llvm::sys::fs::OF_None);
+  ASSERT_FALSE(ec);
+  os << contents;
+}
+
+std::string readViaIndex(const std::string &path, off_t offset, bool &ok)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  char *buf = nullptr;
+  size_t len = 0;
+  ok = GoImportIndex::readExportData(fd, offset, &buf, &len);
+  ::close(fd);
+  std::string result(ok ? std::string(buf, len) : "");
+  delete[] buf;
+  return result;
+}
+
+TEST(ImportIndexTests, WriteAndLookup) {
+  llvm::SmallString<128> root;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("goimpidx", root));
+  std::string r(root);
+
+  writeFile(r + "/fmt.gox", makeObject("v3;fmt"));
+  // *.gox is preferred over lib*.a.
+  writeFile(r + "/encoding/json.gox", makeObject("v3;json"));
+  writeFile(r + "/encoding/libjson.a", "junk");
+  // Not scanned: hidden dirs and nested roots.
+  writeFile(r + "/.pic/bar.o", makeObject("v3;bar"));
+  writeFile(r + "/nested/baz.gox", makeObject("v3;baz"));
+  writeFile(r + "/nested/" + GoImportIndex::fileName, "");
+  // An archive with export data in its second member.
+  std::string o1 = makeObject("");
+  std::string o2 = makeObject("v3;foo");
+  std::vector<llvm::NewArchiveMember> members;
+  members.emplace_back(llvm::MemoryBufferRef(o1, "a.o"));
+  members.emplace_back(llvm::MemoryBufferRef(o2, "foo.o"));
+  llvm::Error aerr =
+      llvm::writeArchive(r + "/libfoo.a", members, true,
+                         llvm::object::Archive::K_GNU, true, false);
+  ASSERT_FALSE(bool(aerr));
+
+  std::string err;
+  ASSERT_TRUE(GoImportIndex::write(r, err)) << err;
+  std::unique_ptr<GoImportIndex> index = GoImportIndex::open(r);
+  ASSERT_TRUE(index != nullptr);
+  EXPECT_TRUE(index->isCurrent());
+  EXPECT_EQ(index->numEntries(), 3u);
+
+  GoImportIndex::Entry e;
+  EXPECT_FALSE(index->lookupPackage("bar", e));
+  EXPECT_FALSE(index->lookupPackage("nested/baz", e));
+  ASSERT_TRUE(index->lookupPackage("encoding/json", e));
+  EXPECT_EQ(e.file, "encoding/json.gox");
+  ASSERT_TRUE(index->lookupPackage("fmt", e));
+  EXPECT_EQ(e.file, "fmt.gox");
+  EXPECT_EQ(e.memberOffset, 0u);
+  EXPECT_EQ(e.exportSize, 6u);
+  ASSERT_TRUE(index->lookupPackage("foo", e));
+  EXPECT_EQ(e.file, "libfoo.a");
+  uint64_t fooOffset = e.memberOffset;
+  EXPECT_NE(fooOffset, 0u);
+
+  // Export data is read via the index once it is registered.
+  bool ok = false;
+  GoImportIndex::registerIndex(std::move(index));
+  EXPECT_EQ(readViaIndex(r + "/fmt.gox", 0, ok), "v3;fmt");
+  EXPECT_TRUE(ok);
+  EXPECT_EQ(readViaIndex(r + "/libfoo.a", fooOffset, ok), "v3;foo");
+  EXPECT_TRUE(ok);
+  readViaIndex(r + "/libfoo.a", 0, ok);
+  EXPECT_FALSE(ok);
+
+  // ... but not for files that changed since.
+  writeFile(r + "/fmt.gox", makeObject("v3;fmt2"));
+  readViaIndex(r + "/fmt.gox", 0, ok);
+  EXPECT_FALSE(ok);
+  GoImportIndex::clearRegistry();
+  readViaIndex(r + "/libfoo.a", fooOffset, ok);
+  EXPECT_FALSE(ok);
+
+  // A new package makes the index out of date.
+  writeFile(r + "/encoding/xml.gox", makeObject("v3;xml"));
+  index = GoImportIndex::open(r);
+  ASSERT_TRUE(index != nullptr);
+  EXPECT_FALSE(index->isCurrent());
+
+  llvm::sys::fs::remove_directories(r);
+}
+
+TEST(ImportIndexTests, EmptyAndMalformed) {
+  llvm::SmallString<128> root;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("goimpidx", root));
+  std::string r(root);
+
+  EXPECT_TRUE(GoImportIndex::open(r) == nullptr);
+  writeFile(r + "/" + GoImportIndex::fileName, "GOIMPIDX");
+  EXPECT_TRUE(GoImportIndex::open(r) == nullptr);
+
+  std::string err;
+  ASSERT_TRUE(GoImportIndex::write(r, err)) << err;
+  std::unique_ptr<GoImportIndex> index = GoImportIndex::open(r);
+  ASSERT_TRUE(index != nullptr);
+  EXPECT_EQ(index->numEntries(), 0u);
+  EXPECT_TRUE(index->isCurrent());
+
+  llvm::sys::fs::remove_directories(r);
+}
+
+}
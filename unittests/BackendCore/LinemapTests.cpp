@@ -78,4 +78,20 @@ TEST(LinemapTests, BasicLinemap) {
             "locmem=22 bytes/location=2.4");
 }
 
+TEST(LinemapTests, FileAlias) {
+  std::unique_ptr<Llvm_linemap> lm(new Llvm_linemap());
+
+  lm->add_file_alias("/proc/self/fd/5", "<stdin>");
+  lm->start_file("/proc/self/fd/5", 1);
+  EXPECT_EQ(lm->get_initial_file(), "<stdin>");
+  lm->start_line(3, 80);
+  Location s3 = lm->get_location(7);
+  EXPECT_EQ(lm->location_file(s3), std::string("<stdin>"));
+  EXPECT_EQ(lm->to_string(s3), "<stdin>:3");
+
+  lm->start_file("foo.go", 1);
+  Location f1 = lm->get_location(1);
+  EXPECT_EQ(lm->location_file(f1), std::string("foo.go"));
+}
+
 }
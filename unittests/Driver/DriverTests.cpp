@@ -6,13 +6,19 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <set>
 #include <stdarg.h>
 
+#include "Action.h"
+#include "Command.h"
 #include "Driver.h"
 #include "Compilation.h"
+#include "Tool.h"
 
 #include "gtest/gtest.h"
 
@@ -46,9 +52,13 @@ class DrvTestHarness {
   // Test that a dump of driver actions matches the expeced result.
   bool expectActions(const ExpectedDump &ed);
 
+  // Split DWARF file names for the compile actions, in order.
+  const std::vector<std::string> &dwoFiles() const { return dwoFiles_; }
+
  private:
   const std::vector<const char *> args_;
   std::string actionsDump_;
+  std::vector<std::string> dwoFiles_;
 };
 
 unsigned DrvTestHarness::Perform()
@@ -93,6 +103,10 @@ unsigned DrvTestHarness::Perform()
   if (!driver.processActions(*compilation))
     return 3;
   actionsDump_ = driver.dumpActions(*compilation);
+  for (Action *act : compilation->actions())
+    if (act->type() == Action::A_Compile ||
+        act->type() == Action::A_CompileAndAssemble)
+      dwoFiles_.push_back(driver.splitDwarfFile(*act));
   return 0;
 }
 
@@ -244,4 +258,309 @@ TEST(DriverTests, CompileAndLinkAction) {
   EXPECT_TRUE(isOK && "Actions dump does not have expected contents");
 }
 
+TEST(DriverTests, StdinCompileInMemory) {
+  DrvTestHarness h(A("-c", "-x", "go", "-", "-o", "foo.o", nullptr));
+
+  DECLARE_EXPECTED_OUTPUT(exp, R"RAW_RESULT(
+    Action readstdin
+      inputs:
+      output:
+        Artifact buffer(<stdin>)
+    Action compile+assemble
+      inputs:
+        readstdin
+      output:
+        Artifact arg(foo.o)
+  )RAW_RESULT");
+
+  unsigned res = h.Perform();
+  ASSERT_TRUE(res == 0 && "Setup failed");
+
+  bool isOK = h.expectActions(exp);
+  EXPECT_TRUE(isOK && "Actions dump does not have expected contents");
+}
+
+TEST(DriverTests, StdinCompileSaveTemps) {
+  DrvTestHarness h(A("-c", "-save-temps", "-x", "go", "-", "-o", "foo.o",
+                     nullptr));
+
+  DECLARE_EXPECTED_OUTPUT(exp, R"RAW_RESULT(
+    Action readstdin
+      inputs:
+      output:
+        Artifact file(/tmp/out.readstdin.0)
+    Action compile+assemble
+      inputs:
+        readstdin
+      output:
+        Artifact arg(foo.o)
+  )RAW_RESULT");
+
+  unsigned res = h.Perform();
+  ASSERT_TRUE(res == 0 && "Setup failed");
+
+  bool isOK = h.expectActions(exp);
+  EXPECT_TRUE(isOK && "Actions dump does not have expected contents");
+}
+
+TEST(DriverTests, SplitDwarfFileNames) {
+  typedef std::vector<std::string> names;
+  struct {
+    std::vector<const char *> args;
+    names want;
+  } cases[] = {
+    // With -c, the .dwo goes next to the object.
+    { A("-c", "-gsplit-dwarf", "dir/foo.go", "-o", "out/bar.o", nullptr),
+      names{"out/bar.dwo"} },
+    // Otherwise it is named after the first source file.
+    { A("-c", "-gsplit-dwarf", "dir/foo.go", nullptr), names{"foo.dwo"} },
+    { A("-S", "-gsplit-dwarf", "foo.go", "-o", "bar.s", nullptr),
+      names{"foo.dwo"} },
+    { A("-gsplit-dwarf", "foo1.go", "foo2.go", "-o", "foo.exe", nullptr),
+      names{"foo1.dwo"} },
+    // Standard input.
+    { A("-c", "-gsplit-dwarf", "-x", "go", "-", "-o", "bar.o", nullptr),
+      names{"bar.dwo"} },
+    { A("-c", "-gsplit-dwarf", "-x", "go", "-", nullptr),
+      names{"stdin.dwo"} },
+    // No split DWARF, no name.
+    { A("-c", "foo.go", "-o", "foo.o", nullptr), names{""} },
+  };
+
+  for (auto &c : cases) {
+    DrvTestHarness h(c.args);
+    unsigned res = h.Perform();
+    ASSERT_TRUE(res == 0 && "Setup failed");
+    EXPECT_EQ(h.dwoFiles(), c.want);
+  }
+}
+
+// An internal tool used to create commands by ExecTestHarness below.
+class FakeTool : public InternalTool {
+ public:
+  FakeTool(ToolChain &tc, bool reentrant)
+      : InternalTool("fake", tc, ""), reentrant_(reentrant) { }
+
+  bool performAction(Compilation &compilation,
+                     const Action &jobAction,
+                     const ArtifactList &inputArtifacts,
+                     const Artifact &output) override {
+    return false;
+  }
+  bool isReentrant() const override { return reentrant_; }
+
+ private:
+  bool reentrant_;
+};
+
+// Sets up a compilation with hand-made commands, each of which logs
+// when it starts and ends, to test how Compilation::executeCommands
+// schedules them.
+class ExecTestHarness {
+ public:
+  explicit ExecTestHarness(const std::vector<const char *> args);
+
+  // Returns false if the driver could not be set up.
+  bool setup();
+
+  // Make a tool to run commands with.
+  FakeTool &tool(bool reentrant);
+
+  // Queue a command named 'name' using 'tool', which depends on the
+  // commands for 'inputs' and fails if 'fail' is set. Returns the
+  // action carried out by the command.
+  Action *addCommand(const std::string &name, FakeTool &tool,
+                     ActionList inputs, bool fail = false);
+
+  // Commands wait (for at most 'timeout') until 'count' of them have
+  // started before they finish, so that those that may run at the
+  // same time do. Failing commands finish at once.
+  void setRendezvous(unsigned count, std::chrono::milliseconds timeout) {
+    rendezvous_ = count;
+    timeout_ = timeout;
+  }
+
+  bool execute() { return compilation_->executeCommands(); }
+
+  // "start <name>" and "end <name>" for each command run, in order.
+  const std::vector<std::string> &log() const { return log_; }
+
+  // The most commands of 'tool' running at once.
+  unsigned maxActive(const FakeTool &tool) { return maxActive_[&tool]; }
+
+ private:
+  int run(const std::string &name, const FakeTool &tool, bool fail);
+
+  const std::vector<const char *> args_;
+  std::unique_ptr<opt::OptTable> opts_;
+  opt::InputArgList parsedArgs_;
+  std::unique_ptr<Driver> driver_;
+  ToolChain *toolchain_;
+  std::unique_ptr<Compilation> compilation_;
+  std::vector<std::unique_ptr<FakeTool>> tools_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::vector<std::string> log_;
+  std::map<const FakeTool *, unsigned> active_;
+  std::map<const FakeTool *, unsigned> maxActive_;
+  unsigned started_ = 0;
+  unsigned rendezvous_ = 0;
+  std::chrono::milliseconds timeout_;
+};
+
+ExecTestHarness::ExecTestHarness(const std::vector<const char *> args)
+    : args_(args),
+      toolchain_(nullptr),
+      timeout_(0)
+{
+}
+
+bool ExecTestHarness::setup()
+{
+  opts_ = gollvm::options::createGollvmDriverOptTable();
+  unsigned missingArgIndex, missingArgCount;
+  parsedArgs_ = opts_->ParseArgs(makeArrayRef(args_), missingArgIndex,
+                                 missingArgCount);
+  if (missingArgIndex != 0)
+    return false;
+  driver_.reset(new Driver(parsedArgs_, opts_.get(), "llvm-goc", true));
+  driver_->setUnitTesting();
+  toolchain_ = driver_->setup();
+  if (toolchain_ == nullptr)
+    return false;
+  compilation_ = driver_->buildCompilation(*toolchain_);
+  return true;
+}
+
+FakeTool &ExecTestHarness::tool(bool reentrant)
+{
+  tools_.push_back(std::make_unique<FakeTool>(*toolchain_, reentrant));
+  return *tools_.back();
+}
+
+Action *ExecTestHarness::addCommand(const std::string &name, FakeTool &tool,
+                                    ActionList inputs, bool fail)
+{
+  Action *act = new Action(Action::A_Compile, inputs);
+  compilation_->recordAction(act);
+  compilation_->addAction(act);
+  opt::ArgStringList noArgs;
+  noArgs.push_back(nullptr);
+  compilation_->addCommand(*act, tool, nullptr, noArgs,
+                           [this, name, &tool, fail](ArrayRef<const char *>,
+                                                     std::string *errMsg) {
+                             if (fail)
+                               *errMsg = name + " failed";
+                             return run(name, tool, fail);
+                           });
+  return act;
+}
+
+int ExecTestHarness::run(const std::string &name, const FakeTool &tool,
+                         bool fail)
+{
+  std::unique_lock<std::mutex> lock(mu_);
+  log_.push_back("start " + name);
+  unsigned &active = active_[&tool];
+  maxActive_[&tool] = std::max(maxActive_[&tool], ++active);
+  ++started_;
+  cv_.notify_all();
+  if (!fail)
+    cv_.wait_for(lock, timeout_,
+                 [this]() { return started_ >= rendezvous_; });
+  --active;
+  log_.push_back("end " + name);
+  return fail ? 1 : 0;
+}
+
+TEST(DriverTests, ExecuteCommandsOrder) {
+  typedef std::vector<std::string> events;
+
+  // Serially, commands run in the order they were queued.
+  ExecTestHarness serial(A("-j", "1", "-c", "foo.go", nullptr));
+  ASSERT_TRUE(serial.setup());
+  FakeTool &st = serial.tool(true);
+  Action *a = serial.addCommand("a", st, {});
+  Action *b = serial.addCommand("b", st, {});
+  serial.addCommand("link", st, {a, b});
+  EXPECT_TRUE(serial.execute());
+  EXPECT_EQ(serial.log(), (events{"start a", "end a", "start b", "end b",
+                                  "start link", "end link"}));
+
+  // In parallel, independent commands overlap, and a command starts
+  // only once those it depends on have finished.
+  ExecTestHarness par(A("-j", "4", "-c", "foo.go", nullptr));
+  ASSERT_TRUE(par.setup());
+  FakeTool &pt = par.tool(true);
+  par.setRendezvous(2, std::chrono::seconds(10));
+  a = par.addCommand("a", pt, {});
+  b = par.addCommand("b", pt, {});
+  Action *c = par.addCommand("c", pt, {a});
+  par.addCommand("link", pt, {b, c});
+  EXPECT_TRUE(par.execute());
+  EXPECT_EQ(par.maxActive(pt), 2u);
+  const events &log = par.log();
+  ASSERT_EQ(log.size(), 8u);
+  auto at = [&](const char *ev) {
+    return std::find(log.begin(), log.end(), ev) - log.begin();
+  };
+  EXPECT_LT(at("end a"), at("start c"));
+  EXPECT_LT(at("end b"), at("start link"));
+  EXPECT_LT(at("end c"), at("start link"));
+  EXPECT_EQ(log.back(), "end link");
+}
+
+TEST(DriverTests, ExecuteCommandsStopAfterFailure) {
+  typedef std::vector<std::string> events;
+
+  // Serially, nothing runs after the failing command.
+  ExecTestHarness serial(A("-c", "foo.go", nullptr));
+  ASSERT_TRUE(serial.setup());
+  FakeTool &st = serial.tool(true);
+  Action *a = serial.addCommand("a", st, {}, true);
+  Action *b = serial.addCommand("b", st, {});
+  serial.addCommand("link", st, {a, b});
+  EXPECT_FALSE(serial.execute());
+  EXPECT_EQ(serial.log(), (events{"start a", "end a"}));
+
+  // In parallel, a command already running is allowed to finish (b
+  // may also be skipped, if a has failed before it gets going), but
+  // no dependents are started. (b waits until it times out, well after
+  // a has failed.)
+  ExecTestHarness par(A("-j", "2", "-c", "foo.go", nullptr));
+  ASSERT_TRUE(par.setup());
+  FakeTool &pt = par.tool(true);
+  par.setRendezvous(3, std::chrono::milliseconds(500));
+  a = par.addCommand("a", pt, {}, true);
+  b = par.addCommand("b", pt, {});
+  par.addCommand("c", pt, {a});
+  par.addCommand("d", pt, {b});
+  EXPECT_FALSE(par.execute());
+  events log = par.log();
+  std::sort(log.begin(), log.end());
+  if (log.size() == 2)
+    EXPECT_EQ(log, (events{"end a", "start a"}));
+  else
+    EXPECT_EQ(log, (events{"end a", "end b", "start a", "start b"}));
+}
+
+TEST(DriverTests, ExecuteCommandsNonReentrantTool) {
+  // Actions of a tool that is not reentrant are run one at a time;
+  // those of other tools can run alongside them.
+  ExecTestHarness h(A("-j", "4", "-c", "foo.go", nullptr));
+  ASSERT_TRUE(h.setup());
+  FakeTool &serialTool = h.tool(false);
+  FakeTool &otherTool = h.tool(true);
+  h.setRendezvous(2, std::chrono::milliseconds(200));
+  Action *a = h.addCommand("a", serialTool, {});
+  Action *b = h.addCommand("b", serialTool, {});
+  Action *c = h.addCommand("c", serialTool, {});
+  Action *d = h.addCommand("d", otherTool, {});
+  h.addCommand("link", otherTool, {a, b, c, d});
+  EXPECT_TRUE(h.execute());
+  EXPECT_EQ(h.maxActive(serialTool), 1u);
+  EXPECT_EQ(h.log().size(), 10u);
+  EXPECT_EQ(h.log().back(), "end link");
+}
+
 } // namespace
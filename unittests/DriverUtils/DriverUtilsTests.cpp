@@ -10,12 +10,24 @@
 #include <map>
 #include <set>
 
+#include "ArchCpuSetup.h"
 #include "Driver.h"
 #include "GccUtils.h"
 #include "Distro.h"
+#include "GollvmOptions.h"
+#include "Jobserver.h"
+#include "ToolchainCache.h"
+
+#include "llvm/Option/ArgList.h"
+#include "llvm/Option/OptTable.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Path.h"
 
 #include "gtest/gtest.h"
 
+#include <unistd.h>
+
 #include "DiffUtils.h"
 
 using namespace goBackendUnitTests;
@@ -487,6 +499,139 @@ TEST(DriverUtilsTests, GCCInstallationDetectorBiarchAliasesAmd64) {
   EXPECT_TRUE(isOK);
 }
 
+TEST(DriverUtilsTests, GCCInstallationDetectorTrackAndRestore) {
+  const char *install = R"RAW_INPUT(
+      /usr/lib/gcc/x86_64-linux-gnu/6/crtbegin.o
+      /usr/lib/gcc/x86_64-linux-gnu/7/crtbegin.o
+    )RAW_INPUT";
+  InspectFakeFS ffs(install);
+  InspectTrackingFS tfs(ffs);
+  llvm::Triple triple("x86_64-linux-gnu");
+  GCCInstallationDetector detector(triple, "", "", tfs);
+  detector.init();
+
+  // The directory holding the installs was examined.
+  EXPECT_TRUE(tfs.consulted().count("/usr/lib/gcc/x86_64-linux-gnu") != 0);
+
+  // Restoring the results gives the same answers, with no FS access.
+  InspectFakeFS empty("");
+  GCCInstallationDetector restored(triple, "", "", empty);
+  restored.restore(detector.version().text(),
+                   detector.foundTriple().str(),
+                   detector.getInstallPath(),
+                   detector.getLibPath(),
+                   detector.getParentLibPath());
+  EXPECT_EQ(restored.toString(), detector.toString());
+}
+
+TEST(DriverUtilsTests, ToolchainCacheSaveLoad) {
+  using gollvm::driver::ToolchainCache;
+
+  llvm::SmallString<128> tmpdir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("tccache", tmpdir));
+  llvm::SmallString<128> depdir(tmpdir);
+  llvm::sys::path::append(depdir, "lib");
+  ASSERT_FALSE(llvm::sys::fs::create_directory(depdir));
+  llvm::SmallString<128> otherdir(tmpdir);
+  llvm::sys::path::append(otherdir, "bin");
+  ASSERT_FALSE(llvm::sys::fs::create_directory(otherdir));
+  llvm::SmallString<128> path(tmpdir);
+  llvm::sys::path::append(path, "sub", "cache.json");
+
+  // Nothing there yet.
+  ToolchainCache c1(std::string(path), "key1");
+  EXPECT_FALSE(c1.load());
+  c1.insert("gcc.version", "7", {std::string(depdir)});
+  c1.insertList("filePaths", {"/a", "/b"}, {std::string(otherdir)});
+  EXPECT_TRUE(c1.save());
+
+  // Reload with the same key.
+  ToolchainCache c2(std::string(path), "key1");
+  EXPECT_TRUE(c2.load());
+  std::string version;
+  EXPECT_TRUE(c2.lookup("gcc.version", version));
+  EXPECT_EQ(version, "7");
+  llvm::SmallVector<std::string, 4> paths;
+  EXPECT_TRUE(c2.lookupList("filePaths", paths));
+  ASSERT_EQ(paths.size(), 2u);
+  EXPECT_EQ(paths[1], "/b");
+  EXPECT_FALSE(c2.lookup("gcc.triple", version));
+
+  // Different key.
+  ToolchainCache c3(std::string(path), "key2");
+  EXPECT_FALSE(c3.load());
+
+  // Changes next to a path an entry depends on (here, the cache file
+  // itself being written) do not affect it.
+  ToolchainCache c4(std::string(path), "key1");
+  EXPECT_TRUE(c4.load());
+  EXPECT_TRUE(c4.lookup("gcc.version", version));
+
+  // An entry goes stale once a path it depends on changes; others
+  // stay valid.
+  ASSERT_FALSE(llvm::sys::fs::remove(depdir));
+  ToolchainCache c5(std::string(path), "key1");
+  EXPECT_TRUE(c5.load());
+  EXPECT_FALSE(c5.lookup("gcc.version", version));
+  paths.clear();
+  EXPECT_TRUE(c5.lookupList("filePaths", paths));
+  EXPECT_EQ(paths.size(), 2u);
+
+  llvm::sys::fs::remove_directories(tmpdir);
+}
+
+TEST(DriverUtilsTests, ToolchainCacheDirectoryDeps) {
+  using gollvm::driver::ToolchainCache;
+
+  EXPECT_EQ(ToolchainCache::containingDir("/usr/lib/crt1.o"), "/usr/lib");
+  EXPECT_EQ(ToolchainCache::containingDir("ld"), ".");
+
+  llvm::SmallString<128> tmpdir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("tccache", tmpdir));
+  llvm::SmallString<128> libdir(tmpdir);
+  llvm::sys::path::append(libdir, "lib");
+  ASSERT_FALSE(llvm::sys::fs::create_directory(libdir));
+  llvm::SmallString<128> path(tmpdir);
+  llvm::sys::path::append(path, "cache.json");
+
+  // Lookups of two files that are not in 'lib' both depend on that
+  // directory only.
+  llvm::SmallString<128> foo(libdir), bar(libdir);
+  llvm::sys::path::append(foo, "libfoo.a");
+  llvm::sys::path::append(bar, "libbar.a");
+  ToolchainCache c1(std::string(path), "key");
+  c1.insert("file:libfoo.a", "libfoo.a",
+            {ToolchainCache::containingDir(foo)});
+  c1.insert("file:libbar.a", "libbar.a",
+            {ToolchainCache::containingDir(bar)});
+  EXPECT_EQ(countinstances(c1.toString(), std::string(libdir)), 2u)
+      << c1.toString();
+  EXPECT_TRUE(c1.save());
+
+  ToolchainCache c2(std::string(path), "key");
+  EXPECT_TRUE(c2.load());
+  std::string value;
+  EXPECT_TRUE(c2.lookup("file:libfoo.a", value));
+  EXPECT_TRUE(c2.lookup("file:libbar.a", value));
+
+  // Adding one of the files changes the directory, which invalidates
+  // both. (Set the time explicitly, in case the file system's clock
+  // is too coarse to tell.)
+  int fd;
+  ASSERT_FALSE(llvm::sys::fs::openFileForWrite(foo, fd));
+  ::close(fd);
+  ASSERT_FALSE(llvm::sys::fs::openFileForRead(libdir, fd));
+  EXPECT_FALSE(llvm::sys::fs::setLastAccessAndModificationTime(
+      fd, std::chrono::system_clock::now() + std::chrono::hours(1)));
+  ::close(fd);
+  ToolchainCache c3(std::string(path), "key");
+  EXPECT_TRUE(c3.load());
+  EXPECT_FALSE(c3.lookup("file:libfoo.a", value));
+  EXPECT_FALSE(c3.lookup("file:libbar.a", value));
+
+  llvm::sys::fs::remove_directories(tmpdir);
+}
+
 TEST(DriverUtilsTests, DistroDetector) {
   const char *install = R"RAW_INPUT(
       /etc/lsb-release
@@ -503,4 +648,101 @@ TEST(DriverUtilsTests, DistroDetector) {
   EXPECT_EQ(whichDistro2, distro::DistroUnknown);
 }
 
+TEST(DriverUtilsTests, ArchAndTuneCpu) {
+  std::unique_ptr<llvm::opt::OptTable> opts =
+      gollvm::options::createGollvmDriverOptTable();
+  std::vector<const char *> argv = {"-march=haswell", "-mtune=skylake",
+                                    "-mtune=bogus", "-mtune=generic"};
+  unsigned missingArgIndex, missingArgCount;
+  llvm::opt::InputArgList args =
+      opts->ParseArgs(argv, missingArgIndex, missingArgCount);
+  std::vector<llvm::opt::Arg *> margs(args.begin(), args.end());
+  ASSERT_EQ(margs.size(), 4u);
+
+  llvm::Triple x86("x86_64-unknown-linux-gnu");
+  std::string cpu, attrs, tune;
+  EXPECT_TRUE(gollvm::driver::setupArchCpu(margs[0], cpu, attrs, x86, "t"));
+  EXPECT_EQ(cpu, "haswell");
+  EXPECT_NE(attrs.find("+avx2"), std::string::npos);
+
+  // -mtune does not change the ISA chosen by -march.
+  EXPECT_TRUE(gollvm::driver::setupTuneCpu(margs[1], tune, x86, "t"));
+  EXPECT_EQ(tune, "skylake");
+  EXPECT_FALSE(gollvm::driver::setupTuneCpu(margs[2], tune, x86, "t"));
+  EXPECT_TRUE(gollvm::driver::setupTuneCpu(margs[3], tune, x86, "t"));
+  EXPECT_EQ(tune, "generic");
+  EXPECT_TRUE(gollvm::driver::setupTuneCpu(nullptr, tune, x86, "t"));
+  EXPECT_EQ(tune, "");
+}
+
+TEST(DriverUtilsTests, ArchCpuNative) {
+  std::unique_ptr<llvm::opt::OptTable> opts =
+      gollvm::options::createGollvmDriverOptTable();
+  std::vector<const char *> argv = {"-march=native"};
+  unsigned missingArgIndex, missingArgCount;
+  llvm::opt::InputArgList args =
+      opts->ParseArgs(argv, missingArgIndex, missingArgCount);
+  llvm::opt::Arg *native = *args.begin();
+
+  llvm::Triple host(llvm::sys::getProcessTriple());
+  llvm::Triple x86("x86_64-unknown-linux-gnu");
+  llvm::Triple arm64("aarch64-unknown-linux-gnu");
+  llvm::Triple *same = nullptr, *other = nullptr;
+  if (host.getArch() == llvm::Triple::x86_64) {
+    same = &x86;
+    other = &arm64;
+  } else if (host.getArch() == llvm::Triple::aarch64) {
+    same = &arm64;
+    other = &x86;
+  } else {
+    return;
+  }
+
+  // Whatever the host CPU, native always yields a usable CPU.
+  std::string cpu, attrs;
+  EXPECT_TRUE(gollvm::driver::setupArchCpu(native, cpu, attrs, *same, "t"));
+  EXPECT_FALSE(cpu.empty());
+  EXPECT_NE(cpu, "generic");
+
+  // Cross compiling with -march=native is an error.
+  EXPECT_FALSE(gollvm::driver::setupArchCpu(native, cpu, attrs, *other, "t"));
+}
+
+TEST(DriverUtilsTests, JobserverFromMakeflags) {
+  using gollvm::driver::Jobserver;
+
+  // No jobserver, or a malformed / unusable one.
+  EXPECT_TRUE(Jobserver::fromMakeflags("") == nullptr);
+  EXPECT_TRUE(Jobserver::fromMakeflags("-j4 -- FOO=bar") == nullptr);
+  EXPECT_TRUE(Jobserver::fromMakeflags("--jobserver-auth=x,y") == nullptr);
+  EXPECT_TRUE(Jobserver::fromMakeflags("--jobserver-auth=-1,-1") == nullptr);
+  EXPECT_TRUE(Jobserver::fromMakeflags(
+      "--jobserver-auth=fifo:/nonexistent/fifo") == nullptr);
+
+  // A pipe holding two tokens, named in both the old and new forms.
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  ASSERT_EQ(write(fds[1], "++", 2), 2);
+  std::string auth = std::to_string(fds[0]) + "," + std::to_string(fds[1]);
+  EXPECT_TRUE(Jobserver::fromMakeflags("-j --jobserver-fds=" + auth) !=
+              nullptr);
+  std::unique_ptr<Jobserver> js =
+      Jobserver::fromMakeflags(" -j8 --jobserver-auth=" + auth);
+  ASSERT_TRUE(js != nullptr);
+
+  char t1 = 0, t2 = 0;
+  EXPECT_TRUE(js->acquire(&t1));
+  EXPECT_TRUE(js->acquire(&t2));
+  EXPECT_EQ(t1, '+');
+  js->release(t1);
+  js->release(t2);
+
+  // Tokens are given back to the pipe; its descriptors are not closed.
+  js.reset();
+  char buf[3];
+  EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 2);
+  close(fds[0]);
+  close(fds[1]);
+}
+
 } // namespace
@@ -0,0 +1,198 @@
+//===---- GoMultiversionTests.cpp -----------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GollvmPasses.h"
+#include "PassTestUtils.h"
+
+#include "DiffUtils.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalIFunc.h"
+
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace goBackendUnitTests;
+
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string>> CpuList;
+
+// @hot is entered often enough to count as hot under the sample
+// profile summary below; @warm is not.
+const char *FunctionsIR = R"RAW_RESULT(
+  define i64 @hot(i64* %p, i64 %n) #0 !prof !20 {
+  entry:
+    br label %loop
+  loop:
+    %i = phi i64 [ 0, %entry ], [ %i1, %loop ]
+    %s = phi i64 [ 0, %entry ], [ %s1, %loop ]
+    %ep = getelementptr i64, i64* %p, i64 %i
+    %e = load i64, i64* %ep
+    %s1 = add i64 %s, %e
+    %i1 = add i64 %i, 1
+    %done = icmp eq i64 %i1, %n
+    br i1 %done, label %exit, label %loop
+  exit:
+    ret i64 %s1
+  }
+  define i64 @warm(i64* %p, i64 %n) #0 !prof !21 {
+  entry:
+    br label %loop
+  loop:
+    %i = phi i64 [ 0, %entry ], [ %i1, %loop ]
+    %i1 = add i64 %i, 1
+    %done = icmp eq i64 %i1, %n
+    br i1 %done, label %exit, label %loop
+  exit:
+    ret i64 %i1
+  }
+  define i64 @caller(i64* %p) #0 {
+  entry:
+    %r = call i64 @hot(i64* %p, i64 8)
+    ret i64 %r
+  }
+  attributes #0 = { "target-cpu"="generic" "target-features"="+sse2" }
+  !20 = !{!"function_entry_count", i64 1000}
+  !21 = !{!"function_entry_count", i64 10}
+)RAW_RESULT";
+
+// A sample profile summary in which 100 entries make a function hot.
+const char *ProfileSummaryIR = R"RAW_RESULT(
+  !llvm.module.flags = !{!1}
+  !1 = !{i32 1, !"ProfileSummary", !2}
+  !2 = !{!3, !4, !5, !6, !7, !8, !9, !10}
+  !3 = !{!"ProfileFormat", !"SampleProfile"}
+  !4 = !{!"TotalCount", i64 10000}
+  !5 = !{!"MaxCount", i64 1000}
+  !6 = !{!"MaxInternalCount", i64 1}
+  !7 = !{!"MaxFunctionCount", i64 1000}
+  !8 = !{!"NumCounts", i64 3}
+  !9 = !{!"NumFunctions", i64 3}
+  !10 = !{!"DetailedSummary", !11}
+  !11 = !{!12, !13, !14}
+  !12 = !{i32 10000, i64 1000, i32 1}
+  !13 = !{i32 999000, i64 100, i32 1}
+  !14 = !{i32 999999, i64 1, i32 2}
+)RAW_RESULT";
+
+std::unique_ptr<Module> runMultiversion(LLVMContext &ctx,
+                                        const std::string &triple,
+                                        const CpuList &cpus, bool profile)
+{
+  std::string ir = "target triple = \"" + triple + "\"\n" + FunctionsIR;
+  if (profile)
+    ir += ProfileSummaryIR;
+  std::unique_ptr<Module> mod = parseIR(ctx, ir);
+  if (mod && !runPass(*mod, createGoMultiversionPass(cpus)))
+    return nullptr;
+  return mod;
+}
+
+TEST(GoMultiversionTests, HotFunctionCloned) {
+  LLVMContext ctx;
+  std::unique_ptr<Module> mod = runMultiversion(
+      ctx, "x86_64-unknown-linux-gnu",
+      { { "haswell", "+avx2,+fma,+bmi,+movbe" } }, true);
+  ASSERT_TRUE(mod != nullptr);
+
+  // @hot is now an ifunc, and the caller goes through it.
+  GlobalIFunc *ifunc = mod->getNamedIFunc("hot");
+  ASSERT_TRUE(ifunc != nullptr) << repr(*mod);
+  EXPECT_TRUE(ifunc->hasExternalLinkage());
+  EXPECT_EQ(ifunc->getResolverFunction(),
+            mod->getFunction("hot..mv.resolver"));
+  EXPECT_TRUE(containstokens(repr(mod->getFunction("caller")),
+                             "call i64 @hot(i64*"));
+
+  // The clone gets the features the resolver checks for, and no
+  // others: libgcc has no bit for movbe.
+  Function *clone = mod->getFunction("hot..mv.haswell");
+  ASSERT_TRUE(clone != nullptr) << repr(*mod);
+  EXPECT_TRUE(clone->hasInternalLinkage());
+  EXPECT_EQ(clone->getFnAttribute("target-features").getValueAsString(),
+            "+sse2,+avx2,+fma,+bmi");
+  EXPECT_EQ(clone->getFnAttribute("tune-cpu").getValueAsString(), "haswell");
+  Function *dflt = mod->getFunction("hot..mv.default");
+  ASSERT_TRUE(dflt != nullptr) << repr(*mod);
+  EXPECT_EQ(dflt->getFnAttribute("target-features").getValueAsString(),
+            "+sse2");
+
+  // avx2 (bit 10) | fma (14) | bmi (16) of __cpu_model's feature word.
+  std::string resolver = repr(mod->getFunction("hot..mv.resolver"));
+  EXPECT_TRUE(containstokens(resolver, "call void @__cpu_indicator_init()"))
+      << resolver;
+  EXPECT_TRUE(containstokens(resolver, "and i64 %1, 82944")) << resolver;
+  EXPECT_TRUE(containstokens(resolver, "ret i64 (i64*, i64)* @hot..mv.haswell"))
+      << resolver;
+  EXPECT_TRUE(containstokens(resolver, "ret i64 (i64*, i64)* @hot..mv.default"))
+      << resolver;
+
+  // libgcc's symbols come from libgcc_s in a shared link.
+  EXPECT_FALSE(mod->getNamedGlobal("__cpu_model")->isDSOLocal());
+  EXPECT_FALSE(mod->getFunction("__cpu_indicator_init")->isDSOLocal());
+
+  // @warm is not hot enough.
+  EXPECT_EQ(mod->getNamedIFunc("warm"), nullptr);
+  EXPECT_EQ(mod->getFunction("warm..mv.haswell"), nullptr);
+}
+
+TEST(GoMultiversionTests, NoProfile) {
+  // Without a profile there is no telling which functions are worth
+  // the extra code, so none are cloned.
+  LLVMContext ctx;
+  std::unique_ptr<Module> mod = runMultiversion(
+      ctx, "x86_64-unknown-linux-gnu", { { "haswell", "+avx2,+fma" } },
+      false);
+  ASSERT_TRUE(mod != nullptr);
+  EXPECT_TRUE(mod->ifunc_empty()) << repr(*mod);
+  EXPECT_EQ(mod->getFunction("hot..mv.haswell"), nullptr);
+}
+
+TEST(GoMultiversionTests, ResolverPicksMostCapable) {
+  // On aarch64 the resolver tests the AT_HWCAP value it is passed, so
+  // the interpreter can run it. The CPU with more features is tried
+  // first, whatever order the CPUs were listed in.
+  LLVMContext ctx;
+  std::unique_ptr<Module> mod = runMultiversion(
+      ctx, "aarch64-unknown-linux-gnu",
+      { { "cortex-a55", "+neon,+dotprod" },
+        { "a64fx", "+neon,+fullfp16,+sve" },
+        { "generic", "+v8a" } },
+      true);
+  ASSERT_TRUE(mod != nullptr);
+  Function *a55 = mod->getFunction("hot..mv.cortex-a55");
+  Function *a64fx = mod->getFunction("hot..mv.a64fx");
+  Function *dflt = mod->getFunction("hot..mv.default");
+  ASSERT_TRUE(a55 && a64fx && dflt) << repr(*mod);
+  // No testable features, so no clone.
+  EXPECT_EQ(mod->getFunction("hot..mv.generic"), nullptr);
+
+  const uint64_t neon = 1 << 1, fullfp16 = (1 << 9) | (1 << 10);
+  const uint64_t dotprod = 1 << 20, sve = 1 << 22;
+  struct {
+    uint64_t hwcap;
+    Function *want;
+  } cases[] = {
+    { 0, dflt },
+    { neon, dflt },
+    { neon | dotprod, a55 },
+    { neon | fullfp16 | sve, a64fx },
+    { neon | (1 << 9) | sve, dflt },
+    { neon | fullfp16 | dotprod | sve, a64fx },
+  };
+  IRInterpreter interp(std::move(mod));
+  for (auto &c : cases) {
+    GenericValue res = interp.call("hot..mv.resolver", { intArg(64, c.hwcap) });
+    EXPECT_EQ(GVTOP(res), c.want)
+        << "hwcap " << c.hwcap << " picked "
+        << static_cast<Function *>(GVTOP(res))->getName().str();
+  }
+}
+
+} // namespace
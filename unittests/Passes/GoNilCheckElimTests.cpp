@@ -0,0 +1,224 @@
+//===---- GoNilCheckElimTests.cpp -----------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GollvmPasses.h"
+#include "PassTestUtils.h"
+
+#include "DiffUtils.h"
+
+#include "llvm/IR/Function.h"
+
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace goBackendUnitTests;
+
+namespace {
+
+// Declarations shared by the tests below. Go functions carry
+// "null-pointer-is-valid", so LLVM itself draws no conclusions from
+// dereferences.
+const char *Prologue = R"RAW_RESULT(
+  target triple = "x86_64-unknown-linux-gnu"
+  declare void @runtime.panicmem(i8* nest)
+  declare void @use(i64)
+  attributes #0 = { "null-pointer-is-valid"="true" }
+)RAW_RESULT";
+
+// Run the pass over Prologue + 'ir'; returns the resulting module.
+std::unique_ptr<Module> runElim(LLVMContext &ctx, const std::string &ir)
+{
+  std::unique_ptr<Module> mod = parseIR(ctx, std::string(Prologue) + ir);
+  if (mod && !runPass(*mod, createGoNilCheckElimPass()))
+    return nullptr;
+  return mod;
+}
+
+unsigned nilChecks(Module &mod, StringRef fcn)
+{
+  return countinstances(repr(mod.getFunction(fcn)), "null");
+}
+
+TEST(GoNilCheckElimTests, DominatingDereference) {
+  // The load of p.f would have faulted on nil, so the check after it
+  // is redundant.
+  LLVMContext ctx;
+  std::unique_ptr<Module> mod = runElim(ctx, R"RAW_RESULT(
+    define void @f({ i64, i64 }* %p) #0 {
+    entry:
+      %fp = getelementptr { i64, i64 }, { i64, i64 }* %p, i64 0, i32 1
+      %v = load i64, i64* %fp
+      call void @use(i64 %v)
+      %isnil = icmp eq { i64, i64 }* %p, null
+      br i1 %isnil, label %panic, label %ok
+    panic:
+      call void @runtime.panicmem(i8* nest undef)
+      unreachable
+    ok:
+      %w = load i64, i64* %fp
+      call void @use(i64 %w)
+      ret void
+    }
+  )RAW_RESULT");
+  ASSERT_TRUE(mod != nullptr);
+  std::string after = repr(mod->getFunction("f"));
+  EXPECT_EQ(nilChecks(*mod, "f"), 0u) << after;
+  EXPECT_FALSE(containstokens(after, "@runtime.panicmem(i8*")) << after;
+}
+
+TEST(GoNilCheckElimTests, DereferenceBeyondGuard) {
+  // A dereference past the guard size (4096) could hit mapped memory
+  // instead of faulting, so it proves nothing.
+  LLVMContext ctx;
+  std::unique_ptr<Module> mod = runElim(ctx, R"RAW_RESULT(
+    define void @f([1024 x i64]* %p) #0 {
+    entry:
+      %fp = getelementptr [1024 x i64], [1024 x i64]* %p, i64 0, i64 512
+      %v = load i64, i64* %fp
+      call void @use(i64 %v)
+      %isnil = icmp eq [1024 x i64]* %p, null
+      br i1 %isnil, label %panic, label %ok
+    panic:
+      call void @runtime.panicmem(i8* nest undef)
+      unreachable
+    ok:
+      ret void
+    }
+  )RAW_RESULT");
+  ASSERT_TRUE(mod != nullptr);
+  EXPECT_EQ(nilChecks(*mod, "f"), 1u) << repr(mod->getFunction("f"));
+}
+
+TEST(GoNilCheckElimTests, DominatingBranchEdge) {
+  // The second check is only reached along the non-nil edge of the
+  // first one. The first check stays.
+  LLVMContext ctx;
+  std::unique_ptr<Module> mod = runElim(ctx, R"RAW_RESULT(
+    define void @f(i64* %p, i1 %c) #0 {
+    entry:
+      %isnil = icmp eq i64* %p, null
+      br i1 %isnil, label %panic, label %ok
+    panic:
+      call void @runtime.panicmem(i8* nest undef)
+      unreachable
+    ok:
+      br i1 %c, label %then, label %done
+    then:
+      %isnil2 = icmp ne i64* %p, null
+      br i1 %isnil2, label %ok2, label %panic2
+    panic2:
+      call void @runtime.panicmem(i8* nest undef)
+      unreachable
+    ok2:
+      %v = load i64, i64* %p
+      call void @use(i64 %v)
+      br label %done
+    done:
+      ret void
+    }
+  )RAW_RESULT");
+  ASSERT_TRUE(mod != nullptr);
+  std::string after = repr(mod->getFunction("f"));
+  EXPECT_EQ(nilChecks(*mod, "f"), 1u) << after;
+  EXPECT_EQ(countinstances(after, "@runtime.panicmem(i8*"), 1u) << after;
+}
+
+TEST(GoNilCheckElimTests, CheckOnUncoveredPath) {
+  // Only one path to the check dereferences p.
+  LLVMContext ctx;
+  std::unique_ptr<Module> mod = runElim(ctx, R"RAW_RESULT(
+    define void @f(i64* %p, i1 %c) #0 {
+    entry:
+      br i1 %c, label %load, label %check
+    load:
+      %v = load i64, i64* %p
+      call void @use(i64 %v)
+      br label %check
+    check:
+      %isnil = icmp eq i64* %p, null
+      br i1 %isnil, label %panic, label %ok
+    panic:
+      call void @runtime.panicmem(i8* nest undef)
+      unreachable
+    ok:
+      ret void
+    }
+  )RAW_RESULT");
+  ASSERT_TRUE(mod != nullptr);
+  EXPECT_EQ(nilChecks(*mod, "f"), 1u) << repr(mod->getFunction("f"));
+}
+
+// @outer checks p and passes it to @mid, which passes it on to
+// @leaf. Only once @mid's parameter is known to be nonnull does
+// @leaf's follow, so this takes two rounds.
+const char *ParamChainIR = R"RAW_RESULT(
+  define internal void @leaf(i64* %p) #0 {
+  entry:
+    %isnil = icmp eq i64* %p, null
+    br i1 %isnil, label %panic, label %ok
+  panic:
+    call void @runtime.panicmem(i8* nest undef)
+    unreachable
+  ok:
+    %v = load i64, i64* %p
+    call void @use(i64 %v)
+    ret void
+  }
+  define internal void @mid(i64* %p) #0 {
+  entry:
+    call void @leaf(i64* %p)
+    ret void
+  }
+  define void @outer(i64* %p) #0 {
+  entry:
+    %isnil = icmp eq i64* %p, null
+    br i1 %isnil, label %panic, label %ok
+  panic:
+    call void @runtime.panicmem(i8* nest undef)
+    unreachable
+  ok:
+    call void @mid(i64* %p)
+    ret void
+  }
+)RAW_RESULT";
+
+TEST(GoNilCheckElimTests, NonNullParamsFixedPoint) {
+  LLVMContext ctx;
+  std::unique_ptr<Module> mod = runElim(ctx, ParamChainIR);
+  ASSERT_TRUE(mod != nullptr);
+  EXPECT_TRUE(mod->getFunction("mid")->getArg(0)->hasNonNullAttr());
+  EXPECT_TRUE(mod->getFunction("leaf")->getArg(0)->hasNonNullAttr());
+  EXPECT_EQ(nilChecks(*mod, "leaf"), 0u) << repr(mod->getFunction("leaf"));
+  // The caller's own check stays: its parameter is visible outside.
+  EXPECT_FALSE(mod->getFunction("outer")->getArg(0)->hasNonNullAttr());
+  EXPECT_EQ(nilChecks(*mod, "outer"), 1u) << repr(mod->getFunction("outer"));
+}
+
+TEST(GoNilCheckElimTests, NonNullParamsNeedAllCallers) {
+  // A second caller that passes an unchecked pointer, and one that
+  // takes @leaf's address, each keep the parameter as it is.
+  std::string unchecked = std::string(ParamChainIR) + R"RAW_RESULT(
+    define void @other(i64* %q) #0 {
+    entry:
+      call void @mid(i64* %q)
+      ret void
+    }
+  )RAW_RESULT";
+  std::string escaped = std::string(ParamChainIR) + R"RAW_RESULT(
+    @fp = global void (i64*)* @leaf
+  )RAW_RESULT";
+  for (const std::string &ir : { unchecked, escaped }) {
+    LLVMContext ctx;
+    std::unique_ptr<Module> mod = runElim(ctx, ir);
+    ASSERT_TRUE(mod != nullptr);
+    EXPECT_FALSE(mod->getFunction("leaf")->getArg(0)->hasNonNullAttr());
+    EXPECT_EQ(nilChecks(*mod, "leaf"), 1u) << repr(*mod);
+  }
+}
+
+} // namespace
@@ -0,0 +1,185 @@
+//===---- GoNilChecksTests.cpp --------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GollvmPasses.h"
+#include "PassTestUtils.h"
+
+#include "llvm/IR/DiagnosticHandler.h"
+#include "llvm/IR/DiagnosticInfo.h"
+
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace goBackendUnitTests;
+
+namespace {
+
+// Collects the pass's remarks, one per nil check: whether it was
+// folded into an access, replaced by a probe, or kept (and why).
+struct RemarkCollector : public DiagnosticHandler {
+  std::vector<std::string> &remarks;
+
+  explicit RemarkCollector(std::vector<std::string> &r) : remarks(r) { }
+
+  bool handleDiagnostics(const DiagnosticInfo &DI) override {
+    auto *remark = dyn_cast<DiagnosticInfoOptimizationBase>(&DI);
+    if (!remark)
+      return false;
+    if (remark->getPassName() == "go-nil-checks")
+      remarks.push_back(remark->getMsg());
+    return true;
+  }
+  bool isAnalysisRemarkEnabled(StringRef) const override { return true; }
+  bool isMissedOptRemarkEnabled(StringRef) const override { return true; }
+  bool isPassedOptRemarkEnabled(StringRef) const override { return true; }
+  bool isAnyRemarkEnabled() const override { return true; }
+};
+
+// Nil checks as the bridge emits them, branching to a panicmem call
+// and marked make.implicit.
+const char *Prologue = R"RAW_RESULT(
+  target triple = "x86_64-unknown-linux-gnu"
+  %T = type { i64, %T* }
+  declare void @runtime.panicmem(i8* nest)
+  !0 = !{}
+)RAW_RESULT";
+
+class NilChecksTest : public testing::Test {
+ protected:
+  // Compile Prologue + 'ir' with GoNilChecks. Returns false if the
+  // target is not available.
+  bool compile(const std::string &ir) {
+    ctx_.setDiagnosticHandler(std::make_unique<RemarkCollector>(remarks_));
+    std::unique_ptr<Module> mod = parseIR(ctx_, std::string(Prologue) + ir);
+    if (!mod)
+      return false;
+    std::unique_ptr<TargetMachine> tm = createTargetMachine(*mod);
+    if (!tm)
+      return false;
+    asm_ = emitAsm(*mod, *tm, [](legacy::PassManager &pm) {
+      pm.add(createGoNilChecksPass());
+    });
+    return true;
+  }
+
+  std::string remarks() const {
+    std::string res;
+    for (const std::string &r : remarks_)
+      res += r + "\n";
+    return res;
+  }
+
+  LLVMContext ctx_;
+  std::vector<std::string> remarks_;
+  std::string asm_;
+};
+
+TEST_F(NilChecksTest, ChainedChecks) {
+  // p is checked and p.next loaded; then that pointer is checked and
+  // dereferenced in turn. Each load takes over the check before it.
+  if (!compile(R"RAW_RESULT(
+    define i64 @f(%T* %p) {
+    entry:
+      %pnil = icmp eq %T* %p, null
+      br i1 %pnil, label %panic, label %ok1, !make.implicit !0
+    ok1:
+      %qp = getelementptr %T, %T* %p, i64 0, i32 1
+      %q = load %T*, %T** %qp
+      %qnil = icmp eq %T* %q, null
+      br i1 %qnil, label %panic, label %ok2, !make.implicit !0
+    ok2:
+      %vp = getelementptr %T, %T* %q, i64 0, i32 0
+      %v = load i64, i64* %vp
+      ret i64 %v
+    panic:
+      call void @runtime.panicmem(i8* nest undef)
+      unreachable
+    }
+  )RAW_RESULT"))
+    GTEST_SKIP() << "x86_64 target not available";
+
+  EXPECT_EQ(remarks_, std::vector<std::string>(
+                          2, "nil check folded into a memory access"))
+      << remarks();
+  EXPECT_EQ(asm_.find("testq"), std::string::npos) << asm_;
+}
+
+TEST_F(NilChecksTest, GuardBoundary) {
+  // An access at offset 4088 is within the 4096-byte guard and takes
+  // over the check. One at 4096 might not fault, so a probe of offset
+  // zero is loaded in place of the check.
+  if (!compile(R"RAW_RESULT(
+    define i64 @below([1024 x i64]* %p) {
+    entry:
+      %isnil = icmp eq [1024 x i64]* %p, null
+      br i1 %isnil, label %panic, label %ok, !make.implicit !0
+    ok:
+      %fp = getelementptr [1024 x i64], [1024 x i64]* %p, i64 0, i64 511
+      %v = load i64, i64* %fp
+      ret i64 %v
+    panic:
+      call void @runtime.panicmem(i8* nest undef)
+      unreachable
+    }
+    define i64 @at([1024 x i64]* %p) {
+    entry:
+      %isnil = icmp eq [1024 x i64]* %p, null
+      br i1 %isnil, label %panic, label %ok, !make.implicit !0
+    ok:
+      %fp = getelementptr [1024 x i64], [1024 x i64]* %p, i64 0, i64 512
+      %v = load i64, i64* %fp
+      ret i64 %v
+    panic:
+      call void @runtime.panicmem(i8* nest undef)
+      unreachable
+    }
+  )RAW_RESULT"))
+    GTEST_SKIP() << "x86_64 target not available";
+
+  std::vector<std::string> want = { "nil check folded into a memory access",
+                                    "nil check replaced by a probe load" };
+  EXPECT_EQ(remarks_, want) << remarks();
+  size_t at = asm_.find("at:");
+  ASSERT_NE(at, std::string::npos) << asm_;
+  EXPECT_NE(asm_.find("movq\t4088(%rdi), %rax"), std::string::npos) << asm_;
+  size_t probe = asm_.find("(%rdi), %rax", at);
+  size_t access = asm_.find("movq\t4096(%rdi), %rax", at);
+  ASSERT_NE(probe, std::string::npos) << asm_;
+  ASSERT_NE(access, std::string::npos) << asm_;
+  EXPECT_LT(probe, access) << asm_;
+  EXPECT_EQ(asm_.find("testq"), std::string::npos) << asm_;
+}
+
+TEST_F(NilChecksTest, SideEffectBeforeDereference) {
+  // The asm has side effects that must not happen before the panic,
+  // so the check stays.
+  if (!compile(R"RAW_RESULT(
+    define i64 @f(i64* %p) {
+    entry:
+      %isnil = icmp eq i64* %p, null
+      br i1 %isnil, label %panic, label %ok, !make.implicit !0
+    ok:
+      call void asm sideeffect "", ""()
+      %v = load i64, i64* %p
+      ret i64 %v
+    panic:
+      call void @runtime.panicmem(i8* nest undef)
+      unreachable
+    }
+  )RAW_RESULT"))
+    GTEST_SKIP() << "x86_64 target not available";
+
+  std::vector<std::string> want = {
+    "nil check kept explicit: instruction with side effects before the "
+    "first dereference"
+  };
+  EXPECT_EQ(remarks_, want) << remarks();
+  EXPECT_NE(asm_.find("testq"), std::string::npos) << asm_;
+}
+
+} // namespace
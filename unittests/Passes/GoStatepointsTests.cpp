@@ -0,0 +1,369 @@
+//===---- GoStatepointsTests.cpp ------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GollvmPasses.h"
+#include "PassTestUtils.h"
+
+#include "DiffUtils.h"
+#include "GoStackMap.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
+
+#include "gtest/gtest.h"
+
+#include <map>
+
+using namespace llvm;
+using namespace goBackendUnitTests;
+
+namespace {
+
+// Declarations for Go functions as the bridge emits them: they use
+// the "go" GC strategy and the dummy personality (see
+// Llvm_backend::dummyPersonalityFunction). @wb stands in for a write
+// barrier function, which the bridge marks as a GC leaf.
+const char *Prologue = R"RAW_RESULT(
+  target triple = "x86_64-unknown-linux-gnu"
+  declare i32 @__gccgo_personality_dummy(i32, i32, i64, i8*, i8*)
+  declare void @g(i8* nest)
+  declare void @wb(i8* nest, i8**, i8*) #0
+  attributes #0 = { "gc-leaf-function" }
+  !0 = !{}
+)RAW_RESULT";
+
+// What "GOFN" in the test IR stands for: the attributes of a Go
+// function definition.
+const char *GoFn =
+    "gc \"go\" personality i32 (i32, i32, i64, i8*, i8*)* "
+    "@__gccgo_personality_dummy";
+
+class StatepointsTest : public testing::Test {
+ protected:
+  // Run GoStatepoints over Prologue + 'ir'.
+  bool run(const std::string &ir) {
+    std::string full = std::string(Prologue) + ir;
+    size_t pos;
+    while ((pos = full.find("GOFN")) != std::string::npos)
+      full.replace(pos, 4, GoFn);
+    mod_ = parseIR(ctx_, full);
+    return mod_ && runPass(*mod_, createGoStatepointsLegacyPass());
+  }
+
+  bool isLeaf(const char *name) {
+    return mod_->getFunction(name)->hasFnAttribute("gc-leaf-function");
+  }
+
+  std::string fn(const char *name) {
+    return repr(mod_->getFunction(name));
+  }
+
+  // Names of the blocks of 'fname' in which slot 'slot' is zeroed,
+  // by a store of null or a memset.
+  std::vector<std::string> zeroedIn(const char *fname, const char *slot) {
+    std::vector<std::string> res;
+    for (Instruction &I : instructions(mod_->getFunction(fname))) {
+      Value *dest = nullptr;
+      if (auto *SI = dyn_cast<StoreInst>(&I)) {
+        if (isa<ConstantPointerNull>(SI->getValueOperand()))
+          dest = SI->getPointerOperand();
+      } else if (auto *MS = dyn_cast<MemSetInst>(&I)) {
+        dest = MS->getDest();
+      }
+      if (dest && dest->stripPointerCasts()->getName() == slot)
+        res.push_back(I.getParent()->getName().str());
+    }
+    return res;
+  }
+
+  // Set the value of command line option 'name' (which runs its
+  // callback, if any).
+  static void setOption(const char *name, const char *value) {
+    cl::ResetAllOptionOccurrences();
+    cl::getRegisteredOptions()[name]->addOccurrence(0, name, value);
+  }
+
+  LLVMContext ctx_;
+  std::unique_ptr<Module> mod_;
+};
+
+TEST_F(StatepointsTest, InferLeafChain) {
+  // @leaf2 only calls the write barrier, and @leaf1 only @leaf2, so
+  // both are leaves, and calling them needs no statepoint.
+  ASSERT_TRUE(run(R"RAW_RESULT(
+    define i64 @leaf1(i8* nest %c, i8** %p, i64 %x) GOFN {
+      %y = call i64 @leaf2(i8* nest undef, i8** %p, i64 %x)
+      ret i64 %y
+    }
+    define i64 @leaf2(i8* nest %c, i8** %p, i64 %x) GOFN {
+      call void @wb(i8* nest undef, i8** %p, i8* null)
+      ret i64 %x
+    }
+    define i64 @caller(i8* nest %c, i8** %p) GOFN {
+      %r = call i64 @leaf1(i8* nest undef, i8** %p, i64 1)
+      call void @g(i8* nest undef)
+      ret i64 %r
+    }
+  )RAW_RESULT"));
+
+  EXPECT_TRUE(isLeaf("leaf1"));
+  EXPECT_TRUE(isLeaf("leaf2"));
+  EXPECT_FALSE(isLeaf("caller"));
+  std::string caller = fn("caller");
+  EXPECT_TRUE(containstokens(
+      caller, "%r = call i64 @leaf1(i8* nest undef, i8** %p, i64 1)"))
+      << caller;
+  EXPECT_EQ(countinstances(caller, "invoke token"), 1u) << caller;
+}
+
+TEST_F(StatepointsTest, InferLeafNotInferred) {
+  // A function is not a leaf if it may recurse (directly or not),
+  // makes an indirect call, or may be replaced at link time by a
+  // definition that is not.
+  ASSERT_TRUE(run(R"RAW_RESULT(
+    define i64 @rec(i8* nest %c, i64 %x) GOFN {
+      %y = call i64 @rec(i8* nest undef, i64 %x)
+      ret i64 %y
+    }
+    define void @even(i8* nest %c) GOFN {
+      call void @odd(i8* nest undef)
+      ret void
+    }
+    define void @odd(i8* nest %c) GOFN {
+      call void @even(i8* nest undef)
+      ret void
+    }
+    define void @indirect(i8* nest %c, void (i8*)* %fp) GOFN {
+      call void %fp(i8* nest undef)
+      ret void
+    }
+    define void @callsIndirect(i8* nest %c) GOFN {
+      call void @indirect(i8* nest undef, void (i8*)* null)
+      ret void
+    }
+    define linkonce_odr void @odr(i8* nest %c, i8** %p) GOFN {
+      call void @wb(i8* nest undef, i8** %p, i8* null)
+      ret void
+    }
+    define weak void @weak(i8* nest %c, i8** %p) GOFN {
+      call void @wb(i8* nest undef, i8** %p, i8* null)
+      ret void
+    }
+    define void @callsOdr(i8* nest %c, i8** %p) GOFN {
+      call void @odr(i8* nest undef, i8** %p)
+      ret void
+    }
+  )RAW_RESULT"));
+
+  for (const char *name : { "rec", "even", "odd", "indirect",
+                            "callsIndirect", "odr", "weak", "callsOdr" })
+    EXPECT_FALSE(isLeaf(name)) << name;
+  std::string callsOdr = fn("callsOdr");
+  EXPECT_EQ(countinstances(callsOdr, "invoke token"), 1u) << callsOdr;
+}
+
+// Return the first stack map entry in 'asmText': the directives
+// following its label.
+std::string firstStackMapEntry(const std::string &asmText)
+{
+  size_t start = asmText.find("\n" GO_STACKMAP_SYM_PREFIX);
+  if (start == std::string::npos)
+    return "";
+  start = asmText.find(":\n", start);
+  if (start == std::string::npos)
+    return "";
+  start += 2;
+  size_t end = asmText.find(":\n", start);
+  end = asmText.rfind('\n', end);
+  return asmText.substr(start, end - start);
+}
+
+TEST_F(StatepointsTest, PtrsInRegsStackMap) {
+  // %p is live across the call in the loop. With -gogc-ptrs-in-regs
+  // it can stay in a callee-saved register, which the stack map entry
+  // then names in the register mask that follows nbits.
+  const char *ir = R"RAW_RESULT(
+    declare void @use(i8* nest, i64*)
+    define void @f(i8* nest %c, i64* %p, i64 %n) GOFN {
+    entry:
+      br label %loop
+    loop:
+      %i = phi i64 [ 0, %entry ], [ %i1, %loop ]
+      call void @g(i8* nest undef)
+      %i1 = add i64 %i, 1
+      %more = icmp ult i64 %i1, %n
+      br i1 %more, label %loop, label %done
+    done:
+      call void @use(i8* nest undef, i64* %p)
+      ret void
+    }
+  )RAW_RESULT";
+
+  for (bool inRegs : { false, true }) {
+    setOption("gogc-ptrs-in-regs", inRegs ? "true" : "false");
+    ASSERT_TRUE(run(ir));
+    std::unique_ptr<TargetMachine> tm = createTargetMachine(*mod_, "x86-64");
+    if (!tm)
+      GTEST_SKIP() << "x86_64 target not available";
+    std::string asmText =
+        emitAsm(*mod_, *tm, [](legacy::PassManager &) {});
+    // The entry for the call in the loop.
+    std::string entry = firstStackMapEntry(asmText);
+    ASSERT_FALSE(entry.empty()) << asmText;
+
+    unsigned nbits, mask;
+    if (!inRegs) {
+      // Spilled: no mask, and a bit for the slot holding %p.
+      unsigned bits;
+      ASSERT_EQ(sscanf(entry.c_str(), " .long %u .byte %u", &nbits, &bits),
+                2) << entry;
+      EXPECT_EQ(nbits & GO_STACKMAP_HAS_REGS, 0u) << entry;
+      EXPECT_NE(bits, 0u) << entry;
+      continue;
+    }
+    ASSERT_EQ(sscanf(entry.c_str(), " .long %u .long %u", &nbits, &mask), 2)
+        << entry;
+    EXPECT_EQ(nbits, GO_STACKMAP_HAS_REGS) << entry;
+    // The DWARF numbers of rbx, rbp and r12-r15.
+    const unsigned calleeSaved =
+        (1u << 3) | (1u << 6) | (1u << 12) | (1u << 13) | (1u << 14) |
+        (1u << 15);
+    EXPECT_NE(mask, 0u) << entry;
+    EXPECT_EQ(mask & ~calleeSaved, 0u) << entry;
+  }
+  setOption("gogc-ptrs-in-regs", "false");
+}
+
+// Ambiguously live slots that are only used on a path that is not
+// always taken are zeroed on that path, not in the entry block.
+// Zeroing is never placed in a loop, where it could clobber a value
+// from an earlier iteration, but goes to the loop's preheader.
+TEST_F(StatepointsTest, ZeroingColdPath) {
+  // %a is only initialized on some paths to the call in %call, so it
+  // has to be zeroed, but only if we get to %rare.
+  ASSERT_TRUE(run(R"RAW_RESULT(
+    define void @f(i8* nest %c, i1 %c1, i1 %c2, i8* %x) GOFN {
+    entry:
+      %a = alloca i8*, !go_addrtaken !0
+      br i1 %c1, label %rare, label %done
+    rare:
+      br i1 %c2, label %init, label %call
+    init:
+      store i8* %x, i8** %a
+      br label %call
+    call:
+      call void @g(i8* nest undef)
+      br label %done
+    done:
+      ret void
+    }
+  )RAW_RESULT"));
+
+  typedef std::vector<std::string> blocks;
+  EXPECT_EQ(zeroedIn("f", "a"), blocks{"rare"}) << fn("f");
+  std::string f = fn("f");
+  EXPECT_TRUE(containstokens(f, "[ \"deopt\"(i8** %a) ]")) << f;
+}
+
+TEST_F(StatepointsTest, ZeroingHoistedOutOfLoop) {
+  // The uses of %a are all in the loop, so zeroing goes to the block
+  // ahead of it, which is not the entry block.
+  ASSERT_TRUE(run(R"RAW_RESULT(
+    define void @f(i8* nest %c, i1 %c1, i64 %n, i8* %x) GOFN {
+    entry:
+      %a = alloca i8*, !go_addrtaken !0
+      br i1 %c1, label %pre, label %done
+    pre:
+      br label %loop
+    loop:
+      %i = phi i64 [ 0, %pre ], [ %i1, %latch ]
+      %odd = trunc i64 %i to i1
+      br i1 %odd, label %init, label %latch
+    init:
+      store i8* %x, i8** %a
+      br label %latch
+    latch:
+      call void @g(i8* nest undef)
+      %i1 = add i64 %i, 1
+      %more = icmp ult i64 %i1, %n
+      br i1 %more, label %loop, label %done
+    done:
+      ret void
+    }
+  )RAW_RESULT"));
+
+  typedef std::vector<std::string> blocks;
+  EXPECT_EQ(zeroedIn("f", "a"), blocks{"pre"}) << fn("f");
+}
+
+TEST_F(StatepointsTest, ZeroingPhiAndLifetime) {
+  // %a and %b have their address taken by the phi, and are stored to
+  // through it. Their lifetime.start markers are replaced by new ones
+  // where they are zeroed, which is at the start of %work, the block
+  // dominating the phi's incoming edges and the call. They are zeroed
+  // again at lifetime.end, so that the GC does not see stale pointers
+  // in them afterwards.
+  ASSERT_TRUE(run(R"RAW_RESULT(
+    declare void @llvm.lifetime.start.p0i8(i64, i8*)
+    declare void @llvm.lifetime.end.p0i8(i64, i8*)
+    define void @f(i8* nest %c, i1 %c1, i1 %c2, i8* %x) GOFN {
+    entry:
+      %a = alloca i8*, !go_addrtaken !0
+      %b = alloca i8*, !go_addrtaken !0
+      br i1 %c1, label %work, label %done
+    work:
+      %a8 = bitcast i8** %a to i8*
+      %b8 = bitcast i8** %b to i8*
+      call void @llvm.lifetime.start.p0i8(i64 8, i8* %a8)
+      call void @llvm.lifetime.start.p0i8(i64 8, i8* %b8)
+      br i1 %c2, label %l, label %r
+    l:
+      br label %join
+    r:
+      br label %join
+    join:
+      %p = phi i8** [ %a, %l ], [ %b, %r ]
+      store i8* %x, i8** %p
+      call void @g(i8* nest undef)
+      call void @llvm.lifetime.end.p0i8(i64 8, i8* %a8)
+      call void @llvm.lifetime.end.p0i8(i64 8, i8* %b8)
+      br label %done
+    done:
+      ret void
+    }
+  )RAW_RESULT"));
+
+  typedef std::vector<std::string> blocks;
+  std::string f = fn("f");
+  for (const char *slot : { "a", "b" }) {
+    blocks zeroed = zeroedIn("f", slot);
+    ASSERT_EQ(zeroed.size(), 2u) << slot << f;
+    EXPECT_EQ(zeroed[0], "work") << slot << f;
+    EXPECT_NE(zeroed[1], "work") << slot << f;
+  }
+
+  // One lifetime.start per slot, ahead of the zeroing; none end.
+  std::map<std::string, std::string> starts;
+  for (Instruction &I : instructions(mod_->getFunction("f")))
+    if (auto *II = dyn_cast<IntrinsicInst>(&I)) {
+      EXPECT_NE(II->getIntrinsicID(), Intrinsic::lifetime_end) << f;
+      if (II->getIntrinsicID() == Intrinsic::lifetime_start) {
+        std::string slot =
+            II->getArgOperand(1)->stripPointerCasts()->getName().str();
+        EXPECT_EQ(starts.count(slot), 0u) << slot << f;
+        starts[slot] = I.getParent()->getName().str();
+      }
+    }
+  EXPECT_EQ(starts, (std::map<std::string, std::string>{ { "a", "work" },
+                                                         { "b", "work" } }))
+      << f;
+}
+
+} // namespace
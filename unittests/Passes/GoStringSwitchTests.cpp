@@ -0,0 +1,204 @@
+//===---- GoStringSwitchTests.cpp -----------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GollvmPasses.h"
+#include "PassTestUtils.h"
+
+#include "DiffUtils.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace goBackendUnitTests;
+
+namespace {
+
+// The front end's equality check, defined here so that the
+// interpreter can run it.
+const char *MemequalIR = R"RAW_RESULT(
+  define i8 @runtime.memequal(i8* nest %c, i8* %a, i8* %b, i64 %n) {
+  entry:
+    br label %loop
+  loop:
+    %i = phi i64 [ 0, %entry ], [ %i1, %next ]
+    %done = icmp eq i64 %i, %n
+    br i1 %done, label %eq, label %body
+  body:
+    %pa = getelementptr i8, i8* %a, i64 %i
+    %pb = getelementptr i8, i8* %b, i64 %i
+    %x = load i8, i8* %pa
+    %y = load i8, i8* %pb
+    %same = icmp eq i8 %x, %y
+    br i1 %same, label %next, label %ne
+  next:
+    %i1 = add i64 %i, 1
+    br label %loop
+  eq:
+    ret i8 1
+  ne:
+    ret i8 0
+  }
+)RAW_RESULT";
+
+// Build a module with a function
+//
+//   func sw(flag bool, s string) int {
+//     if flag { return 100 }    // only with 'defaultPhi'
+//     switch s { case cases[0]: return 1; case cases[1]: return 2 ... }
+//     return 0
+//   }
+//
+// lowered the way the front end does it: a chain of length compares
+// followed by memequal calls. With 'defaultPhi' the result is merged
+// in a PHI in the default block, which gets 0 from the chain blocks
+// (or, if 'mixed', a different value from the last confirm block).
+std::string switchIR(const std::vector<std::string> &cases,
+                     bool defaultPhi = false, bool mixed = false)
+{
+  std::string ir;
+  raw_string_ostream os(ir);
+  os << "target triple = \"x86_64-unknown-linux-gnu\"\n";
+  os << MemequalIR;
+  for (unsigned i = 0; i < cases.size(); ++i)
+    os << "@s" << i << " = private constant [" << cases[i].size()
+       << " x i8] c\"" << cases[i] << "\"\n";
+  os << "define i64 @sw(i1 %flag, i8* %p, i64 %len) {\n";
+  os << "entry:\n";
+  if (defaultPhi)
+    os << "  br i1 %flag, label %default, label %test0\n";
+  else
+    os << "  br label %test0\n";
+  unsigned n = cases.size();
+  for (unsigned i = 0; i < n; ++i) {
+    std::string next = i + 1 < n ? "test" + std::to_string(i + 1) : "default";
+    os << "test" << i << ":\n"
+       << "  %c" << i << " = icmp eq i64 %len, " << cases[i].size() << "\n"
+       << "  br i1 %c" << i << ", label %cmp" << i << ", label %" << next
+       << "\n"
+       << "cmp" << i << ":\n"
+       << "  %r" << i << " = call i8 @runtime.memequal(i8* nest undef, "
+       << "i8* %p, i8* getelementptr ([" << cases[i].size() << " x i8], ["
+       << cases[i].size() << " x i8]* @s" << i << ", i64 0, i64 0), "
+       << "i64 %len)\n"
+       << "  %t" << i << " = trunc i8 %r" << i << " to i1\n"
+       << "  br i1 %t" << i << ", label %case" << i << ", label %" << next
+       << "\n"
+       << "case" << i << ":\n"
+       << "  ret i64 " << i + 1 << "\n";
+  }
+  os << "default:\n";
+  if (defaultPhi) {
+    // Only the last link of the chain branches to the default block.
+    os << "  %v = phi i64 [ 100, %entry ], [ 0, %test" << n - 1 << " ], [ "
+       << (mixed ? 7 : 0) << ", %cmp" << n - 1 << " ]\n"
+       << "  ret i64 %v\n";
+  } else {
+    os << "  ret i64 0\n";
+  }
+  os << "}\n";
+  return os.str();
+}
+
+// Run @sw before and after the pass on each of 'inputs' (with the
+// flag clear and set), and check that the results agree. Returns the
+// rewritten function's IR.
+std::string checkEquivalent(const std::string &ir,
+                            const std::vector<std::string> &inputs,
+                            bool expectChange)
+{
+  LLVMContext ctx;
+  std::unique_ptr<Module> orig = parseIR(ctx, ir);
+  std::unique_ptr<Module> mod = parseIR(ctx, ir);
+  if (!orig || !mod)
+    return "";
+  std::string before = repr(mod->getFunction("sw"));
+  if (!runPass(*mod, createGoStringSwitchPass()))
+    return "";
+  std::string after = repr(mod->getFunction("sw"));
+  EXPECT_EQ(before != after, expectChange) << after;
+
+  IRInterpreter want(std::move(orig));
+  IRInterpreter got(std::move(mod));
+  for (unsigned flag = 0; flag < 2; ++flag)
+    for (const std::string &s : inputs) {
+      std::vector<GenericValue> args = {
+        intArg(1, flag), ptrArg(s.data()), intArg(64, s.size())
+      };
+      EXPECT_EQ(want.call("sw", args).IntVal.getZExtValue(),
+                got.call("sw", args).IntVal.getZExtValue())
+          << "input \"" << s << "\" flag " << flag << "\n" << after;
+    }
+  return after;
+}
+
+TEST(GoStringSwitchTests, DispatchOnLength) {
+  std::vector<std::string> cases = { "GET", "POST", "HEAD", "DELETE" };
+  std::string after = checkEquivalent(
+      switchIR(cases),
+      { "", "GET", "POST", "HEAD", "DELETE", "GEX", "POSX", "HEA", "PATCH",
+        "DELETED" },
+      true);
+
+  // One switch on the length; "POST" and "HEAD" share a length, so
+  // are told apart by a word of the string.
+  EXPECT_TRUE(containstokens(after, "switch i64 %len, label %default ["))
+      << after;
+  EXPECT_TRUE(containstokens(after, "%strswitch.word = load i32,")) << after;
+}
+
+TEST(GoStringSwitchTests, DuplicateCases) {
+  // The second "GET" can never match; the first one wins.
+  std::vector<std::string> cases = { "GET", "PUT", "GET", "POST", "HEAD" };
+  std::string after = checkEquivalent(
+      switchIR(cases), { "GET", "PUT", "POST", "HEAD", "GETS", "" }, true);
+  EXPECT_EQ(countinstances(after, "@runtime.memequal(i8*"), 4u) << after;
+  EXPECT_FALSE(containstokens(after, "cmp2:")) << after;
+}
+
+TEST(GoStringSwitchTests, SharedWordKey) {
+  // Same length, and no 8-byte window tells the first and last
+  // cases apart: they are confirmed one after the other.
+  std::vector<std::string> cases = { "abcdefgh1", "abcdefgh2", "abcdefgh3",
+                                     "xbcdefgh1" };
+  std::string after = checkEquivalent(
+      switchIR(cases),
+      { "abcdefgh1", "abcdefgh2", "abcdefgh3", "xbcdefgh1", "xbcdefgh2",
+        "abcdefgh4", "abcdefgh", "ybcdefgh1" },
+      true);
+  EXPECT_TRUE(containstokens(after, "%strswitch.word = load i64,")) << after;
+}
+
+TEST(GoStringSwitchTests, DefaultPhi) {
+  // The default block's PHI gets the same value from every chain
+  // block, and another from outside the chain.
+  std::vector<std::string> cases = { "a", "bb", "cc", "ddd" };
+  std::string after = checkEquivalent(
+      switchIR(cases, true, false),
+      { "a", "bb", "cc", "ddd", "b", "dd", "x", "" }, true);
+  EXPECT_TRUE(containstokens(after, "[ 100, %entry ],")) << after;
+}
+
+TEST(GoStringSwitchTests, DefaultPhiMixedValues) {
+  // The PHI tells the chain blocks apart, so the chain can't be
+  // rewritten.
+  std::vector<std::string> cases = { "a", "bb", "cc", "ddd" };
+  checkEquivalent(switchIR(cases, true, true),
+                  { "a", "bb", "cc", "ddd", "x", "" }, false);
+}
+
+TEST(GoStringSwitchTests, ShortChainUnchanged) {
+  // Below go-string-switch-min-cases (4) compares the chain is left
+  // alone.
+  std::vector<std::string> cases = { "GET", "POST", "HEAD" };
+  checkEquivalent(switchIR(cases), { "GET", "POST", "HEAD", "PUT", "" },
+                  false);
+}
+
+} // namespace
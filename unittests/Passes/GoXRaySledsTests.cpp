@@ -0,0 +1,139 @@
+//===---- GoXRaySledsTests.cpp --------------------------------------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GollvmPasses.h"
+#include "PassTestUtils.h"
+
+#include "llvm/CodeGen/Passes.h"
+
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace goBackendUnitTests;
+
+namespace {
+
+// A split-stack function with a frame, and one without, instrumented
+// with XRay (as the bridge does for -fxray-instrument).
+const char *SplitStackIR = R"RAW_RESULT(
+  target triple = "x86_64-unknown-linux-gnu"
+  declare void @g(i64)
+  define void @f(i64 %n) #0 {
+    %a = alloca [40 x i64]
+    %p = getelementptr [40 x i64], [40 x i64]* %a, i64 0, i64 %n
+    store i64 1, i64* %p
+    call void @g(i64 %n)
+    ret void
+  }
+  define i64 @small(i64 %n) #0 {
+    %m = mul i64 %n, %n
+    ret i64 %m
+  }
+  attributes #0 = { "split-stack" "xray-instruction-threshold"="1" }
+)RAW_RESULT";
+
+// Compile SplitStackIR the way the driver does with -fxray-instrument,
+// leaving out the passes that are not asked for. Returns the assembly,
+// or an empty string if the target is not available.
+std::string emitXRayAsm(bool withSledsPass, bool withReservePass)
+{
+  LLVMContext ctx;
+  std::unique_ptr<Module> mod = parseIR(ctx, SplitStackIR);
+  if (!mod)
+    return "";
+  std::unique_ptr<TargetMachine> tm = createTargetMachine(*mod, "x86-64");
+  if (!tm)
+    return "";
+  return emitAsm(
+      *mod, *tm,
+      [&](legacy::PassManager &pm) {
+        if (withSledsPass)
+          pm.add(createGoXRaySledsPass());
+      },
+      [&](TargetPassConfig &config) {
+        if (withReservePass)
+          config.insertPass(&FixupStatepointCallerSavedID,
+                            createGoXRayStackReservePass());
+      });
+}
+
+// Return the assembly of function 'name'.
+std::string functionAsm(const std::string &asmText, const std::string &name)
+{
+  size_t start = asmText.find(name + ":\n");
+  if (start == std::string::npos)
+    return "";
+  size_t end = asmText.find(".cfi_endproc", start);
+  return asmText.substr(start, end - start);
+}
+
+TEST(GoXRaySledsTests, EntrySledFollowsSplitStackCheck) {
+  std::string asmText = emitXRayAsm(true, true);
+  if (asmText.empty())
+    GTEST_SKIP() << "x86_64 target not available";
+  std::string fasm = functionAsm(asmText, "f");
+
+  // Both sleds are there, and recorded in the sled map.
+  size_t check = fasm.find("cmpq\t%fs:112");
+  size_t morestack = fasm.find("callq\t__morestack");
+  size_t entry = fasm.find(".Lxray_sled_0:");
+  size_t exit = fasm.find(".Lxray_sled_1:");
+  ASSERT_NE(check, std::string::npos) << fasm;
+  ASSERT_NE(morestack, std::string::npos) << fasm;
+  ASSERT_NE(entry, std::string::npos) << fasm;
+  ASSERT_NE(exit, std::string::npos) << fasm;
+  EXPECT_NE(asmText.find("xray_instr_map"), std::string::npos) << asmText;
+
+  // The function still starts with the stack limit check, and the
+  // entry sled is in the body, which __morestack calls back into.
+  EXPECT_EQ(fasm.find("\t.cfi_startproc\n") + 16, fasm.find("\tleaq"))
+      << fasm;
+  EXPECT_LT(check, entry) << fasm;
+  EXPECT_LT(entry, exit) << fasm;
+  EXPECT_LT(exit, morestack) << fasm;
+}
+
+TEST(GoXRaySledsTests, EntrySledFirstWithoutPass) {
+  std::string asmText = emitXRayAsm(false, true);
+  if (asmText.empty())
+    GTEST_SKIP() << "x86_64 target not available";
+  std::string fasm = functionAsm(asmText, "f");
+
+  // Without the pass XRay puts the sled ahead of the check, which is
+  // what the pass is there to fix.
+  size_t check = fasm.find("cmpq\t%fs:112");
+  size_t entry = fasm.find(".Lxray_sled_0:");
+  ASSERT_NE(check, std::string::npos) << fasm;
+  ASSERT_NE(entry, std::string::npos) << fasm;
+  EXPECT_LT(entry, check) << fasm;
+}
+
+TEST(GoXRaySledsTests, CheckCoversTrampoline) {
+  // A patched sled calls the XRay trampoline on the goroutine stack.
+  // Frames are grown to go-xray-stack-reserve (512) bytes, so the
+  // stack limit check leaves room for it.
+  std::string asmText = emitXRayAsm(true, true);
+  if (asmText.empty())
+    GTEST_SKIP() << "x86_64 target not available";
+  for (const char *name : { "f", "small" }) {
+    std::string fasm = functionAsm(asmText, name);
+    size_t lea = fasm.find("leaq\t-");
+    ASSERT_NE(lea, std::string::npos) << fasm;
+    EXPECT_GE(std::stoul(fasm.substr(lea + 6)), 512u) << fasm;
+    EXPECT_EQ(fasm.find("cmpq\t%fs:112, %rsp"), std::string::npos) << fasm;
+  }
+
+  // Without the pass, the leaf function has no frame and so no stack
+  // check at all.
+  asmText = emitXRayAsm(true, false);
+  std::string fasm = functionAsm(asmText, "small");
+  EXPECT_NE(fasm.find(".Lxray_sled_"), std::string::npos) << fasm;
+  EXPECT_EQ(fasm.find("%fs:112"), std::string::npos) << fasm;
+}
+
+} // namespace
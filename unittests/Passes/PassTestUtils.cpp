@@ -0,0 +1,151 @@
+//===- llvm/tools/gollvm/unittests/Passes/PassTestUtils.cpp -----------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PassTestUtils.h"
+#include "TargetSetup.h"
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/ExecutionEngine/Interpreter.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace goBackendUnitTests {
+
+std::unique_ptr<Module> parseIR(LLVMContext &context, StringRef ir)
+{
+  SMDiagnostic err;
+  std::unique_ptr<Module> module = parseAssemblyString(ir, err, context);
+  if (!module) {
+    std::string msg;
+    raw_string_ostream os(msg);
+    err.print("input", os);
+    ADD_FAILURE() << os.str();
+  }
+  return module;
+}
+
+bool runPass(Module &module, Pass *pass)
+{
+  legacy::PassManager pm;
+  pm.add(pass);
+  pm.run(module);
+  std::string msg;
+  raw_string_ostream os(msg);
+  if (verifyModule(module, &os)) {
+    ADD_FAILURE() << os.str() << repr(module);
+    return false;
+  }
+  return true;
+}
+
+std::string repr(const Module &module)
+{
+  std::string res;
+  raw_string_ostream os(res);
+  module.print(os, nullptr);
+  return os.str();
+}
+
+std::string repr(const Function *fcn)
+{
+  if (!fcn)
+    return "<null>";
+  std::string res;
+  raw_string_ostream os(res);
+  fcn->print(os);
+  return os.str();
+}
+
+std::unique_ptr<TargetMachine>
+createTargetMachine(Module &module, StringRef cpu, StringRef features)
+{
+  Triple triple(module.getTargetTriple());
+  if (!gollvm::driver::initializeTargetFor(triple))
+    return nullptr;
+  std::string err;
+  const Target *target = TargetRegistry::lookupTarget(triple.str(), err);
+  if (!target)
+    return nullptr;
+  std::unique_ptr<TargetMachine> tm(target->createTargetMachine(
+      triple.str(), cpu, features, TargetOptions(), Reloc::PIC_, None,
+      CodeGenOpt::Default));
+  if (tm)
+    module.setDataLayout(tm->createDataLayout());
+  return tm;
+}
+
+std::string emitAsm(Module &module, TargetMachine &tm,
+                    std::function<void(legacy::PassManager &)> addMachinePasses,
+                    std::function<void(TargetPassConfig &)> configure)
+{
+  LLVMTargetMachine &lltm = static_cast<LLVMTargetMachine &>(tm);
+  std::string res;
+  raw_string_ostream os(res);
+  buffer_ostream bos(os);
+  legacy::PassManager pm;
+  TargetPassConfig *passConfig = lltm.createPassConfig(pm);
+  pm.add(passConfig);
+  MachineModuleInfoWrapperPass *mmiwp = new MachineModuleInfoWrapperPass(&lltm);
+  pm.add(mmiwp);
+  if (configure)
+    configure(*passConfig);
+  passConfig->addISelPasses();
+  passConfig->addMachinePasses();
+  passConfig->setInitialized();
+  if (addMachinePasses)
+    addMachinePasses(pm);
+  lltm.addAsmPrinter(pm, bos, nullptr, CGFT_AssemblyFile,
+                     mmiwp->getMMI().getContext());
+  pm.add(createFreeMachineFunctionPass());
+  pm.run(module);
+  return bos.str().str();
+}
+
+IRInterpreter::IRInterpreter(std::unique_ptr<Module> module)
+{
+  LLVMLinkInInterpreter();
+  std::string err;
+  engine_.reset(EngineBuilder(std::move(module))
+                    .setEngineKind(EngineKind::Interpreter)
+                    .setErrorStr(&err)
+                    .create());
+  if (!engine_)
+    ADD_FAILURE() << "creating interpreter: " << err;
+}
+
+IRInterpreter::~IRInterpreter() { }
+
+GenericValue IRInterpreter::call(StringRef name, ArrayRef<GenericValue> args)
+{
+  Function *fcn = engine_ ? engine_->FindFunctionNamed(name) : nullptr;
+  if (!fcn) {
+    ADD_FAILURE() << "no function " << name.str();
+    return intArg(64, 0);
+  }
+  return engine_->runFunction(fcn, args);
+}
+
+GenericValue intArg(unsigned bits, uint64_t val)
+{
+  GenericValue gv;
+  gv.IntVal = APInt(bits, val);
+  return gv;
+}
+
+GenericValue ptrArg(const void *ptr)
+{
+  return PTOGV(const_cast<void *>(ptr));
+}
+
+} // namespace goBackendUnitTests
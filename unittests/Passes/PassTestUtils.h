@@ -0,0 +1,88 @@
+//===- llvm/tools/gollvm/unittests/Passes/PassTestUtils.h -------------===//
+//
+// Copyright 2026 The Go Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef GOLLVM_UNITTESTS_PASSES_PASSTESTUTILS_H
+#define GOLLVM_UNITTESTS_PASSES_PASSTESTUTILS_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/GenericValue.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace goBackendUnitTests {
+
+// Parse the textual IR in 'ir'. On error, reports a test failure and
+// returns null.
+std::unique_ptr<llvm::Module> parseIR(llvm::LLVMContext &context,
+                                      llvm::StringRef ir);
+
+// Run 'pass' (which is consumed) over 'module' with the legacy pass
+// manager. Returns TRUE if the module still verifies afterwards;
+// otherwise reports a test failure with the verifier's output.
+bool runPass(llvm::Module &module, llvm::Pass *pass);
+
+// Return string representation of a module or function.
+std::string repr(const llvm::Module &module);
+std::string repr(const llvm::Function *fcn);
+
+// Create a target machine for the triple of 'module' (which also
+// gets the target's data layout), registering the target first.
+// Returns null if gollvm's driver does not support the target or it
+// was not built; tests then skip themselves.
+std::unique_ptr<llvm::TargetMachine>
+createTargetMachine(llvm::Module &module, llvm::StringRef cpu = "",
+                    llvm::StringRef features = "");
+
+// Generate assembly for 'module' with the code generation pipeline
+// the driver uses (see CompileGoImpl::invokeBackEnd). 'addMachinePasses'
+// is called at the point where the driver adds its own machine passes,
+// right before the asm printer. 'configure', if given, is called with
+// the pass config before any passes are added, for inserting passes
+// into the standard pipeline.
+std::string emitAsm(
+    llvm::Module &module, llvm::TargetMachine &tm,
+    std::function<void(llvm::legacy::PassManager &)> addMachinePasses,
+    std::function<void(llvm::TargetPassConfig &)> configure = nullptr);
+
+// Runs functions of a module with LLVM's IR interpreter, so that
+// tests can check that a transformation preserved the behavior of
+// the code. The module must define every function that gets called.
+class IRInterpreter {
+ public:
+  explicit IRInterpreter(std::unique_ptr<llvm::Module> module);
+  ~IRInterpreter();
+
+  // Call function 'name' with the given arguments; returns its
+  // result, or zero (after reporting a test failure) if there is no
+  // such function.
+  llvm::GenericValue call(llvm::StringRef name,
+                          llvm::ArrayRef<llvm::GenericValue> args);
+
+ private:
+  std::unique_ptr<llvm::ExecutionEngine> engine_;
+};
+
+// Helpers for making interpreter arguments.
+llvm::GenericValue intArg(unsigned bits, uint64_t val);
+llvm::GenericValue ptrArg(const void *ptr);
+
+} // namespace goBackendUnitTests
+
+#endif // GOLLVM_UNITTESTS_PASSES_PASSTESTUTILS_H